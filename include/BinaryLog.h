@@ -0,0 +1,165 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_BINARY_LOG_H_
+#define LLAVR_BINARY_LOG_H_
+
+#include "llavr-common.h"
+#include "Print.h"
+
+/*
+ * Binary log record layout (multi-byte fields are little-endian):
+ *
+ *   [sync] [len] [id lo] [id hi] [timestamp ...] [args ...] [check]
+ *
+ *   sync       BINLOG_SYNC
+ *   len        number of bytes from [id lo] up to (not including) [check]
+ *   id         flash address of the F() message string
+ *   timestamp  BINLOG_TIMESTAMP_BYTES bytes from the log clock (may be 0)
+ *   args       raw argument bytes, in call order, each sizeof(arg) long
+ *   check      XOR of all bytes from [len] up to (not including) [check]
+ *
+ * The message strings themselves never leave the MCU; the host-side decoder
+ * (tools/binlog-decode.py) looks the id up in the firmware ELF and formats
+ * the arguments using the printf-style conversions found in the string.
+ */
+
+/** @brief Marks the start of every binary log record */
+#define BINLOG_SYNC ((uint8_t)0xA5)
+
+/** @brief Number of timestamp bytes per record (0, 1, 2 or 4) */
+#ifndef BINLOG_TIMESTAMP_BYTES
+#define BINLOG_TIMESTAMP_BYTES 4
+#endif
+
+/** @brief Maximum number of raw argument bytes per record */
+#ifndef BINLOG_MAX_ARG_BYTES
+#define BINLOG_MAX_ARG_BYTES 16
+#endif
+
+/**
+ * @brief Timestamp source for log records (e.g., a millisecond counter)
+ */
+typedef uint32_t (*BinaryLogClock)(void);
+
+/**
+ * @brief Deferred logger which emits compact binary records instead of
+ *   formatted text
+ *
+ * Each record carries the flash address of its F() message string, a
+ * timestamp and the raw bytes of up to three arguments. No formatting is done
+ * on the MCU; see tools/binlog-decode.py for the host side.
+ *
+ * Example:
+ *   BinaryLog Log(Serial1, &uptimeMs); // uptimeMs() supplied by the app
+ *   Log.log(F("motor %hhu speed %d"), (uint8_t)motor, speed);
+ */
+class BinaryLog {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param out Where to write records to (typically a HardwareSerial)
+     * @param clock The timestamp source to use (defaults to none, in which
+     *   case all timestamps are written as zero)
+     */
+    BinaryLog(Print &out, BinaryLogClock clock = 0);
+
+    /**
+     * @brief Set the timestamp source to use for subsequent records
+     */
+    void setClock(BinaryLogClock clock);
+
+    /**
+     * @brief Enable or disable output of records
+     *
+     * NOTE: While disabled, calls to log() return immediately.
+     */
+    void setEnabled(bool enabled);
+
+    /**
+     * @brief Log a message without arguments
+     *
+     * @param msg The message; must be given using the F() macro
+     *
+     * @return the number of bytes written
+     */
+    size_t log(const __FlashStringHelper *msg) {
+        return writeRecord(msg, (const uint8_t *)0, 0);
+    }
+
+    /**
+     * @brief Log a message with one argument
+     *
+     * NOTE: Arguments are written raw (sizeof(A) bytes), so the conversion in
+     *   the message string must match the argument type on the MCU; e.g., %d
+     *   for int (2 bytes), %ld for long (4 bytes), %hhu for uint8_t.
+     */
+    template<typename A>
+    size_t log(const __FlashStringHelper *msg, A a) {
+        uint8_t args[sizeof(A)];
+
+        memcpy(args, &a, sizeof(A));
+
+        return writeRecord(msg, args, sizeof(args));
+    }
+
+    /**
+     * @brief Log a message with two arguments (see log(msg, a))
+     */
+    template<typename A, typename B>
+    size_t log(const __FlashStringHelper *msg, A a, B b) {
+        uint8_t args[sizeof(A) + sizeof(B)];
+
+        memcpy(args, &a, sizeof(A));
+        memcpy(args + sizeof(A), &b, sizeof(B));
+
+        return writeRecord(msg, args, sizeof(args));
+    }
+
+    /**
+     * @brief Log a message with three arguments (see log(msg, a))
+     */
+    template<typename A, typename B, typename C>
+    size_t log(const __FlashStringHelper *msg, A a, B b, C c) {
+        uint8_t args[sizeof(A) + sizeof(B) + sizeof(C)];
+
+        memcpy(args, &a, sizeof(A));
+        memcpy(args + sizeof(A), &b, sizeof(B));
+        memcpy(args + sizeof(A) + sizeof(B), &c, sizeof(C));
+
+        return writeRecord(msg, args, sizeof(args));
+    }
+
+protected:
+    /**
+     * @brief Assemble a record and write it out with a single buffered write
+     *
+     * NOTE: Argument bytes beyond BINLOG_MAX_ARG_BYTES are dropped.
+     *
+     * @return the number of bytes written
+     */
+    size_t writeRecord(const __FlashStringHelper *msg,
+            const uint8_t *args, uint8_t argLen);
+
+private:
+    Print *out;                 ///< record destination
+    BinaryLogClock clock;       ///< timestamp source
+    bool enabled;               ///< are records being written
+};
+
+#endif /* LLAVR_BINARY_LOG_H_ */
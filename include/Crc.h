@@ -0,0 +1,184 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_CRC_H_
+#define LLAVR_CRC_H_
+
+#include "llavr-common.h"
+#include "Print.h"
+#include "HardwareSerial.h"
+
+/*
+ * Supported algorithms:
+ *
+ *   CRC-8        poly 0x07, init 0x00, not reflected, no final xor
+ *   CRC-16       CCITT-FALSE: poly 0x1021, init 0xFFFF, not reflected,
+ *                no final xor
+ *   CRC-32       IEEE 802.3: poly 0x04C11DB7 (reflected 0xEDB88320),
+ *                init 0xFFFFFFFF, reflected, final xor 0xFFFFFFFF
+ *
+ * Each algorithm can be built with one of three implementations, trading
+ * flash for speed:
+ *
+ *   CRC_IMPL_BITWISE   no table; one shift/xor step per bit
+ *   CRC_IMPL_NIBBLE    16-entry PROGMEM table; two lookups per byte
+ *                      (16 / 32 / 64 bytes of flash)
+ *   CRC_IMPL_TABLE     256-entry PROGMEM table; one lookup per byte
+ *                      (256 / 512 / 1024 bytes of flash)
+ *
+ * Select with -DCRC_IMPL=..., or per algorithm with -DCRC8_IMPL=...,
+ * -DCRC16_IMPL=... and -DCRC32_IMPL=... when building the library.
+ */
+
+#define CRC_IMPL_BITWISE    0
+#define CRC_IMPL_NIBBLE     1
+#define CRC_IMPL_TABLE      2
+
+#ifndef CRC_IMPL
+#define CRC_IMPL CRC_IMPL_NIBBLE
+#endif
+
+#ifndef CRC8_IMPL
+#define CRC8_IMPL CRC_IMPL
+#endif
+
+#ifndef CRC16_IMPL
+#define CRC16_IMPL CRC_IMPL
+#endif
+
+#ifndef CRC32_IMPL
+#define CRC32_IMPL CRC_IMPL
+#endif
+
+/** @brief Initial values and final xor values */
+#define CRC8_INIT       ((uint8_t)0x00)
+#define CRC8_XOROUT     ((uint8_t)0x00)
+#define CRC16_INIT      ((uint16_t)0xFFFF)
+#define CRC16_XOROUT    ((uint16_t)0x0000)
+#define CRC32_INIT      ((uint32_t)0xFFFFFFFFUL)
+#define CRC32_XOROUT    ((uint32_t)0xFFFFFFFFUL)
+
+/**
+ * @brief Update a running CRC-8 with the given bytes
+ *
+ * NOTE: The update functions work on the raw CRC register; start from
+ *   CRCn_INIT and xor the result with CRCn_XOROUT when done.
+ */
+uint8_t crc8Update(uint8_t crc, const uint8_t *buffer, size_t size);
+
+/**
+ * @brief Update a running CRC-16 with the given bytes
+ */
+uint16_t crc16Update(uint16_t crc, const uint8_t *buffer, size_t size);
+
+/**
+ * @brief Update a running CRC-32 with the given bytes
+ */
+uint32_t crc32Update(uint32_t crc, const uint8_t *buffer, size_t size);
+
+/**
+ * @brief Streaming CRC engine
+ *
+ * The engine is a Print, so anything printed to it is folded into the CRC;
+ * an optional pass-through Print receives the same bytes, e.g. to checksum
+ * everything sent to a serial port:
+ *
+ *   Crc16 crc(&Serial1);
+ *   crc.print(F("speed="));
+ *   crc.println(speed);
+ *   Serial1.println(crc.value(), HEX);
+ *
+ * Received data can be checked as it is consumed with read():
+ *
+ *   while((c = crc.read(Serial1)) >= 0) { ... }
+ */
+template<typename T, T (*UPDATE)(T, const uint8_t *, size_t), T INIT, T XOROUT>
+class CrcEngine : public Print {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param passThrough Where to forward written bytes to (defaults to
+     *   nowhere)
+     */
+    CrcEngine(Print *passThrough = (Print *)0)
+        : crc(INIT),
+          passThrough(passThrough) {
+        // nop
+    }
+
+    /**
+     * @brief Restart the CRC calculation
+     */
+    void reset() {
+        crc = INIT;
+    }
+
+    /**
+     * @brief Get the CRC of all bytes seen since the last reset
+     */
+    T value() const {
+        return crc ^ XOROUT;
+    }
+
+    /**
+     * @brief Fold the given bytes into the CRC (nothing is forwarded)
+     */
+    void update(const uint8_t *buffer, size_t size) {
+        crc = UPDATE(crc, buffer, size);
+    }
+
+    /**
+     * @brief Read one byte from the given serial port and fold it into the
+     *   CRC
+     *
+     * @return the byte read, or -1 if none was available
+     */
+    int read(HardwareSerial &in) {
+        int c = in.read();
+
+        if(c >= 0) {
+            uint8_t b = (uint8_t)c;
+            crc = UPDATE(crc, &b, 1);
+        }
+
+        return c;
+    }
+
+    virtual size_t write(uint8_t c) {
+        crc = UPDATE(crc, &c, 1);
+        return (passThrough != (Print *)0) ? passThrough->write(c) : 1;
+    }
+
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        crc = UPDATE(crc, buffer, size);
+        return (passThrough != (Print *)0) ?
+                passThrough->write(buffer, size) : size;
+    }
+
+    using Print::write;
+
+private:
+    T crc;                      ///< raw CRC register
+    Print *passThrough;         ///< where written bytes are forwarded to
+};
+
+typedef CrcEngine<uint8_t, crc8Update, CRC8_INIT, CRC8_XOROUT> Crc8;
+typedef CrcEngine<uint16_t, crc16Update, CRC16_INIT, CRC16_XOROUT> Crc16;
+typedef CrcEngine<uint32_t, crc32Update, CRC32_INIT, CRC32_XOROUT> Crc32;
+
+#endif /* LLAVR_CRC_H_ */
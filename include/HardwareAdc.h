@@ -0,0 +1,271 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_HARDWARE_ADC_H_
+#define LLAVR_HARDWARE_ADC_H_
+
+#include "llavr-common.h"
+#include "SampleFilter.h"
+
+/*
+ * Interrupt-driven ADC scanning.
+ *
+ * A scan converts the channels of a scan list in turn, one conversion per
+ * ADC interrupt, and stores the results in a ring buffer read with read().
+ * Conversions are started either back to back (free-running) or by a timer
+ * event (auto-trigger), which gives a jitter-free sample rate:
+ *
+ *   // 8 channels at 1kHz each: Timer1 overflows at 8kHz
+ *   static const uint8_t channels[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+ *
+ *   Adc.begin();
+ *   Adc.setChannels(channels, sizeof(channels));
+ *   Timer1.setPrescaler(TIMER_PRESCALE_8);
+ *   Timer1.setFastPwmMode(F_CPU / 8 / 8000 - 1);
+ *   Adc.start(ADC_TRIGGER_TIMER1_OVERFLOW);
+ *
+ * Each buffered sample holds the 10-bit conversion result along with its
+ * channel (see ADC_SAMPLE_VALUE() and ADC_SAMPLE_CHANNEL()). Samples that
+ * arrive while the buffer is full are dropped and counted as overruns.
+ *
+ * A SampleFilter can be attached to each channel (see setFilter()).
+ */
+
+/** @brief Number of samples buffered (a power of two, <= 128) */
+#ifndef ADC_BUFFER_SIZE
+#define ADC_BUFFER_SIZE 32
+#endif
+
+/** @brief Maximum length of the scan list */
+#ifndef ADC_MAX_SCAN
+#define ADC_MAX_SCAN 16
+#endif
+
+/** @brief Number of ADC input channels */
+#if defined(MUX5)
+#define ADC_CHANNELS 16
+#else
+#define ADC_CHANNELS 8
+#endif
+
+#if (ADC_BUFFER_SIZE & (ADC_BUFFER_SIZE - 1)) || (ADC_BUFFER_SIZE > 128)
+#error "ADC_BUFFER_SIZE must be a power of two, no larger than 128"
+#endif
+
+/** @brief Get the conversion result (0..1023) of a buffered sample */
+#define ADC_SAMPLE_VALUE(s)     ((uint16_t)((s) & 0x03FF))
+/** @brief Get the channel of a buffered sample */
+#define ADC_SAMPLE_CHANNEL(s)   ((uint8_t)((s) >> 12))
+
+/** @brief Returned by convert() when no conversion could be made */
+#define ADC_NO_SAMPLE           ((uint16_t)0xFFFF)
+
+/**
+ * @brief ADC voltage reference
+ */
+typedef enum {
+    ADC_REF_AREF = 0,                               ///< external AREF pin
+    ADC_REF_AVCC = bit(REFS0),                      ///< AVCC
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+    ADC_REF_INTERNAL_1V1 = bit(REFS1),              ///< internal 1.1V
+    ADC_REF_INTERNAL_2V56 = bit(REFS1) | bit(REFS0),///< internal 2.56V
+#elif defined(__AVR_ATmega32U4__)
+    ADC_REF_INTERNAL_2V56 = bit(REFS1) | bit(REFS0),///< internal 2.56V
+#else
+    ADC_REF_INTERNAL_1V1 = bit(REFS1) | bit(REFS0), ///< internal 1.1V
+#endif
+} AdcReference;
+
+/**
+ * @brief ADC clock prescaler
+ *
+ * NOTE: Full 10-bit resolution needs an ADC clock of 50-200kHz (i.e.,
+ *   ADC_PRESCALE_128 at 16MHz); a conversion takes 13 ADC clocks.
+ */
+typedef enum {
+    ADC_PRESCALE_2 = 1,
+    ADC_PRESCALE_4,
+    ADC_PRESCALE_8,
+    ADC_PRESCALE_16,
+    ADC_PRESCALE_32,
+    ADC_PRESCALE_64,
+    ADC_PRESCALE_128,
+} AdcPrescaler;
+
+/**
+ * @brief What starts each conversion of a scan (values are ADTS settings)
+ *
+ * NOTE: The timer must be set up separately; its interrupt flag is cleared
+ *   by the ADC interrupt, so the timer's own interrupt need not be enabled.
+ */
+typedef enum {
+    ADC_TRIGGER_FREE_RUNNING = 0,           ///< back to back conversions
+    ADC_TRIGGER_TIMER0_COMPARE_A = 3,       ///< Timer0 compare match A
+    ADC_TRIGGER_TIMER0_OVERFLOW = 4,        ///< Timer0 overflow
+    ADC_TRIGGER_TIMER1_COMPARE_B = 5,       ///< Timer1 compare match B
+    ADC_TRIGGER_TIMER1_OVERFLOW = 6,        ///< Timer1 overflow
+    ADC_TRIGGER_TIMER1_CAPTURE = 7,         ///< Timer1 input capture
+} AdcTrigger;
+
+/**
+ * @brief Where a channel's filter runs
+ */
+typedef enum {
+    ADC_FILTER_IN_ISR,      ///< in the ADC interrupt, before buffering
+    ADC_FILTER_ON_READ,     ///< in read(), as samples leave the buffer
+} AdcFilterStage;
+
+class HardwareAdc {
+public:
+    HardwareAdc();
+
+    /**
+     * @brief Enable the ADC
+     *
+     * @param reference The voltage reference (defaults to ADC_REF_AVCC)
+     * @param prescale The ADC clock prescaler (defaults to ADC_PRESCALE_128)
+     */
+    void begin(AdcReference reference = ADC_REF_AVCC,
+            AdcPrescaler prescale = ADC_PRESCALE_128);
+
+    /**
+     * @brief Disable the ADC, stopping any scan
+     */
+    void end();
+
+    /**
+     * @brief Set the channels to scan, in order
+     *
+     * NOTE: The digital input buffers of the given channels' pins are
+     *   disabled.
+     *
+     * @param channels The channel numbers (0..ADC_CHANNELS-1)
+     * @param count The number of channels (1..ADC_MAX_SCAN)
+     *
+     * @return false if the list is invalid or a scan is running
+     */
+    bool setChannels(const uint8_t *channels, uint8_t count);
+
+    /**
+     * @brief Attach a filter to a channel
+     *
+     * Every sample of the channel is passed through the filter; results are
+     * clamped to 0..1023. Filtering in the ISR keeps the buffered samples
+     * filtered (and costs interrupt time); filtering on read keeps the ISR
+     * short.
+     *
+     * NOTE: A filter may only be attached to one channel.
+     *
+     * @param channel The channel to filter
+     * @param filter The filter to use, or NULL to remove the channel's filter
+     * @param stage Where to run the filter (defaults to ADC_FILTER_IN_ISR)
+     *
+     * @return false if the channel is invalid
+     */
+    bool setFilter(uint8_t channel, SampleFilter *filter,
+            AdcFilterStage stage = ADC_FILTER_IN_ISR);
+
+    /**
+     * @brief Start scanning the channel list
+     *
+     * NOTE: The sample buffer and the overrun count are cleared.
+     *
+     * @param trigger What starts each conversion (defaults to free-running)
+     *
+     * @return false if the ADC isn't enabled or no channels are set
+     */
+    bool start(AdcTrigger trigger = ADC_TRIGGER_FREE_RUNNING);
+
+    /**
+     * @brief Stop scanning; buffered samples remain readable
+     */
+    void stop();
+
+    /**
+     * @brief Check whether a scan is running
+     */
+    bool isRunning() {
+        return running;
+    }
+
+    /**
+     * @brief Make a single conversion, waiting for the result
+     *
+     * @param channel The channel to convert
+     *
+     * @return the result (0..1023), or ADC_NO_SAMPLE if the ADC isn't enabled
+     *   or a scan is running
+     */
+    uint16_t convert(uint8_t channel);
+
+    /**
+     * @brief Get the number of buffered samples
+     */
+    uint8_t available();
+
+    /**
+     * @brief Read buffered samples, oldest first
+     *
+     * @param samples Where to store the samples
+     * @param count The maximum number of samples to read
+     *
+     * @return the number of samples read
+     */
+    uint8_t read(uint16_t *samples, uint8_t count);
+
+    /**
+     * @brief Get the number of samples dropped because the buffer was full
+     */
+    uint16_t getOverruns();
+
+    /**
+     * @brief Handle a completed conversion
+     *
+     * NOTE: Called from the ADC interrupt; not for use by applications.
+     */
+    void conversionComplete();
+
+private:
+    /**
+     * @brief Point the multiplexer at a channel
+     */
+    void selectChannel(uint8_t channel);
+
+    uint16_t buffer[ADC_BUFFER_SIZE];   ///< sample ring buffer
+    volatile uint8_t head;              ///< next slot to write (ISR)
+    volatile uint8_t tail;              ///< next slot to read
+    volatile uint16_t overruns;         ///< samples dropped
+
+    uint8_t scan[ADC_MAX_SCAN];         ///< channels to scan
+    uint8_t scanLength;                 ///< number of channels to scan
+    uint8_t current;                    ///< scan index of the conversion done
+    uint8_t next;                       ///< scan index of the next conversion
+    bool discard;                       ///< drop the next result
+
+    SampleFilter *filters[ADC_CHANNELS];///< per-channel filters
+    uint16_t isrFilters;                ///< channels filtered in the ISR
+
+    uint8_t reference;                  ///< AdcReference (REFSn bits)
+    uint8_t trigger;                    ///< AdcTrigger of the running scan
+    volatile bool running;              ///< is a scan running
+};
+
+#if defined(ADCSRA)
+extern HardwareAdc Adc;
+#endif
+
+#endif /* LLAVR_HARDWARE_ADC_H_ */
@@ -0,0 +1,146 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_HARDWARE_INTERRUPT_H_
+#define LLAVR_HARDWARE_INTERRUPT_H_
+
+#include "llavr-common.h"
+
+/*
+ * External (INTn) and pin change (PCINTn) interrupt dispatch.
+ *
+ * Handlers are plain functions taking a context pointer and the pin's level
+ * when the interrupt was serviced:
+ *
+ *   static void onZeroCross(void *context, uint8_t state) { ... }
+ *
+ *   ExternalInterrupt::attach(4, INTERRUPT_RISING, onZeroCross);
+ *   PinChangeInterrupt::attach(18, onEncoderB, &encoder);  // PK2 on a 2560
+ *
+ * A pin change group's ISR finds the pins that changed with a single XOR
+ * against the group's previous state, and calls only their handlers.
+ *
+ * Build flags:
+ *
+ *   LLAVR_INTERRUPT_NOBLOCK    the dispatch ISRs re-enable interrupts once
+ *                              the pins are read, before calling the
+ *                              handlers, so they can't delay other
+ *                              latency critical interrupts; handlers must
+ *                              then tolerate being interrupted (and, for fast
+ *                              edges, re-entered)
+ *   LLAVR_NO_INTn_ISR          don't define the INTn vector (n = 0..7)
+ *   LLAVR_NO_PCINTn_ISR        don't define the PCINTn group vector (n = 0..2)
+ *
+ * For the lowest latency, opt a vector out and define it directly, e.g.
+ * ISR(INT4_vect, ISR_NAKED) with hand-written register handling; attach()
+ * may still be used to configure the trigger (with a NULL handler).
+ */
+
+/**
+ * @brief Interrupt handler
+ *
+ * @param context The context pointer given to attach()
+ * @param state The level of the pin (0 or 1) when the interrupt was serviced
+ */
+typedef void (*InterruptHandler)(void *context, uint8_t state);
+
+/**
+ * @brief What triggers an external interrupt (values are ISCn settings)
+ */
+typedef enum {
+    INTERRUPT_LOW = 0,          ///< low level (repeats while the pin is low)
+    INTERRUPT_CHANGE = 1,       ///< any edge
+    INTERRUPT_FALLING = 2,      ///< falling edge
+    INTERRUPT_RISING = 3,       ///< rising edge
+} InterruptSense;
+
+/**
+ * @brief External interrupts (INTn pins)
+ *
+ * NOTE: On the 328P only INT0/INT1 exist; on the 32U4, INT0..INT3 and INT6.
+ *   INT4..INT7 on the 1280/2560 only sense edges while the I/O clock runs
+ *   (i.e., an edge can't wake the MCU from deep sleep).
+ */
+class ExternalInterrupt {
+public:
+    /**
+     * @brief Attach a handler to an external interrupt and enable it
+     *
+     * NOTE: Any interrupt pending from before the call is discarded.
+     *
+     * @param number The interrupt number (n of INTn)
+     * @param sense What triggers the interrupt
+     * @param handler The handler to call
+     * @param context Passed to the handler (defaults to NULL)
+     *
+     * @return false if the interrupt doesn't exist on the target MCU
+     */
+    static bool attach(uint8_t number, InterruptSense sense,
+            InterruptHandler handler, void *context = NULL);
+
+    /**
+     * @brief Disable an external interrupt and detach its handler
+     */
+    static void detach(uint8_t number);
+};
+
+/**
+ * @brief Pin change interrupts (PCINTn pins)
+ *
+ * Pins are numbered as in the datasheet: PCINT0..7 are group 0, PCINT8..15
+ * group 1 and PCINT16..23 group 2. Every change (both edges) is reported.
+ *
+ * NOTE: Pulses shorter than the group's ISR latency may be missed, and if a
+ *   pin changes twice before the ISR reads the group, no change is seen.
+ */
+class PinChangeInterrupt {
+public:
+    /**
+     * @brief Attach a handler to a pin change interrupt and enable it
+     *
+     * @param pin The pin change interrupt number (n of PCINTn)
+     * @param handler The handler to call
+     * @param context Passed to the handler (defaults to NULL)
+     *
+     * @return false if the pin doesn't exist on the target MCU
+     */
+    static bool attach(uint8_t pin, InterruptHandler handler, void *context = NULL);
+
+    /**
+     * @brief Disable a pin change interrupt and detach its handler
+     */
+    static void detach(uint8_t pin);
+
+    /**
+     * @brief Read the level (0 or 1) of a pin change interrupt pin
+     */
+    static uint8_t read(uint8_t pin);
+
+    /**
+     * @brief Get the input register (PINx) and bit of a pin change interrupt
+     *   pin, for handlers that read pins directly
+     *
+     * @param pin The pin change interrupt number (n of PCINTn)
+     * @param mask Set to the pin's bit in the register
+     *
+     * @return The register, or NOREG if the pin doesn't exist on the target
+     *   MCU
+     */
+    static volatile uint8_t *getInputRegister(uint8_t pin, uint8_t *mask);
+};
+
+#endif /* LLAVR_HARDWARE_INTERRUPT_H_ */
@@ -20,6 +20,7 @@
 #define LLAVR_HARDWARESERVO_H_
 
 #include "HardwareTimer.h"
+#include "McuPinMap.h"
 
 /** @brief Default minimum pulse width (microseconds */
 #define HWSRVO_DEFAULT_MIN_US   ((uint16_t)1000)
@@ -27,46 +28,12 @@
 #define HWSRVO_DEFAULT_MAX_US   ((uint16_t)2000)
 
 /**
- * @brief Available 16-bit hardware PWM output pins
+ * @brief Hardware PWM output pins usable for servos
+ *
+ * NOTE: Only pins driven by 16-bit timers (OC1x, OC3x, ...) can generate servo
+ *   pulses; a servo on any other output compare pin is left disabled.
  */
-typedef enum {
-#if defined(OCR1A)
-    OC1A,
-#endif
-#if defined(OCR1B)
-    OC1B,
-#endif
-#if defined(OCR1C)
-    OC1C,
-#endif
-#if defined(OCR3A)
-    OC3A,
-#endif
-#if defined(OCR3B)
-    OC3B,
-#endif
-#if defined(OCR3C)
-    OC3C,
-#endif
-#if defined(OCR4A)
-    OC4A,
-#endif
-#if defined(OCR4B)
-    OC4B,
-#endif
-#if defined(OCR4C)
-    OC4C,
-#endif
-#if defined(OCR5A)
-    OC5A,
-#endif
-#if defined(OCR5B)
-    OC5B,
-#endif
-#if defined(OCR5C)
-    OC5C,
-#endif
-} ServoPin;
+typedef OutputComparePin ServoPin;
 
 /**
  * @brief API for controlling servos with 16-bit AVR hardware timers
@@ -81,6 +48,9 @@ public:
      *
      * NOTE: The given pin is automatically set to be an output.
      *
+     * NOTE: If the given pin isn't driven by a 16-bit timer, the servo is
+     *   disabled and the set*() functions have no effect.
+     *
      * NOTE: The given output pin defines which hardware timer this servo object
      *   will use, overriding any non-HardwareServo use of the timer.
      *
@@ -144,6 +114,9 @@ protected:
     /** @brief the HW timer to use for this servo */
     HardwareTimer *timer;
 
+    /** @brief the timer's output compare channel for this servo */
+    TimerCompareChannel channel;
+
     /** @brief number of timer ticks per 1 microsecond */
     float timerTicks1us;
 
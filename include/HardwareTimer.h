@@ -35,10 +35,39 @@ typedef enum {
     TIMER_OCR_C = bit(2),
 } TimerCompareChannel;
 
+/**
+ * @brief What an output compare channel does to its pin on compare match
+ *   (values are COMnx settings)
+ *
+ * NOTE: In the pwm modes, CLEAR is non-inverting and SET is inverting pwm;
+ *   TOGGLE is meant for normal and CTC modes.
+ */
+typedef enum {
+    TIMER_OUTPUT_DISCONNECTED = 0,  ///< pin not driven by the timer
+    TIMER_OUTPUT_TOGGLE = 1,        ///< toggle the pin
+    TIMER_OUTPUT_CLEAR = 2,         ///< clear the pin
+    TIMER_OUTPUT_SET = 3,           ///< set the pin
+} TimerOutputMode;
+
+typedef enum {
+    TIMER_INTERRUPT_OVERFLOW,
+    TIMER_INTERRUPT_COMPARE_A,
+    TIMER_INTERRUPT_COMPARE_B,
+    TIMER_INTERRUPT_COMPARE_C,
+} TimerInterrupt;
+
+/**
+ * @brief Timer interrupt callback
+ *
+ * @param context The context pointer given when the callback was set
+ */
+typedef void (*TimerCallback)(void *context);
+
 typedef enum {
     TIMER_MODE_NORMAL,
     TIMER_MODE_CTC,
     TIMER_MODE_FASTPWM,
+    TIMER_MODE_PHASE_CORRECT_PWM,
     TIMER_MODE_NONE = 255,
 } TimerMode;
 
@@ -79,8 +108,24 @@ public:
      */
     void setNormalMode();
 
-    // TODO
-//    void setCtcMode();
+    /**
+     * @brief Immediately enable "clear timer on compare match" (CTC) mode on
+     *   this timer, counting from zero up to the given TOP value
+     *
+     * The TOP value is held in OCRnA, so channel A can't be used for other
+     *   compare values; its compare match interrupt fires at TOP. Writing a
+     *   new TOP with setCompareRegister(TIMER_OCR_A, ...) takes effect at
+     *   once (it isn't buffered), so it should be done early in a period.
+     *
+     * NOTE: If the underlying timer is an 8-bit timer only the low byte of
+     *   the given value is used.
+     *
+     * NOTE: The timer count is reset to zero and any existing output compare
+     *   settings are cleared.
+     *
+     * @param topValue The TOP value to use for this timer
+     */
+    void setCtcMode(uint16_t topValue);
 
     /**
      * @brief Immediately enable "fast pwm mode" on this timer, the operation of
@@ -97,11 +142,85 @@ public:
      */
     void setFastPwmMode(uint16_t topValue = 0xFFFF);
 
-    // TODO
-//    void setOverflowInterrupt();
+    /**
+     * @brief Immediately enable "phase correct pwm mode" on this timer,
+     *   counting up to the given TOP value and back down
+     *
+     * The outputs are symmetric around BOTTOM, at half the frequency of fast
+     *   pwm with the same TOP; see setComplementaryPair().
+     *
+     * NOTE: If the underlying timer is an 8-bit timer the TOP value is always
+     *   set to 0xFF, and the given value is ignored.
+     *
+     * NOTE: The timer count is reset to zero and any existing output compare
+     *   settings are cleared.
+     *
+     * @param topValue The TOP value to use for phase correct pwm on this timer
+     *   (defaults to 0xFFFF)
+     */
+    void setPhaseCorrectPwmMode(uint16_t topValue = 0xFFFF);
 
-    // TODO
-//    void setCompareMatchInterrupt();
+    /**
+     * @brief Halt the prescaler shared by the synchronous timers, so that
+     *   timers configured before releaseSync() all start counting together
+     *
+     * While halted, all timers on the shared prescaler (all but Timer2 on the
+     *   1280/2560 and 328P) stand still, including ones not being configured.
+     *   The set*Mode() functions reset the count to zero, so timers set up
+     *   in between are phase-aligned once released.
+     *
+     * @param includeTimer2 Also halt Timer2's separate prescaler (defaults to
+     *   false; ignored if the MCU has no Timer2)
+     */
+    static void haltSync(bool includeTimer2 = false);
+
+    /**
+     * @brief Release the prescalers halted by haltSync(), starting the timers
+     *   on the same clock cycle
+     */
+    static void releaseSync();
+
+    /**
+     * @brief Call the given function on every timer overflow
+     *
+     * NOTE: The callback runs in the timer's overflow ISR, with interrupts
+     *   disabled.
+     *
+     * NOTE: The timer ISRs are only linked into programs that set a callback,
+     *   so timers used without callbacks leave their vectors free for
+     *   user-defined ISRs. Define LLAVR_NO_TIMERn_ISRS to leave all vectors of
+     *   timer n free in programs that do use callbacks (on other timers).
+     *
+     * @param callback The function to call, or NULL to disable the interrupt
+     * @param context Passed to the callback (defaults to NULL)
+     */
+    void setOverflowInterrupt(TimerCallback callback, void *context = NULL);
+
+    /**
+     * @brief Call the given function on every compare match of the given
+     *   channels
+     *
+     * NOTE: The callback runs in the channel's compare match ISR; see
+     *   setOverflowInterrupt().
+     *
+     * @param channels A bitmask defining which channels to set the callback
+     *   for (see enum TimerCompareChannel)
+     * @param callback The function to call, or NULL to disable the interrupts
+     * @param context Passed to the callback (defaults to NULL)
+     */
+    void setCompareMatchInterrupt(uint8_t channels, TimerCallback callback,
+            void *context = NULL);
+
+    /**
+     * @brief Call the callback set for the given interrupt
+     *
+     * NOTE: Called from the timer ISRs; not for use by applications.
+     */
+    inline void handleInterrupt(TimerInterrupt source) {
+        if(callbacks[source]) {
+            callbacks[source](contexts[source]);
+        }
+    }
 
     /**
      * @brief Set the output compare register (OCRnx) of the given channels to
@@ -124,6 +243,20 @@ public:
      */
     void setCompareValue(uint8_t channels, uint16_t value, bool inverting = false);
 
+    /**
+     * @brief Set the output compare register (OCRnx) of the given channels to
+     *   the given value, leaving the channels' output modes untouched
+     *
+     * NOTE: Unlike setCompareValue(), this doesn't connect the output pins;
+     *   it's meant for compare match interrupts (e.g., scheduling the next
+     *   interrupt from a callback).
+     *
+     * @param channels A bitmask defining which channels to set the value on
+     *   (see enum TimerCompareChannel)
+     * @param value The compare value to set
+     */
+    void setCompareRegister(uint8_t channels, uint16_t value);
+
     /**
      * @brief Convenience shortcut for setting the compare value for channel A
      */
@@ -145,6 +278,132 @@ public:
         setCompareValue((uint8_t)TIMER_OCR_C, value, inverting);
     }
 
+    /**
+     * @brief Set what the given channels do to their pins on compare match,
+     *   leaving their compare values untouched
+     *
+     * In CTC mode, TIMER_OUTPUT_TOGGLE on channel A gives a square wave of
+     *   F_CPU / (2 * prescale * (1 + OCRnA)) with no CPU involvement.
+     *
+     * NOTE: User is responsible for setting the correct ports to outputs (see
+     *   enableOutputs()).
+     *
+     * @param channels A bitmask defining which channels to set the mode of
+     *   (see enum TimerCompareChannel)
+     * @param outputMode What to do on compare match
+     */
+    void setCompareOutputMode(uint8_t channels, TimerOutputMode outputMode);
+
+    /**
+     * @brief Drive a pair of channels as complementary outputs (e.g. the high
+     *   and low side of a half bridge) with a dead time between them
+     *
+     * The high channel is non-inverting with OCR = value, the low channel
+     *   inverting with OCR = value + deadTime. In phase correct pwm mode both
+     *   transitions of each period then have both outputs off for deadTime
+     *   timer ticks (counting up, the high side turns off deadTime ticks
+     *   before the low side turns on; counting down, the reverse).
+     *
+     * NOTE: Meant for phase correct pwm mode; in fast pwm mode only one of
+     *   the two transitions gets a dead time.
+     *
+     * NOTE: The low side is on for (TOP - value - deadTime) of every TOP
+     *   ticks, and never if value + deadTime >= TOP.
+     *
+     * NOTE: Both channels are updated with interrupts disabled, the side
+     *   whose on time shrinks first, so a change of value never makes the
+     *   outputs overlap.
+     *
+     * @param highChannel The channel driving the high side (one of enum
+     *   TimerCompareChannel)
+     * @param lowChannel The channel driving the low side (one of enum
+     *   TimerCompareChannel)
+     * @param value The high side's compare value (its on time)
+     * @param deadTime The dead time, in timer ticks
+     */
+    void setComplementaryPair(uint8_t highChannel, uint8_t lowChannel,
+            uint16_t value, uint16_t deadTime);
+
+    /**
+     * @brief Make the pins of the given output compare channels outputs, so
+     *   the output compare unit can drive them
+     *
+     * NOTE: Channels without a pin on the target MCU are ignored.
+     *
+     * @param channels A bitmask defining which channels' pins to set as outputs
+     *   (see enum TimerCompareChannel)
+     */
+    void enableOutputs(uint8_t channels);
+
+    /**
+     * @brief Check whether the underlying timer is a 16-bit timer
+     */
+    bool isWide() {
+        return is16Bit;
+    }
+
+    /**
+     * @brief Get the compare register and output mode bits of one channel
+     *
+     * For ISRs that write OCRnx directly, without setCompareRegister()'s
+     *   critical section.
+     *
+     * @param channel A single channel (one of enum TimerCompareChannel)
+     * @param regH Set to the channel's OCRnxH (NOREG on 8-bit timers); may be
+     *   NULL if not needed, along with regL
+     * @param regL Set to the channel's OCRnxL
+     * @param comShift Set to the position of the channel's COMnx bits in
+     *   TCCRnA
+     * @return false if the timer doesn't have the channel
+     */
+    bool getCompareOutput(uint8_t channel,
+            volatile uint8_t **regH, volatile uint8_t **regL, uint8_t *comShift);
+
+    /**
+     * @brief Get the interrupt mask register (TIMSKn), for ISRs that enable
+     *   or disable the timer's interrupts directly
+     */
+    volatile uint8_t *getInterruptMask() {
+        return timsk;
+    }
+
+    /**
+     * @brief Get the current timer count (TCNTn)
+     *
+     * NOTE: Interrupts are disabled while reading a 16-bit count, so this is
+     *   safe to use from both ISRs and the main program.
+     */
+    uint16_t getCount();
+
+    /**
+     * @brief Set the timer count (TCNTn)
+     *
+     * NOTE: Interrupts are disabled while writing a 16-bit count. A compare
+     *   match at the new count is blocked for one timer clock (hardware
+     *   behavior).
+     *
+     * @param count The count to set
+     */
+    void setCount(uint16_t count);
+
+    /**
+     * @brief Check whether the timer has overflowed since its overflow flag
+     *   (TOVn) was last cleared, e.g. by the overflow ISR running
+     *
+     * Lets code running with interrupts disabled tell whether a count it
+     *   read belongs before or after a pending overflow.
+     */
+    bool isOverflowPending();
+
+    /**
+     * @brief Check whether any of the given channels has had a compare match
+     *   since its flag (OCFnx) was last cleared; see isOverflowPending()
+     *
+     * @param channels A bitmask defining which channels to check (see enum
+     *   TimerCompareChannel)
+     */
+    bool isCompareMatchPending(uint8_t channels);
+
     /**
      * @brief Get the current prescale value for this timer
      */
@@ -193,6 +452,9 @@ private:
     volatile uint8_t *timsk, *tifr;         ///< timer interrupt mask/flags
 
     uint16_t topValue;          ///< current top value for timer
+
+    TimerCallback callbacks[4]; ///< callbacks, indexed by TimerInterrupt
+    void *contexts[4];          ///< callback contexts
 };
 
 // definition for null timer
@@ -219,7 +481,7 @@ extern HardwareTimer Timer2;
 extern HardwareTimer Timer3;
 #endif
 
-#if defined(TCCR4A)
+#if defined(TCCR4A) && defined(ICR4L)
 extern HardwareTimer Timer4;
 #endif
 
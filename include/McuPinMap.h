@@ -0,0 +1,120 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_MCU_PIN_MAP_H_
+#define LLAVR_MCU_PIN_MAP_H_
+
+#include "llavr-common.h"
+#include "HardwareTimer.h"
+
+/*
+ * Output compare pin map.
+ *
+ * One row per output compare pin of the target MCU:
+ *
+ *   X(name, timer, channel, port, bit)
+ *
+ * where timer is the number of the TimerN global driving the pin, channel is
+ * the compare channel letter (TIMER_OCR_<channel>) and port/bit locate the
+ * pin (PORT<port>, DDR<port>). The rows generate both the OutputComparePin
+ * enum and the descriptor table in flash, so supporting another MCU only
+ * takes another block of rows here.
+ *
+ * Pins that are not bonded out on a package (e.g., OC3B/OC3C on the 32U4)
+ * are left out, as is the 32U4's 10-bit Timer4.
+ *
+ * Other MCUs get an empty map (OC_PIN_COUNT is 0): the timers still work,
+ * but HardwareTimer::enableOutputs() and HardwareServo do nothing.
+ */
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define LLAVR_OC_PINS(X) \
+    X(OC1A, 1, A, B, 5) \
+    X(OC1B, 1, B, B, 6) \
+    X(OC1C, 1, C, B, 7) \
+    X(OC3A, 3, A, E, 3) \
+    X(OC3B, 3, B, E, 4) \
+    X(OC3C, 3, C, E, 5) \
+    X(OC4A, 4, A, H, 3) \
+    X(OC4B, 4, B, H, 4) \
+    X(OC4C, 4, C, H, 5) \
+    X(OC5A, 5, A, L, 3) \
+    X(OC5B, 5, B, L, 4) \
+    X(OC5C, 5, C, L, 5) \
+    X(OC0A, 0, A, B, 7) \
+    X(OC0B, 0, B, G, 5) \
+    X(OC2A, 2, A, B, 4) \
+    X(OC2B, 2, B, H, 6)
+#elif defined(__AVR_ATmega48__) || defined(__AVR_ATmega48A__) || \
+        defined(__AVR_ATmega48P__) || defined(__AVR_ATmega48PA__) || \
+        defined(__AVR_ATmega88__) || defined(__AVR_ATmega88A__) || \
+        defined(__AVR_ATmega88P__) || defined(__AVR_ATmega88PA__) || \
+        defined(__AVR_ATmega168__) || defined(__AVR_ATmega168A__) || \
+        defined(__AVR_ATmega168P__) || defined(__AVR_ATmega168PA__) || \
+        defined(__AVR_ATmega328__) || defined(__AVR_ATmega328P__)
+#define LLAVR_OC_PINS(X) \
+    X(OC1A, 1, A, B, 1) \
+    X(OC1B, 1, B, B, 2) \
+    X(OC0A, 0, A, D, 6) \
+    X(OC0B, 0, B, D, 5) \
+    X(OC2A, 2, A, B, 3) \
+    X(OC2B, 2, B, D, 3)
+#elif defined(__AVR_ATmega32U4__)
+#define LLAVR_OC_PINS(X) \
+    X(OC1A, 1, A, B, 5) \
+    X(OC1B, 1, B, B, 6) \
+    X(OC1C, 1, C, B, 7) \
+    X(OC3A, 3, A, C, 6) \
+    X(OC0A, 0, A, B, 7) \
+    X(OC0B, 0, B, D, 0)
+#else
+#define LLAVR_OC_PINS(X)
+#define LLAVR_NO_OC_PINS
+#endif
+
+#define __LLAVR_OC_ENUM(name, timer, channel, port, bit) name,
+
+/**
+ * @brief Output compare pins of the target MCU
+ *
+ * NOTE: The 16-bit timer pins come first, followed by the 8-bit timer pins.
+ */
+typedef enum {
+    LLAVR_OC_PINS(__LLAVR_OC_ENUM)
+    OC_PIN_COUNT,           ///< number of output compare pins
+} OutputComparePin;
+
+#undef __LLAVR_OC_ENUM
+
+/**
+ * @brief Get the timer driving an output compare pin
+ *
+ * @return The timer, or NULL_HWTIMER if the pin map is empty
+ */
+HardwareTimer *getOutputCompareTimer(OutputComparePin pin);
+
+/**
+ * @brief Get the compare channel (see enum TimerCompareChannel) of an output
+ *   compare pin
+ */
+TimerCompareChannel getOutputCompareChannel(OutputComparePin pin);
+
+/**
+ * @brief Make an output compare pin an output, so the timer can drive it
+ */
+void setOutputComparePinOutput(OutputComparePin pin);
+
+#endif /* LLAVR_MCU_PIN_MAP_H_ */
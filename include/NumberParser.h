@@ -0,0 +1,155 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_NUMBER_PARSER_H_
+#define LLAVR_NUMBER_PARSER_H_
+
+#include "llavr-common.h"
+#include "HardwareSerial.h"
+#include "WString.h"
+
+/*
+ * Number parsing without atol()/strtod() or intermediate Strings.
+ *
+ * Accepted syntax (leading whitespace is skipped in buffers):
+ *
+ *   integers   [+-]digits, or [+-]0x followed by hex digits
+ *   decimals   [+-]digits[.digits][(e|E)[+-]digits]; either the integer or
+ *              the fraction part may be empty (".5", "2.")
+ *
+ * Parsing stops at the first character that can't continue the number; the
+ * parse*() functions on buffers report how many characters were consumed.
+ *
+ * Integer results that don't fit are saturated (LONG_MAX/LONG_MIN, or
+ * ULONG_MAX) and reported as NUMBER_OVERFLOW. Decimals keep the 9 most
+ * significant digits.
+ */
+
+/** @brief Default idle timeout for parsing from a serial port (ms) */
+#ifndef NUMBER_PARSE_TIMEOUT
+#define NUMBER_PARSE_TIMEOUT 1000
+#endif
+
+/**
+ * @brief Result of parsing a number
+ */
+typedef enum {
+    NUMBER_OK,              ///< a number was parsed
+    NUMBER_EMPTY,           ///< no digits were found
+    NUMBER_OVERFLOW,        ///< the number is out of range for the result type
+    NUMBER_TIMEOUT,         ///< no digits arrived before the timeout
+} NumberStatus;
+
+/**
+ * @brief Syntax accepted by a NumberScanner
+ */
+typedef enum {
+    NUMBER_INTEGER,         ///< decimal or 0x-prefixed hex integer
+    NUMBER_DECIMAL,         ///< decimal with optional fraction and exponent
+} NumberFormat;
+
+/**
+ * @brief Incremental number scanner
+ *
+ * Characters are fed one at a time with accept(), so numbers can be parsed
+ * from any source (a buffer, a serial port, an ISR) without collecting them
+ * into a string first. Once accept() returns false the number is complete
+ * and can be converted to the desired type.
+ */
+class NumberScanner {
+public:
+    NumberScanner(NumberFormat format = NUMBER_INTEGER);
+
+    /**
+     * @brief Start scanning a new number
+     */
+    void reset();
+
+    /**
+     * @brief Offer the next character
+     *
+     * @return true if the character is part of the number, false if it ends
+     *   the number (the character is not consumed)
+     */
+    bool accept(char c);
+
+    /**
+     * @brief Check whether any part of a number (sign, digit, ...) has been
+     *   accepted since the last reset
+     */
+    bool started() const {
+        return flags != 0;
+    }
+
+    // conversion of the scanned number
+    NumberStatus toLong(long *value) const;
+    NumberStatus toUnsignedLong(unsigned long *value) const;
+    NumberStatus toFixed(uint8_t decimals, long *value) const;
+    NumberStatus toFloat(float *value) const;
+
+private:
+    /**
+     * @brief Get the magnitude of the number times 10^decimals, rounded
+     */
+    NumberStatus scaled(uint8_t decimals, uint32_t *value) const;
+
+    uint32_t mantissa;          ///< significant digits
+    int16_t exponent;           ///< power of ten applied to mantissa
+    uint16_t expValue;          ///< magnitude of the explicit exponent
+    uint16_t flags;             ///< __NUMBER_FLAG_* bits
+    uint8_t format;             ///< NumberFormat being scanned
+};
+
+// parsing from buffers; used (if given) receives the number of characters
+// consumed, including leading whitespace
+NumberStatus parseInt(const char *str, size_t len, long *value, size_t *used = 0);
+NumberStatus parseUnsigned(const char *str, size_t len, unsigned long *value, size_t *used = 0);
+NumberStatus parseFixed(const char *str, size_t len, uint8_t decimals, long *value, size_t *used = 0);
+NumberStatus parseFloat(const char *str, size_t len, float *value, size_t *used = 0);
+
+inline NumberStatus parseInt(const String &str, long *value) {
+    return parseInt(str.c_str(), str.length(), value);
+}
+
+inline NumberStatus parseUnsigned(const String &str, unsigned long *value) {
+    return parseUnsigned(str.c_str(), str.length(), value);
+}
+
+inline NumberStatus parseFixed(const String &str, uint8_t decimals, long *value) {
+    return parseFixed(str.c_str(), str.length(), decimals, value);
+}
+
+inline NumberStatus parseFloat(const String &str, float *value) {
+    return parseFloat(str.c_str(), str.length(), value);
+}
+
+/**
+ * @brief Parse a number straight from a serial port's receive buffer
+ *
+ * Characters that can't start a number are discarded; the character that
+ * ends the number is left in the receive buffer. If no data arrives for
+ * timeout milliseconds, a number received so far is returned as complete,
+ * otherwise NUMBER_TIMEOUT is reported.
+ *
+ * NOTE: These block (polling the port once per millisecond) until the number
+ *   is complete or the timeout expires.
+ */
+NumberStatus parseInt(HardwareSerial &in, long *value, uint16_t timeout = NUMBER_PARSE_TIMEOUT);
+NumberStatus parseFixed(HardwareSerial &in, uint8_t decimals, long *value, uint16_t timeout = NUMBER_PARSE_TIMEOUT);
+NumberStatus parseFloat(HardwareSerial &in, float *value, uint16_t timeout = NUMBER_PARSE_TIMEOUT);
+
+#endif /* LLAVR_NUMBER_PARSER_H_ */
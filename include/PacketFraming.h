@@ -0,0 +1,253 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_PACKET_FRAMING_H_
+#define LLAVR_PACKET_FRAMING_H_
+
+#include "llavr-common.h"
+#include "Print.h"
+#include "HardwareSerial.h"
+#include "Crc.h"
+
+/*
+ * Packet framing for binary links.
+ *
+ * COBS (Consistent Overhead Byte Stuffing) frames contain no 0x00 bytes and
+ * are terminated by a single 0x00, costing at most 1 byte per 254 bytes of
+ * payload. SLIP (RFC 1055) frames are terminated by 0xC0 and escape 0xC0 and
+ * 0xDB in the payload.
+ *
+ * When CRC checking is enabled, a CRC-16 (see Crc.h) of the payload is
+ * appended high byte first before encoding, so a receiver can validate the
+ * frame by running the CRC over payload + CRC and checking for a zero
+ * remainder.
+ *
+ * A receiver that loses a byte (or starts mid-stream) recovers at the next
+ * frame delimiter; the damaged frame is reported as an error.
+ */
+
+/** @brief COBS frame delimiter */
+#define COBS_DELIM      ((uint8_t)0x00)
+
+/** @brief SLIP frame delimiter and escape bytes */
+#define SLIP_END        ((uint8_t)0xC0)
+#define SLIP_ESC        ((uint8_t)0xDB)
+#define SLIP_ESC_END    ((uint8_t)0xDC)
+#define SLIP_ESC_ESC    ((uint8_t)0xDD)
+
+/**
+ * @brief Result of feeding data to a frame decoder
+ */
+typedef enum {
+    FRAME_PENDING,          ///< no complete frame yet
+    FRAME_OK,               ///< a valid frame is in the buffer
+    FRAME_ERROR_CRC,        ///< a frame was received but failed the CRC check
+    FRAME_ERROR_OVERFLOW,   ///< a frame was too large for the buffer
+    FRAME_ERROR_ENCODING,   ///< a frame was malformed (e.g., truncated)
+} FrameStatus;
+
+/**
+ * @brief COBS frame encoder
+ *
+ * Payload bytes are written straight from the caller's buffer using
+ * Print::write(buffer, size), one call per run of non-zero bytes; nothing is
+ * copied into an intermediate buffer.
+ */
+class CobsEncoder {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param out Where to write encoded frames to
+     * @param appendCrc True to append a CRC-16 to each frame (defaults to true)
+     */
+    CobsEncoder(Print &out, bool appendCrc = true);
+
+    /**
+     * @brief Encode and write a complete frame, including the delimiter
+     *
+     * @param buffer The frame payload
+     * @param size The payload length
+     *
+     * @return the number of bytes written
+     */
+    size_t writeFrame(const uint8_t *buffer, size_t size);
+
+private:
+    Print *out;                 ///< frame destination
+    bool appendCrc;             ///< append a CRC to each frame
+};
+
+/**
+ * @brief SLIP frame encoder
+ *
+ * Frames can either be written in one go (writeFrame()) or streamed in pieces
+ * (beginFrame(), write()..., endFrame()). Runs of bytes that need no escaping
+ * are written straight from the caller's buffer.
+ */
+class SlipEncoder {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param out Where to write encoded frames to
+     * @param appendCrc True to append a CRC-16 to each frame (defaults to true)
+     */
+    SlipEncoder(Print &out, bool appendCrc = true);
+
+    /**
+     * @brief Start a new frame
+     *
+     * NOTE: A leading SLIP_END is written so the receiver discards any line
+     *   noise received since the previous frame.
+     */
+    size_t beginFrame();
+
+    /**
+     * @brief Append payload bytes to the current frame
+     */
+    size_t write(const uint8_t *buffer, size_t size);
+
+    /**
+     * @brief Finish the current frame (writes the CRC and the delimiter)
+     */
+    size_t endFrame();
+
+    /**
+     * @brief Encode and write a complete frame
+     */
+    size_t writeFrame(const uint8_t *buffer, size_t size) {
+        size_t n = beginFrame();
+        n += write(buffer, size);
+        return n + endFrame();
+    }
+
+private:
+    Print *out;                 ///< frame destination
+    bool appendCrc;             ///< append a CRC to each frame
+    uint16_t crc;               ///< CRC of the current frame
+};
+
+/**
+ * @brief Common state for the incremental frame decoders
+ *
+ * Decoded bytes are written directly into a caller-supplied buffer. When a
+ * decoder reports FRAME_OK the payload is available in that buffer until the
+ * next byte is fed to the decoder.
+ */
+class FrameDecoder {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param buffer Where to decode frames into; must be large enough for the
+     *   payload plus the 2 CRC bytes when CRC checking is enabled
+     * @param size The buffer size
+     * @param checkCrc True to validate and strip a CRC-16 (defaults to true)
+     */
+    FrameDecoder(uint8_t *buffer, size_t size, bool checkCrc = true);
+
+    /**
+     * @brief Feed a single received byte to the decoder
+     *
+     * @return the decoder status after consuming the byte
+     */
+    virtual FrameStatus decode(uint8_t c) = 0;
+
+    /**
+     * @brief Consume bytes from the given serial port until a frame completes
+     *   or the receive buffer is empty
+     *
+     * NOTE: Never blocks; call it from the main loop (or serialEvent()).
+     *
+     * @return the decoder status after the last byte consumed
+     */
+    FrameStatus poll(HardwareSerial &in);
+
+    /**
+     * @brief Discard any partially received frame
+     */
+    void reset();
+
+    /**
+     * @brief Get the payload length of the last completed frame
+     */
+    size_t length() const {
+        return frameLength;
+    }
+
+    /**
+     * @brief Get the buffer frames are decoded into
+     */
+    const uint8_t *data() const {
+        return buffer;
+    }
+
+protected:
+    /**
+     * @brief Store a decoded byte
+     */
+    inline void append(uint8_t c) {
+        if(pos < size) {
+            buffer[pos++] = c;
+        } else {
+            overflow = true;
+        }
+    }
+
+    /**
+     * @brief Validate the frame received so far and reset for the next one
+     */
+    FrameStatus finish(bool malformed);
+
+    uint8_t *buffer;            ///< decode destination
+    size_t size;                ///< size of buffer
+    size_t pos;                 ///< bytes decoded in the current frame
+    size_t frameLength;         ///< payload length of last completed frame
+    bool checkCrc;              ///< validate and strip a CRC
+    bool overflow;              ///< current frame did not fit in buffer
+};
+
+/**
+ * @brief Incremental COBS frame decoder
+ */
+class CobsDecoder : public FrameDecoder {
+public:
+    CobsDecoder(uint8_t *buffer, size_t size, bool checkCrc = true);
+
+    virtual FrameStatus decode(uint8_t c);
+
+private:
+    uint8_t blockCode;          ///< code byte of the current block
+    uint8_t blockLeft;          ///< data bytes left in the current block
+};
+
+/**
+ * @brief Incremental SLIP frame decoder
+ */
+class SlipDecoder : public FrameDecoder {
+public:
+    SlipDecoder(uint8_t *buffer, size_t size, bool checkCrc = true);
+
+    virtual FrameStatus decode(uint8_t c);
+
+private:
+    bool escaped;               ///< previous byte was SLIP_ESC
+    bool malformed;             ///< invalid escape seen in current frame
+};
+
+#endif /* LLAVR_PACKET_FRAMING_H_ */
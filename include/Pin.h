@@ -0,0 +1,285 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_PIN_H_
+#define LLAVR_PIN_H_
+
+#include "llavr-common.h"
+
+/*
+ * Compile-time GPIO access.
+ *
+ * The port and bit are template parameters, so every operation inlines to
+ * constant register accesses: on ports in the low I/O space (PORTA..PORTG on
+ * the 1280/2560, all ports on the 328P and 32U4) set() and clear() compile to
+ * a single sbi/cbi, read() to sbic/sbis (or in + andi) and toggle() to a
+ * single out to PINx.
+ *
+ * Ports above the I/O space (PORTH..PORTL on the 1280/2560) need a
+ * read-modify-write; set() and clear() disable interrupts around it so an
+ * ISR touching the same port can't lose an update. So do the port-wide
+ * setOutput()/setInput() when the mask isn't a constant single bit.
+ *
+ * Example:
+ *   typedef Pin<PortB, 7> Led;         // or BoardPin<13>::type
+ *   Led::setOutput();
+ *   Led::toggle();
+ */
+
+/**
+ * @brief Whether changing mask in reg compiles to a single sbi/cbi, which
+ *   can't be interrupted: a constant single bit, in the low I/O space
+ *
+ * NOTE: Only folds to true once inlined with optimization; otherwise the
+ *   caller takes the critical section.
+ */
+#define __pinSingleBitIo(reg, mask) \
+    (__builtin_constant_p(mask) && (mask) != 0 && ((mask) & ((mask) - 1)) == 0 \
+        && _SFR_IO_REG_P(reg) && _SFR_IO_ADDR(reg) < 0x20)
+
+/**
+ * @brief Set bits in a port register without racing interrupts
+ */
+static inline void __pinSetBits(volatile uint8_t &reg, uint8_t mask) {
+    if(__pinSingleBitIo(reg, mask)) {
+        reg |= mask;
+    } else {
+        // in/or/out (or lds/or/sts): an ISR changing another bit of the
+        // register between the read and the write would lose its update
+        uint8_t saveSreg = SREG;
+        cli();
+        reg |= mask;
+        SREG = saveSreg;
+    }
+}
+
+/**
+ * @brief Clear bits in a port register without racing interrupts
+ */
+static inline void __pinClearBits(volatile uint8_t &reg, uint8_t mask) {
+    if(__pinSingleBitIo(reg, mask)) {
+        reg &= ~mask;
+    } else {
+        uint8_t saveSreg = SREG;
+        cli();
+        reg &= ~mask;
+        SREG = saveSreg;
+    }
+}
+
+/*
+ * Port tags: one empty type per GPIO port, giving Pin access to its
+ * registers, plus port-wide operations for parallel buses.
+ */
+#define __LLAVR_DEFINE_PORT(L) \
+    struct Port##L { \
+        static inline volatile uint8_t &port() { return PORT##L; } \
+        static inline volatile uint8_t &ddr() { return DDR##L; } \
+        static inline volatile uint8_t &pin() { return PIN##L; } \
+        \
+        /* @brief Drive the masked bits to the matching bits of value */ \
+        static inline void write(uint8_t mask, uint8_t value) { \
+            /* writing 1s to PINx toggles; other pins are never written, */ \
+            /* so this needs no critical section */ \
+            PIN##L = (PORT##L ^ value) & mask; \
+        } \
+        \
+        /* @brief Read the masked input bits */ \
+        static inline uint8_t read(uint8_t mask) { \
+            return PIN##L & mask; \
+        } \
+        \
+        /* @brief Make the masked bits outputs */ \
+        static inline void setOutput(uint8_t mask) { \
+            __pinSetBits(DDR##L, mask); \
+        } \
+        \
+        /* @brief Make the masked bits inputs (pull-ups unchanged) */ \
+        static inline void setInput(uint8_t mask) { \
+            __pinClearBits(DDR##L, mask); \
+        } \
+    };
+
+#if defined(PORTA)
+__LLAVR_DEFINE_PORT(A)
+#endif
+#if defined(PORTB)
+__LLAVR_DEFINE_PORT(B)
+#endif
+#if defined(PORTC)
+__LLAVR_DEFINE_PORT(C)
+#endif
+#if defined(PORTD)
+__LLAVR_DEFINE_PORT(D)
+#endif
+#if defined(PORTE)
+__LLAVR_DEFINE_PORT(E)
+#endif
+#if defined(PORTF)
+__LLAVR_DEFINE_PORT(F)
+#endif
+#if defined(PORTG)
+__LLAVR_DEFINE_PORT(G)
+#endif
+#if defined(PORTH)
+__LLAVR_DEFINE_PORT(H)
+#endif
+#if defined(PORTJ)
+__LLAVR_DEFINE_PORT(J)
+#endif
+#if defined(PORTK)
+__LLAVR_DEFINE_PORT(K)
+#endif
+#if defined(PORTL)
+__LLAVR_DEFINE_PORT(L)
+#endif
+
+#undef __LLAVR_DEFINE_PORT
+
+/**
+ * @brief A single GPIO pin
+ *
+ * All members are static; the type itself names the pin, so it can be passed
+ * as a template parameter to drivers (e.g., a bit-banged SPI) at no cost.
+ */
+template<typename PORT, uint8_t BIT>
+class Pin {
+public:
+    /** @brief The pin's bit in its port registers */
+    static const uint8_t MASK = (uint8_t)(1 << BIT);
+
+    /**
+     * @brief Drive the pin high
+     */
+    static inline void set() {
+        __pinSetBits(PORT::port(), MASK);
+    }
+
+    /**
+     * @brief Drive the pin low
+     */
+    static inline void clear() {
+        __pinClearBits(PORT::port(), MASK);
+    }
+
+    /**
+     * @brief Invert the pin's output (or its pull-up, if it's an input)
+     */
+    static inline void toggle() {
+        PORT::pin() = MASK;
+    }
+
+    /**
+     * @brief Drive the pin to the given level
+     */
+    static inline void write(bool high) {
+        if(high) {
+            set();
+        } else {
+            clear();
+        }
+    }
+
+    /**
+     * @brief Read the pin's input level
+     */
+    static inline bool read() {
+        return (PORT::pin() & MASK) != 0;
+    }
+
+    /**
+     * @brief Make the pin an output
+     */
+    static inline void setOutput() {
+        __pinSetBits(PORT::ddr(), MASK);
+    }
+
+    /**
+     * @brief Make the pin an input, with or without its pull-up
+     *
+     * @param pullup True to enable the internal pull-up (defaults to false)
+     */
+    static inline void setInput(bool pullup = false) {
+        __pinClearBits(PORT::ddr(), MASK);
+        write(pullup);
+    }
+};
+
+/**
+ * @brief Arduino board pin numbering
+ *
+ * BoardPin<N>::type is the Pin for Arduino pin N (digital pins, then the
+ * analog pins A0... as digital pins) of the board matching the target MCU:
+ * the Mega 1280/2560 or the Uno (328P). Undefined pin numbers fail to compile.
+ */
+template<uint8_t N> struct BoardPin;
+
+#define __LLAVR_BOARD_PIN(N, P, B) \
+    template<> struct BoardPin<N> { typedef Pin<Port##P, B> type; };
+
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+__LLAVR_BOARD_PIN( 0, E, 0) __LLAVR_BOARD_PIN( 1, E, 1)
+__LLAVR_BOARD_PIN( 2, E, 4) __LLAVR_BOARD_PIN( 3, E, 5)
+__LLAVR_BOARD_PIN( 4, G, 5) __LLAVR_BOARD_PIN( 5, E, 3)
+__LLAVR_BOARD_PIN( 6, H, 3) __LLAVR_BOARD_PIN( 7, H, 4)
+__LLAVR_BOARD_PIN( 8, H, 5) __LLAVR_BOARD_PIN( 9, H, 6)
+__LLAVR_BOARD_PIN(10, B, 4) __LLAVR_BOARD_PIN(11, B, 5)
+__LLAVR_BOARD_PIN(12, B, 6) __LLAVR_BOARD_PIN(13, B, 7)
+__LLAVR_BOARD_PIN(14, J, 1) __LLAVR_BOARD_PIN(15, J, 0)
+__LLAVR_BOARD_PIN(16, H, 1) __LLAVR_BOARD_PIN(17, H, 0)
+__LLAVR_BOARD_PIN(18, D, 3) __LLAVR_BOARD_PIN(19, D, 2)
+__LLAVR_BOARD_PIN(20, D, 1) __LLAVR_BOARD_PIN(21, D, 0)
+__LLAVR_BOARD_PIN(22, A, 0) __LLAVR_BOARD_PIN(23, A, 1)
+__LLAVR_BOARD_PIN(24, A, 2) __LLAVR_BOARD_PIN(25, A, 3)
+__LLAVR_BOARD_PIN(26, A, 4) __LLAVR_BOARD_PIN(27, A, 5)
+__LLAVR_BOARD_PIN(28, A, 6) __LLAVR_BOARD_PIN(29, A, 7)
+__LLAVR_BOARD_PIN(30, C, 7) __LLAVR_BOARD_PIN(31, C, 6)
+__LLAVR_BOARD_PIN(32, C, 5) __LLAVR_BOARD_PIN(33, C, 4)
+__LLAVR_BOARD_PIN(34, C, 3) __LLAVR_BOARD_PIN(35, C, 2)
+__LLAVR_BOARD_PIN(36, C, 1) __LLAVR_BOARD_PIN(37, C, 0)
+__LLAVR_BOARD_PIN(38, D, 7) __LLAVR_BOARD_PIN(39, G, 2)
+__LLAVR_BOARD_PIN(40, G, 1) __LLAVR_BOARD_PIN(41, G, 0)
+__LLAVR_BOARD_PIN(42, L, 7) __LLAVR_BOARD_PIN(43, L, 6)
+__LLAVR_BOARD_PIN(44, L, 5) __LLAVR_BOARD_PIN(45, L, 4)
+__LLAVR_BOARD_PIN(46, L, 3) __LLAVR_BOARD_PIN(47, L, 2)
+__LLAVR_BOARD_PIN(48, L, 1) __LLAVR_BOARD_PIN(49, L, 0)
+__LLAVR_BOARD_PIN(50, B, 3) __LLAVR_BOARD_PIN(51, B, 2)
+__LLAVR_BOARD_PIN(52, B, 1) __LLAVR_BOARD_PIN(53, B, 0)
+__LLAVR_BOARD_PIN(54, F, 0) __LLAVR_BOARD_PIN(55, F, 1)
+__LLAVR_BOARD_PIN(56, F, 2) __LLAVR_BOARD_PIN(57, F, 3)
+__LLAVR_BOARD_PIN(58, F, 4) __LLAVR_BOARD_PIN(59, F, 5)
+__LLAVR_BOARD_PIN(60, F, 6) __LLAVR_BOARD_PIN(61, F, 7)
+__LLAVR_BOARD_PIN(62, K, 0) __LLAVR_BOARD_PIN(63, K, 1)
+__LLAVR_BOARD_PIN(64, K, 2) __LLAVR_BOARD_PIN(65, K, 3)
+__LLAVR_BOARD_PIN(66, K, 4) __LLAVR_BOARD_PIN(67, K, 5)
+__LLAVR_BOARD_PIN(68, K, 6) __LLAVR_BOARD_PIN(69, K, 7)
+#elif defined(__AVR_ATmega328P__)
+__LLAVR_BOARD_PIN( 0, D, 0) __LLAVR_BOARD_PIN( 1, D, 1)
+__LLAVR_BOARD_PIN( 2, D, 2) __LLAVR_BOARD_PIN( 3, D, 3)
+__LLAVR_BOARD_PIN( 4, D, 4) __LLAVR_BOARD_PIN( 5, D, 5)
+__LLAVR_BOARD_PIN( 6, D, 6) __LLAVR_BOARD_PIN( 7, D, 7)
+__LLAVR_BOARD_PIN( 8, B, 0) __LLAVR_BOARD_PIN( 9, B, 1)
+__LLAVR_BOARD_PIN(10, B, 2) __LLAVR_BOARD_PIN(11, B, 3)
+__LLAVR_BOARD_PIN(12, B, 4) __LLAVR_BOARD_PIN(13, B, 5)
+__LLAVR_BOARD_PIN(14, C, 0) __LLAVR_BOARD_PIN(15, C, 1)
+__LLAVR_BOARD_PIN(16, C, 2) __LLAVR_BOARD_PIN(17, C, 3)
+__LLAVR_BOARD_PIN(18, C, 4) __LLAVR_BOARD_PIN(19, C, 5)
+#endif
+
+#undef __LLAVR_BOARD_PIN
+
+#endif /* LLAVR_PIN_H_ */
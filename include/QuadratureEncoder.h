@@ -0,0 +1,151 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_QUADRATURE_ENCODER_H_
+#define LLAVR_QUADRATURE_ENCODER_H_
+
+#include "llavr-common.h"
+#include "HardwareInterrupt.h"
+#include "HardwareTimer.h"
+
+/*
+ * Quadrature encoder decoding, in full (x4) resolution.
+ *
+ * Each edge on A or B is decoded without branching on the pin levels: the
+ * previous and current AB states index a 16-entry table giving the count
+ * step (+1, -1, 0, or invalid when both channels changed at once, which
+ * means an edge was missed).
+ *
+ * The table lives in flash; define LLAVR_ENCODER_TABLE_IN_RAM to keep it in
+ * RAM instead, which saves a cycle per lookup at the cost of 16 bytes.
+ *
+ * Example (encoder on PCINT4/PCINT5, velocity from Timer1's count):
+ *
+ *   QuadratureEncoder wheel(4, 5, &Timer1);
+ *
+ *   Timer1.setPrescaler(TIMER_PRESCALE_64);
+ *   Timer1.setNormalMode();
+ *   wheel.begin();
+ *   ...
+ *   int32_t position = wheel.getCount();
+ *   int32_t speed = wheel.getVelocity();   // edges per second
+ */
+
+class QuadratureEncoder {
+public:
+    /**
+     * @brief Constructor
+     *
+     * NOTE: The pins must be set up as inputs (with pull-ups if the encoder
+     *   has open-collector outputs) before calling begin().
+     *
+     * @param pinA Pin change interrupt number (PCINTn) of channel A
+     * @param pinB Pin change interrupt number (PCINTn) of channel B
+     * @param timer Timer to timestamp edges with, for velocity (defaults to
+     *   none); the timer must be running
+     */
+    QuadratureEncoder(uint8_t pinA, uint8_t pinB, HardwareTimer *timer = NULL_HWTIMER);
+
+    /**
+     * @brief Start decoding
+     *
+     * @return false if either pin has no pin change interrupt
+     */
+    bool begin();
+
+    /**
+     * @brief Stop decoding
+     */
+    void end();
+
+    /**
+     * @brief Get the position, in edges
+     */
+    int32_t getCount();
+
+    /**
+     * @brief Set the position
+     */
+    void setCount(int32_t count);
+
+    /**
+     * @brief Get the number of invalid transitions seen (edges lost because
+     *   both channels changed between two interrupts)
+     */
+    uint16_t getErrors();
+
+    /**
+     * @brief Get the number of timer ticks between the two most recent edges
+     *
+     * NOTE: Only meaningful if edges are less than one timer period apart;
+     *   returns 0 without a timer or before two edges have been seen.
+     *
+     * NOTE: The interval is the difference of two 16-bit counts, so it's
+     *   only right across a timer wrap if the timer counts through 0xFFFF:
+     *   on 8-bit timers, or with TOP below 0xFFFF, intervals spanning a
+     *   wrap (and so getVelocity()) come out wrong.
+     */
+    uint16_t getEdgeInterval();
+
+    /**
+     * @brief Get the speed in edges per second, signed by direction, based on
+     *   the two most recent edges
+     *
+     * NOTE: The speed isn't decayed when the encoder stops; compare
+     *   getCount() between calls to detect that.
+     *
+     * NOTE: See getEdgeInterval() about intervals spanning a timer wrap.
+     */
+    int32_t getVelocity();
+
+    /**
+     * @brief Decode a new AB state
+     *
+     * For hand-written ISRs (see HardwareInterrupt.h) reading both channels
+     * at once; called by the pin change handler otherwise, which also reads
+     * both channels on every edge.
+     *
+     * @param ab The channel levels: A in bit 1, B in bit 0
+     */
+    void update(uint8_t ab);
+
+private:
+    /**
+     * @brief Pin change handler of both channels; context is the encoder
+     */
+    static void onEdge(void *context, uint8_t state);
+
+    /**
+     * @brief Read the AB state from the input registers
+     */
+    uint8_t readChannels();
+
+    uint8_t pinA, pinB;         ///< PCINT numbers of the channels
+    volatile uint8_t *inputA, *inputB;  ///< PINx of the channels
+    uint8_t maskA, maskB;       ///< bits of the channels in PINx
+    HardwareTimer *timer;       ///< edge timestamp source (or NULL)
+
+    volatile int32_t count;     ///< position
+    volatile uint16_t errors;   ///< invalid transitions
+    volatile uint16_t lastEdge; ///< timer count at the last edge
+    volatile uint16_t interval; ///< timer ticks between the last two edges
+    volatile int8_t direction;  ///< step of the last edge (+1/-1, 0 if none)
+    volatile uint8_t edges;     ///< edges timestamped (saturates at 2)
+    uint8_t state;              ///< last AB state
+};
+
+#endif /* LLAVR_QUADRATURE_ENCODER_H_ */
@@ -0,0 +1,223 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_SAMPLE_FILTER_H_
+#define LLAVR_SAMPLE_FILTER_H_
+
+/*
+ * The filters don't touch any hardware, so they also build on the host
+ * (see tools/filter-bench.cpp).
+ */
+#ifdef __AVR__
+#include "llavr-common.h"
+#else
+#include <stdint.h>
+#include <stddef.h>
+#endif
+
+/*
+ * Fixed-point sample filters.
+ *
+ * All arithmetic is 16x16->32-bit integer multiply/accumulate, which avr-gcc
+ * compiles to a few dozen cycles instead of the hundreds a float multiply
+ * costs. Samples are int16_t and must stay within +/-16383 (i.e., 14 bits
+ * plus sign; ADC results are 10 bits), which keeps every intermediate result
+ * within 32 bits.
+ *
+ * Filters share the SampleFilter interface, so they can be attached to a
+ * sample source (e.g., per channel with HardwareAdc::setFilter()) and run
+ * inside its ISR.
+ */
+
+/** @brief Convert a constant to Q15 (range [-1, 1)) */
+#define Q15(x)  ((int16_t)((x) * 32768.0 + ((x) >= 0 ? 0.5 : -0.5)))
+/** @brief Convert a constant to Q2.14 (range [-2, 2)) */
+#define Q14(x)  ((int16_t)((x) * 16384.0 + ((x) >= 0 ? 0.5 : -0.5)))
+
+/**
+ * @brief Interface of a sample-by-sample filter
+ */
+class SampleFilter {
+public:
+    /**
+     * @brief Feed a sample through the filter
+     *
+     * @return the filtered sample
+     */
+    virtual int16_t process(int16_t sample) = 0;
+
+    /**
+     * @brief Forget all past samples
+     */
+    virtual void reset() = 0;
+};
+
+/**
+ * @brief First-order IIR (exponential smoothing) low-pass filter
+ *
+ * y += alpha * (x - y), with alpha in Q15. The output keeps 15 fraction bits
+ * internally, so small alphas don't stall short of the input.
+ */
+class OnePoleFilter : public SampleFilter {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param alpha Smoothing factor in Q15 (e.g., Q15(0.1)); smaller is
+     *   smoother. For a cutoff fc at sample rate fs, alpha ~= 2*pi*fc/fs.
+     */
+    OnePoleFilter(int16_t alpha);
+
+    virtual int16_t process(int16_t sample);
+    virtual void reset();
+
+private:
+    int32_t state;              ///< output in Q15
+    int16_t alpha;              ///< smoothing factor in Q15
+    bool primed;                ///< has the first sample been seen
+};
+
+/**
+ * @brief Biquad coefficients in Q2.14, normalized so a0 == 1
+ *
+ * y[n] = b0*x[n] + b1*x[n-1] + b2*x[n-2] - a1*y[n-1] - a2*y[n-2]
+ */
+typedef struct {
+    int16_t b0, b1, b2;
+    int16_t a1, a2;
+} BiquadCoefficients;
+
+/**
+ * @brief Second-order IIR (biquad) filter, direct form I
+ *
+ * The rounding errors of the last two outputs are fed back (second-order
+ * error shaping), which removes the dead band, limit cycles and the large
+ * low-frequency error plain truncation causes at low cutoff frequencies.
+ */
+class BiquadFilter : public SampleFilter {
+public:
+    BiquadFilter(const BiquadCoefficients &coefficients);
+
+    virtual int16_t process(int16_t sample);
+    virtual void reset();
+
+    /**
+     * @brief Compute Butterworth-style low-pass coefficients (RBJ cookbook)
+     *
+     * NOTE: Uses float math; call it once at start-up, not per sample.
+     *
+     * @param cutoff The cutoff frequency as a fraction of the sample rate
+     *   (0 < cutoff < 0.5)
+     * @param q The quality factor (0.7071 for a maximally flat response)
+     */
+    static BiquadCoefficients lowPass(float cutoff, float q = 0.7071F);
+
+    /**
+     * @brief Compute high-pass coefficients (RBJ cookbook); see lowPass()
+     */
+    static BiquadCoefficients highPass(float cutoff, float q = 0.7071F);
+
+private:
+    BiquadCoefficients c;       ///< filter coefficients
+    int16_t x1, x2;             ///< previous inputs
+    int16_t y1, y2;             ///< previous outputs
+    int16_t error;              ///< rounding error of the last output (Q14)
+    int16_t error2;             ///< rounding error of the output before
+};
+
+/**
+ * @brief Moving average operations, shared by all MovingAverageFilter<N>
+ *
+ * A running sum is kept, so each sample costs one add and one subtract
+ * regardless of the window length.
+ */
+class MovingAverageBase : public SampleFilter {
+public:
+    virtual int16_t process(int16_t sample);
+    virtual void reset();
+
+protected:
+    MovingAverageBase(int16_t *window, uint8_t length);
+
+private:
+    MovingAverageBase(const MovingAverageBase &);
+
+    int16_t *window;            ///< last length samples
+    uint8_t length;             ///< window length
+    uint8_t index;              ///< oldest sample in the window
+    uint8_t count;              ///< samples in the window so far
+    int32_t sum;                ///< sum of the window
+    uint8_t shift;              ///< log2(length), or 0xFF if not a power of 2
+};
+
+/**
+ * @brief Moving average of the last N samples (N <= 255)
+ *
+ * NOTE: Until N samples have been seen, the average of those seen so far is
+ *   returned.
+ */
+template<uint8_t N>
+class MovingAverageFilter : public MovingAverageBase {
+public:
+    MovingAverageFilter() : MovingAverageBase(storage, N) {
+        // nop
+    }
+
+private:
+    int16_t storage[N];
+};
+
+/**
+ * @brief Median operations, shared by all MedianFilter<N>
+ *
+ * A sorted copy of the window is kept up to date by moving one element per
+ * sample, rather than sorting the window each time.
+ */
+class MedianBase : public SampleFilter {
+public:
+    virtual int16_t process(int16_t sample);
+    virtual void reset();
+
+protected:
+    MedianBase(int16_t *window, int16_t *sorted, uint8_t length);
+
+private:
+    MedianBase(const MedianBase &);
+
+    int16_t *window;            ///< last length samples, in arrival order
+    int16_t *sorted;            ///< the same samples, in ascending order
+    uint8_t length;             ///< window length
+    uint8_t index;              ///< oldest sample in the window
+    uint8_t count;              ///< samples in the window so far
+};
+
+/**
+ * @brief Median of the last N samples (N odd, <= 255); removes spikes
+ *   without smearing edges
+ */
+template<uint8_t N>
+class MedianFilter : public MedianBase {
+public:
+    MedianFilter() : MedianBase(storage, storage + N, N) {
+        // nop
+    }
+
+private:
+    int16_t storage[2 * N];
+};
+
+#endif /* LLAVR_SAMPLE_FILTER_H_ */
@@ -0,0 +1,214 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_SAMPLE_PLAYER_H_
+#define LLAVR_SAMPLE_PLAYER_H_
+
+#include "llavr-common.h"
+#include "HardwareTimer.h"
+
+/*
+ * 8-bit unsigned sample playback as the duty cycle of a fast pwm carrier;
+ * an RC low-pass filter on the output pin turns it into an analog signal.
+ *
+ * The timer runs unprescaled with the given TOP, and a new sample is taken
+ * every `divider` carrier periods by the overflow interrupt. At 16 MHz with
+ * TOP = 255 and a divider of 4, the carrier is 62.5 kHz (well above the
+ * audio band) and the sample rate 15625 Hz.
+ *
+ * Samples come either from a table in flash, or from two RAM buffers that
+ * the application refills while the other one is played.
+ *
+ * A carrier with fewer than 256 levels (TOP < 255; a higher carrier
+ * frequency) loses sample resolution. In sigma-delta mode the fraction lost
+ * by each carrier period is carried into the next (first-order noise
+ * shaping), so the average over a sample's carrier periods keeps more of
+ * the sample's resolution.
+ *
+ * The interrupt only does work on sample boundaries (and, in sigma-delta
+ * mode, an addition per carrier period), but runs every carrier period, so
+ * its entry and exit dominate. Through the timer's callback dispatch each
+ * one saves all call-clobbered registers and makes two indirect calls: an
+ * estimated 90 cycles per carrier period without a new sample and 160 with
+ * one, or about 40% of the CPU at the rates above. The dedicated vector
+ * (below) inlines the player into the ISR and writes OCRnx directly: an
+ * estimated 40 and 110 cycles, or about 20%. (Estimates from instruction
+ * counts at 256 cycles per carrier period, not measurements.)
+ *
+ * Build flags:
+ *
+ *   LLAVR_SAMPLE_PLAYER_TIMER  n (0..5): define timer n's overflow vector in
+ *                              SamplePlayer.cpp, calling the player begun
+ *                              on Timern directly; LLAVR_NO_TIMERn_ISRS must
+ *                              be defined too (or the vector is defined
+ *                              twice), so timer n's callbacks are unavailable
+ *
+ * Example:
+ *
+ *   extern const uint8_t chime[] PROGMEM;
+ *
+ *   SamplePlayer speaker(&Timer1, TIMER_OCR_A);
+ *
+ *   speaker.begin();
+ *   speaker.play(chime, sizeof(chime));
+ */
+
+/**
+ * @brief Where samples are being taken from
+ */
+typedef enum {
+    SAMPLE_SOURCE_NONE,         ///< not playing
+    SAMPLE_SOURCE_PROGMEM,      ///< a table in flash
+    SAMPLE_SOURCE_RAM,          ///< double-buffered RAM
+} SampleSource;
+
+class SamplePlayer {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param timer The timer generating the carrier
+     * @param channel The output compare channel (and pin) to output on
+     */
+    SamplePlayer(HardwareTimer *timer, TimerCompareChannel channel);
+
+    /**
+     * @brief Start the carrier, at the idle (mid) level
+     *
+     * NOTE: On 8-bit timers TOP is always 0xFF, and the given value is
+     *   ignored.
+     *
+     * @param top The carrier's TOP value (defaults to 0xFF)
+     * @param divider Carrier periods per sample (defaults to 4)
+     * @param sigmaDelta Whether to use sigma-delta mode (defaults to false)
+     */
+    void begin(uint8_t top = 0xFF, uint8_t divider = 4, bool sigmaDelta = false);
+
+    /**
+     * @brief Stop playback and the carrier, disconnecting the output
+     */
+    void end();
+
+    /**
+     * @brief Get the sample rate, in Hz (rounded down)
+     */
+    uint32_t getSampleRate();
+
+    /**
+     * @brief Play samples from flash
+     *
+     * @param samples The samples (in PROGMEM)
+     * @param count The number of samples
+     * @param loop Whether to restart at the end, until stop() (defaults to
+     *   false)
+     */
+    void play(const uint8_t *samples, uint16_t count, bool loop = false);
+
+    /**
+     * @brief Play samples from two RAM buffers, refilled by the application
+     *   (see getFreeBuffer())
+     *
+     * NOTE: Playback starts when the first buffer is submitted; when a
+     *   buffer runs out before the other is submitted, the last sample is
+     *   held and an underrun counted.
+     *
+     * @param bufferA The first buffer
+     * @param bufferB The second buffer
+     * @param size The number of samples in each buffer
+     */
+    void stream(uint8_t *bufferA, uint8_t *bufferB, uint16_t size);
+
+    /**
+     * @brief Get a buffer to fill with samples, then submit with
+     *   submitBuffer()
+     *
+     * @return A buffer of the size given to stream(), or NULL if both are
+     *   waiting to be played
+     */
+    uint8_t *getFreeBuffer();
+
+    /**
+     * @brief Queue the buffer returned by getFreeBuffer() to be played
+     */
+    void submitBuffer();
+
+    /**
+     * @brief Stop playback, returning the output to the idle level
+     */
+    void stop();
+
+    /**
+     * @brief Check whether samples are being played
+     */
+    bool isPlaying();
+
+    /**
+     * @brief Get the number of samples held because no buffer was ready
+     */
+    uint16_t getUnderruns();
+
+    /**
+     * @brief Output the next carrier period's level
+     *
+     * NOTE: Called from the overflow ISR; not for use by applications.
+     */
+    void handleOverflow();
+
+private:
+    /**
+     * @brief Overflow callback; context is the SamplePlayer
+     */
+    static void onOverflow(void *context);
+
+    /**
+     * @brief Write a level to OCRnx, from the ISR
+     */
+    void writeLevel(uint8_t level);
+
+    /**
+     * @brief Get the next sample from the source
+     */
+    uint8_t nextSample();
+
+    HardwareTimer *timer;       ///< carrier timer
+    TimerCompareChannel channel;///< output channel
+    volatile uint8_t *ocrH, *ocrL;  ///< the channel's OCRnx (ocrH NOREG if 8-bit)
+    volatile uint8_t *timsk;    ///< the timer's TIMSKn
+    uint16_t levels;            ///< carrier levels (TOP + 1)
+    uint8_t divider;            ///< carrier periods per sample
+    bool sigmaDelta;            ///< carry the fraction between periods
+
+    uint8_t countdown;          ///< carrier periods left of the sample
+    uint16_t scaled;            ///< sample * levels (8 fraction bits)
+    uint8_t residue;            ///< sigma-delta accumulated fraction
+
+    volatile SampleSource source;   ///< sample source
+    const uint8_t *samples;     ///< flash samples
+    uint16_t count;             ///< flash sample count
+    uint16_t index;             ///< next sample in the table/buffer
+    bool loop;                  ///< restart the flash samples at the end
+
+    uint8_t *buffers[2];        ///< RAM buffers
+    uint16_t size;              ///< samples per RAM buffer
+    volatile bool full[2];      ///< buffer submitted and not yet played
+    volatile uint8_t readBuffer;///< buffer being played
+    uint8_t fillBuffer;         ///< buffer given out by getFreeBuffer()
+    uint8_t lastSample;         ///< sample held on underrun
+    volatile uint16_t underruns;///< samples held
+};
+
+#endif /* LLAVR_SAMPLE_PLAYER_H_ */
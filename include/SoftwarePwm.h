@@ -0,0 +1,192 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_SOFTWARE_PWM_H_
+#define LLAVR_SOFTWARE_PWM_H_
+
+#include "llavr-common.h"
+#include "HardwareTimer.h"
+
+/*
+ * Software PWM on arbitrary output pins, driven by one timer's channel A
+ * compare match interrupt.
+ *
+ * All channels share one period. At the start of each period, every channel
+ * with a non-zero duty is set with one write per port; after that, the
+ * interrupt only fires at the distinct edges of the period, each clearing
+ * all channels of a port that end there with a single mask. The CPU cost is
+ * therefore proportional to the number of distinct duty values, not to the
+ * resolution times the number of channels.
+ *
+ * New duty values are staged with setDuty() and applied together by
+ * commit(), which builds the next edge schedule in a second buffer; the
+ * interrupt switches to it at the start of the next period, so a period
+ * never mixes old and new values.
+ *
+ * The timer runs free in normal mode and the compare register is advanced
+ * from edge to edge, so the timer can't be shared with other uses that need
+ * a different mode; its channels B/C compare interrupts remain available.
+ *
+ * Example (16 heater outputs at 250 Hz, 1000 steps, 4us per step):
+ *
+ *   SoftwarePwm heaters(&Timer3, 1000);
+ *
+ *   Timer3.setPrescaler(TIMER_PRESCALE_64);
+ *   for(i = 0; i < 8; i++) {
+ *       heaters.addChannel(&PORTA, i);
+ *       heaters.addChannel(&PORTC, i);
+ *   }
+ *   heaters.begin();
+ *   ...
+ *   heaters.setDuty(0, 250);
+ *   heaters.setDuty(1, 900);
+ *   heaters.commit();
+ */
+
+/** @brief Maximum number of channels */
+#if !defined(SOFTPWM_MAX_CHANNELS)
+#define SOFTPWM_MAX_CHANNELS    24
+#endif
+
+/** @brief Maximum number of distinct ports the channels may be on */
+#if !defined(SOFTPWM_MAX_PORTS)
+#define SOFTPWM_MAX_PORTS       4
+#endif
+
+/**
+ * @brief Minimum number of timer ticks between two interrupts
+ *
+ * Must cover the compare interrupt's worst-case run time plus the latency of
+ * other interrupts at the timer's prescale (40 ticks suits a prescale of 8
+ * at 16 MHz). Edges closer together than this are merged, so duty values
+ * are quantized where they crowd, and duty values within this distance of
+ * either end of the period are clamped to it (or to fully off/on).
+ */
+#if !defined(SOFTPWM_MIN_GAP)
+#define SOFTPWM_MIN_GAP         40
+#endif
+
+/**
+ * @brief One edge of the schedule: clear mask on the given port at time
+ */
+typedef struct {
+    uint16_t time;          ///< ticks from the start of the period
+    uint8_t port;           ///< port index
+    uint8_t mask;           ///< bits to clear
+} SoftPwmEdge;
+
+/**
+ * @brief An edge schedule for one period
+ */
+typedef struct {
+    uint8_t setMask[SOFTPWM_MAX_PORTS];     ///< bits set at period start
+    SoftPwmEdge edges[SOFTPWM_MAX_CHANNELS];///< edges, ordered by time
+    uint8_t edgeCount;                      ///< number of edges
+} SoftPwmSchedule;
+
+class SoftwarePwm {
+public:
+    /**
+     * @brief Constructor
+     *
+     * NOTE: On an 8-bit timer the period may be at most 256 ticks.
+     *
+     * @param timer The timer to use (channel A's compare interrupt is taken)
+     * @param period The PWM period, in timer ticks
+     */
+    SoftwarePwm(HardwareTimer *timer, uint16_t period);
+
+    /**
+     * @brief Add a channel and set its pin as an output (driven low)
+     *
+     * @param port The pin's PORTx register
+     * @param pin The pin's bit number in the port
+     *
+     * @return The channel number, or -1 if no channel or port slot is left
+     */
+    int8_t addChannel(volatile uint8_t *port, uint8_t pin);
+
+    /**
+     * @brief Stage a channel's duty; takes effect on commit()
+     *
+     * @param channel The channel number
+     * @param duty The high time, in timer ticks (0 is off, >= period is on)
+     */
+    void setDuty(uint8_t channel, uint16_t duty);
+
+    /**
+     * @brief Get a channel's staged duty
+     */
+    uint16_t getDuty(uint8_t channel);
+
+    /**
+     * @brief Get the period, in timer ticks
+     */
+    uint16_t getPeriod();
+
+    /**
+     * @brief Apply the staged duty values, from the start of the next period
+     *
+     * NOTE: If called again before that period starts, the earlier values
+     *   are replaced without ever being output.
+     */
+    void commit();
+
+    /**
+     * @brief Start output; the timer's prescaler must be set beforehand
+     *
+     * NOTE: Puts the timer in normal mode and commits the staged duty values.
+     */
+    void begin();
+
+    /**
+     * @brief Stop output and drive all channels low
+     */
+    void end();
+
+private:
+    /**
+     * @brief Compare match callback; context is the SoftwarePwm
+     */
+    static void onCompare(void *context);
+
+    /**
+     * @brief Output the next scheduled event and schedule the one after it
+     */
+    void handleCompare();
+
+    HardwareTimer *timer;       ///< timer driving the schedule
+    uint16_t period;            ///< period, in ticks
+
+    volatile uint8_t *ports[SOFTPWM_MAX_PORTS]; ///< PORTx registers in use
+    uint8_t portMask[SOFTPWM_MAX_PORTS];        ///< channel bits per port
+    uint8_t numPorts;                           ///< ports in use
+
+    uint8_t channelPort[SOFTPWM_MAX_CHANNELS];  ///< port index per channel
+    uint8_t channelMask[SOFTPWM_MAX_CHANNELS];  ///< port bit per channel
+    uint16_t duty[SOFTPWM_MAX_CHANNELS];        ///< staged duty per channel
+    uint8_t numChannels;                        ///< channels in use
+
+    SoftPwmSchedule schedules[2];   ///< active and next schedule
+    volatile uint8_t active;        ///< index of the schedule being output
+    volatile bool pending;          ///< the other schedule is ready to use
+
+    uint8_t nextEdge;               ///< next edge, or the period start
+    uint16_t periodStart;           ///< timer count the next period starts at
+};
+
+#endif /* LLAVR_SOFTWARE_PWM_H_ */
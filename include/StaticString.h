@@ -0,0 +1,271 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_STATIC_STRING_H_
+#define LLAVR_STATIC_STRING_H_
+
+#include "llavr-common.h"
+#include "WString.h"
+#include "Printable.h"
+
+class Print;
+
+/**
+ * @brief Fixed-capacity string operations, shared by all StaticString<N>
+ *
+ * Implements the String API on top of a character array owned by the derived
+ * StaticString<N>, so the code is only instantiated once no matter how many
+ * capacities are in use. Never calls the allocator.
+ *
+ * NOTE: Operations that would exceed the capacity fail and leave the string
+ *   unchanged (and return false where String would), except operator= and
+ *   construction, which truncate to the capacity as String's API can't
+ *   report failure there; use assign() to detect a value that doesn't fit.
+ */
+class StaticStringBase : public Printable {
+public:
+    /**
+     * @brief Get the number of characters in the string
+     */
+    inline unsigned int length() const {
+        return len;
+    }
+
+    /**
+     * @brief Get the maximum number of characters the string can hold
+     */
+    inline unsigned int capacity() const {
+        return cap;
+    }
+
+    /**
+     * @brief Get the string as a NUL-terminated array
+     */
+    inline const char *c_str() const {
+        return buffer;
+    }
+
+    /**
+     * @brief Make the string empty
+     */
+    void clear();
+
+    // assignment (truncates to capacity)
+    StaticStringBase &operator=(const StaticStringBase &rhs);
+    StaticStringBase &operator=(const String &rhs);
+    StaticStringBase &operator=(const char *cstr);
+    StaticStringBase &operator=(const __FlashStringHelper *pstr);
+
+    // checked assignment; returns true on success, false if the value would
+    // not fit (or is NULL/invalid), in which case the string is left unchanged
+    unsigned char assign(const StaticStringBase &str);
+    unsigned char assign(const String &str);
+    unsigned char assign(const char *cstr);
+    unsigned char assign(const char *cstr, unsigned int length);
+    unsigned char assign(const __FlashStringHelper *pstr);
+
+    // concatenation; returns true on success, false if the result would not
+    // fit (in which case the string is left unchanged)
+    unsigned char concat(const StaticStringBase &str);
+    unsigned char concat(const String &str);
+    unsigned char concat(const char *cstr);
+    unsigned char concat(const char *cstr, unsigned int length);
+    unsigned char concat(const __FlashStringHelper *pstr);
+    unsigned char concat(char c);
+    unsigned char concat(unsigned char num);
+    unsigned char concat(int num);
+    unsigned char concat(unsigned int num);
+    unsigned char concat(long num);
+    unsigned char concat(unsigned long num);
+
+    StaticStringBase &operator+=(const StaticStringBase &rhs) {concat(rhs); return *this;}
+    StaticStringBase &operator+=(const String &rhs) {concat(rhs); return *this;}
+    StaticStringBase &operator+=(const char *cstr) {concat(cstr); return *this;}
+    StaticStringBase &operator+=(const __FlashStringHelper *pstr) {concat(pstr); return *this;}
+    StaticStringBase &operator+=(char c) {concat(c); return *this;}
+    StaticStringBase &operator+=(unsigned char num) {concat(num); return *this;}
+    StaticStringBase &operator+=(int num) {concat(num); return *this;}
+    StaticStringBase &operator+=(unsigned int num) {concat(num); return *this;}
+    StaticStringBase &operator+=(long num) {concat(num); return *this;}
+    StaticStringBase &operator+=(unsigned long num) {concat(num); return *this;}
+
+    // comparison
+    int compareTo(const char *cstr) const;
+    int compareTo(const StaticStringBase &s) const {return compareTo(s.buffer);}
+    unsigned char equals(const char *cstr, unsigned int length) const;
+    unsigned char equals(const char *cstr) const;
+    unsigned char equals(const StaticStringBase &s) const {return equals(s.buffer, s.len);}
+    unsigned char equals(const String &s) const {return equals(s.c_str(), s.length());}
+    unsigned char equals(const __FlashStringHelper *pstr) const;
+    unsigned char operator==(const StaticStringBase &rhs) const {return equals(rhs);}
+    unsigned char operator==(const String &rhs) const {return equals(rhs);}
+    unsigned char operator==(const char *cstr) const {return equals(cstr);}
+    unsigned char operator==(const __FlashStringHelper *pstr) const {return equals(pstr);}
+    unsigned char operator!=(const StaticStringBase &rhs) const {return !equals(rhs);}
+    unsigned char operator!=(const String &rhs) const {return !equals(rhs);}
+    unsigned char operator!=(const char *cstr) const {return !equals(cstr);}
+    unsigned char operator!=(const __FlashStringHelper *pstr) const {return !equals(pstr);}
+    unsigned char operator<(const StaticStringBase &rhs) const {return compareTo(rhs) < 0;}
+    unsigned char operator>(const StaticStringBase &rhs) const {return compareTo(rhs) > 0;}
+    unsigned char operator<=(const StaticStringBase &rhs) const {return compareTo(rhs) <= 0;}
+    unsigned char operator>=(const StaticStringBase &rhs) const {return compareTo(rhs) >= 0;}
+    unsigned char equalsIgnoreCase(const char *cstr) const;
+    unsigned char startsWith(const char *prefix, unsigned int offset = 0) const;
+    unsigned char startsWith(const __FlashStringHelper *prefix, unsigned int offset = 0) const;
+    unsigned char endsWith(const char *suffix) const;
+
+    // character access
+    char charAt(unsigned int index) const {return operator[](index);}
+    void setCharAt(unsigned int index, char c);
+    char operator[](unsigned int index) const;
+    char &operator[](unsigned int index);
+    void getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index = 0) const;
+    void toCharArray(char *buf, unsigned int bufsize, unsigned int index = 0) const
+        {getBytes((unsigned char *)buf, bufsize, index);}
+
+    // search
+    int indexOf(char ch, unsigned int fromIndex = 0) const;
+    int indexOf(const char *str, unsigned int fromIndex = 0) const;
+    int indexOf(const __FlashStringHelper *str, unsigned int fromIndex = 0) const;
+    int lastIndexOf(char ch) const {return lastIndexOf(ch, len - 1);}
+    int lastIndexOf(char ch, unsigned int fromIndex) const;
+    int lastIndexOf(const char *str) const;
+    int lastIndexOf(const char *str, unsigned int fromIndex) const;
+
+    // modification
+    void replace(char find, char replace);
+    unsigned char replace(const char *find, const char *replace);
+    void remove(unsigned int index, unsigned int count = (unsigned int)-1);
+    void toLowerCase();
+    void toUpperCase();
+    void trim();
+
+    // parsing/conversion
+    long toInt() const;
+    float toFloat() const;
+
+    /**
+     * @brief Get a heap-allocated String copy of this string
+     */
+    String toString() const {return String(buffer);}
+
+    virtual size_t printTo(Print &p) const;
+
+protected:
+    /**
+     * @brief Constructor (used by StaticString<N>)
+     *
+     * @param storage The character array to use; must hold capacity + 1 chars
+     * @param capacity The maximum number of characters
+     */
+    StaticStringBase(char *storage, unsigned int capacity)
+        : buffer(storage), cap(capacity), len(0) {
+        buffer[0] = 0;
+    }
+
+    /**
+     * @brief Replace the contents with the given characters, truncating to
+     *   the capacity
+     */
+    void copy(const char *cstr, unsigned int length);
+    void copy(const __FlashStringHelper *pstr, unsigned int length);
+
+    /**
+     * @brief Copy characters [left, right) of this string into out
+     */
+    void substringTo(StaticStringBase &out, unsigned int left, unsigned int right) const;
+
+    char *buffer;           ///< character array (owned by StaticString<N>)
+    unsigned int cap;       ///< maximum number of characters
+    unsigned int len;       ///< current number of characters
+
+private:
+    // the buffer pointer must never be copied between objects
+    StaticStringBase(const StaticStringBase &);
+};
+
+/**
+ * @brief String with inline storage for up to N characters
+ *
+ * Offers the same search, modification and comparison methods as String,
+ * prints via Print::print() and interoperates with String, but never uses the
+ * heap, so memory use is fixed at compile time.
+ *
+ * Example:
+ *   StaticString<32> msg("x=");
+ *   msg += x;
+ *   Serial.println(msg);
+ *
+ *   StaticString<8> id;
+ *   if(!id.assign(received)) { ... }   // too long for 8 characters
+ */
+template<unsigned int N>
+class StaticString : public StaticStringBase {
+public:
+    StaticString() : StaticStringBase(storage, N) {}
+    StaticString(const char *cstr) : StaticStringBase(storage, N) {*this = cstr;}
+    StaticString(const String &str) : StaticStringBase(storage, N) {*this = str;}
+    StaticString(const __FlashStringHelper *pstr) : StaticStringBase(storage, N) {*this = pstr;}
+    StaticString(const StaticStringBase &str) : StaticStringBase(storage, N) {*this = str;}
+    StaticString(const StaticString &str) : StaticStringBase(storage, N) {*this = str;}
+    explicit StaticString(char c) : StaticStringBase(storage, N) {concat(c);}
+    explicit StaticString(unsigned char num) : StaticStringBase(storage, N) {concat(num);}
+    explicit StaticString(int num) : StaticStringBase(storage, N) {concat(num);}
+    explicit StaticString(unsigned int num) : StaticStringBase(storage, N) {concat(num);}
+    explicit StaticString(long num) : StaticStringBase(storage, N) {concat(num);}
+    explicit StaticString(unsigned long num) : StaticStringBase(storage, N) {concat(num);}
+
+    StaticString &operator=(const StaticString &rhs) {
+        StaticStringBase::operator=(rhs);
+        return *this;
+    }
+
+    StaticString &operator=(const StaticStringBase &rhs) {
+        StaticStringBase::operator=(rhs);
+        return *this;
+    }
+
+    StaticString &operator=(const String &rhs) {
+        StaticStringBase::operator=(rhs);
+        return *this;
+    }
+
+    StaticString &operator=(const char *cstr) {
+        StaticStringBase::operator=(cstr);
+        return *this;
+    }
+
+    StaticString &operator=(const __FlashStringHelper *pstr) {
+        StaticStringBase::operator=(pstr);
+        return *this;
+    }
+
+    StaticString substring(unsigned int beginIndex) const {
+        return substring(beginIndex, len);
+    }
+
+    StaticString substring(unsigned int beginIndex, unsigned int endIndex) const {
+        StaticString out;
+        substringTo(out, beginIndex, endIndex);
+        return out;
+    }
+
+private:
+    char storage[N + 1];
+};
+
+#endif /* LLAVR_STATIC_STRING_H_ */
@@ -0,0 +1,292 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_STEPPER_H_
+#define LLAVR_STEPPER_H_
+
+#include "llavr-common.h"
+#include "HardwareTimer.h"
+
+/*
+ * Step/direction stepper motor control, timed by a 16-bit timer.
+ *
+ * A StepperMotion runs moves on one or more axes (StepperAxis) from its
+ * timer's compare A interrupt, with the timer in CTC mode and TOP set to the
+ * interval until the next step. Moves follow a trapezoidal speed profile:
+ * constant acceleration up to the maximum speed, and constant deceleration
+ * to a stop at the target. The intervals are computed step by step with
+ * integer math only, using the approximation of D. Austin ("Generate stepper
+ * motor speed profiles in real time"):
+ *
+ *   c[0] = 0.676 * f * sqrt(2 / a)
+ *   c[n] = c[n-1] - 2 * c[n-1] / (4n + 1)
+ *
+ * (f the timer frequency, a the acceleration in steps/s^2), run backwards
+ * to decelerate.
+ *
+ * The axes of a StepperMotion move together along a straight line: the axis
+ * with the most steps follows the profile, and the others step in
+ * proportion using Bresenham's line algorithm, so all of them arrive at the
+ * same time. Independent motions run on separate timers (Timer1/3/4/5).
+ *
+ * Example (an XY table on Timer1, drivers on PORTA):
+ *
+ *   StepperAxis x(&PORTA, 0, &PORTA, 1);
+ *   StepperAxis y(&PORTA, 2, &PORTA, 3);
+ *   StepperMotion table(&Timer1);
+ *
+ *   table.addAxis(&x);
+ *   table.addAxis(&y);
+ *   table.setMaxSpeed(8000);       // steps/s
+ *   table.setAcceleration(20000);  // steps/s^2
+ *
+ *   int32_t steps[] = { 4000, -1500 };
+ *   table.move(steps);
+ *   while(table.isRunning()) { ... }
+ */
+
+/** @brief Maximum number of axes of a StepperMotion */
+#if !defined(STEPPER_MAX_AXES)
+#define STEPPER_MAX_AXES        4
+#endif
+
+/** @brief Frequency of the step timer (prescale of 8) */
+#define STEPPER_TIMER_HZ        (F_CPU / 8)
+
+/**
+ * @brief Shortest step interval, in timer ticks
+ *
+ * The step interrupt must finish within one interval, including the
+ * division of the acceleration ramps, so this bounds the maximum speed
+ * (50 us, 20000 steps/s, at 16 MHz).
+ */
+#if !defined(STEPPER_MIN_INTERVAL)
+#define STEPPER_MIN_INTERVAL    (STEPPER_TIMER_HZ / 20000)
+#endif
+
+/**
+ * @brief Minimum step pulse width, in microseconds
+ *
+ * Step pins are raised at the start of the step interrupt and lowered at its
+ * end, once at least this long after the step (enough for the common
+ * A4988/DRV8825/TMC drivers).
+ */
+#if !defined(STEPPER_PULSE_US)
+#define STEPPER_PULSE_US        2
+#endif
+
+/**
+ * @brief Speed profile phase of a StepperMotion
+ */
+typedef enum {
+    STEPPER_IDLE,               ///< no move in progress
+    STEPPER_ACCEL,              ///< accelerating
+    STEPPER_RUN,                ///< at the maximum speed
+    STEPPER_DECEL,              ///< decelerating to a stop
+} StepperState;
+
+/**
+ * @brief One step/direction driver
+ */
+class StepperAxis {
+public:
+    /**
+     * @brief Constructor
+     *
+     * NOTE: The pins are set up as outputs when the axis is added to a
+     *   StepperMotion.
+     *
+     * @param stepPort The PORTx register of the step pin
+     * @param stepPin The step pin's bit number in its port
+     * @param dirPort The PORTx register of the direction pin
+     * @param dirPin The direction pin's bit number in its port
+     * @param invertDir Whether positive moves drive the direction pin low
+     *   (defaults to false)
+     */
+    StepperAxis(volatile uint8_t *stepPort, uint8_t stepPin,
+            volatile uint8_t *dirPort, uint8_t dirPin, bool invertDir = false);
+
+    /**
+     * @brief Set the step and direction pins as outputs (driven low)
+     */
+    void begin();
+
+    /**
+     * @brief Get the position, in steps
+     */
+    int32_t getPosition();
+
+    /**
+     * @brief Set the position, in steps
+     *
+     * NOTE: Must not be called while the axis is moving.
+     */
+    void setPosition(int32_t position);
+
+    /**
+     * @brief Set the direction pin for a move
+     *
+     * @param forward Whether the position increases with each step
+     */
+    void setDirection(bool forward);
+
+    /**
+     * @brief Raise the step pin and count the step
+     *
+     * NOTE: Called from the step interrupt; not for use by applications.
+     */
+    inline void stepBegin() {
+        *stepPort |= stepMask;
+        position += direction;
+    }
+
+    /**
+     * @brief Lower the step pin
+     *
+     * NOTE: Called from the step interrupt; not for use by applications.
+     */
+    inline void stepEnd() {
+        *stepPort &= ~stepMask;
+    }
+
+private:
+    volatile uint8_t *stepPort; ///< step pin port
+    volatile uint8_t *dirPort;  ///< direction pin port
+    uint8_t stepMask;           ///< step pin bit
+    uint8_t dirMask;            ///< direction pin bit
+    bool invertDir;             ///< drive the direction pin low for forward
+
+    volatile int32_t position;  ///< position, in steps
+    int8_t direction;           ///< +1/-1, step of the current move
+};
+
+/**
+ * @brief Coordinated moves of one or more axes, timed by a 16-bit timer
+ */
+class StepperMotion {
+public:
+    /**
+     * @brief Constructor
+     *
+     * NOTE: The timer's compare A interrupt and its mode and prescaler are
+     *   taken over while moving; the timer must be 16-bit.
+     *
+     * @param timer The timer to time steps with
+     */
+    StepperMotion(HardwareTimer *timer);
+
+    /**
+     * @brief Add an axis, setting up its pins
+     *
+     * @return false if STEPPER_MAX_AXES axes were already added, or a move is
+     *   in progress
+     */
+    bool addAxis(StepperAxis *axis);
+
+    /**
+     * @brief Set the maximum speed, in steps per second, of the axis with the
+     *   most steps in a move
+     *
+     * NOTE: Applies from the next move; limited by STEPPER_MIN_INTERVAL.
+     */
+    void setMaxSpeed(uint16_t stepsPerSecond);
+
+    /**
+     * @brief Set the acceleration (and deceleration), in steps per second per
+     *   second, of the axis with the most steps in a move
+     *
+     * NOTE: Applies from the next move. With a 16-bit timer at
+     *   STEPPER_TIMER_HZ, the first step interval is at most 0xFFFF ticks, so
+     *   the slowest start is about 30 steps/s at 16 MHz; lower accelerations
+     *   take their first step sooner than the profile would.
+     */
+    void setAcceleration(uint16_t stepsPerSecond2);
+
+    /**
+     * @brief Start a move
+     *
+     * @param steps The relative steps of each axis, in the order they were
+     *   added
+     *
+     * @return false if a move is already in progress, or the timer isn't
+     *   16-bit
+     */
+    bool move(const int32_t *steps);
+
+    /**
+     * @brief Decelerate to a stop as soon as possible, along the current line
+     */
+    void stop();
+
+    /**
+     * @brief Stop immediately, without decelerating
+     *
+     * NOTE: Steps may be lost if the motors are moving fast.
+     */
+    void halt();
+
+    /**
+     * @brief Check whether a move is in progress
+     */
+    bool isRunning();
+
+    /**
+     * @brief Get the phase of the move in progress
+     */
+    StepperState getState();
+
+private:
+    /**
+     * @brief Compare match callback; context is the StepperMotion
+     */
+    static void onCompare(void *context);
+
+    /**
+     * @brief Step the axes and compute the interval after the next step
+     */
+    void handleCompare();
+
+    /**
+     * @brief Compute the interval following the given step into nextInterval
+     *
+     * @param n The number of steps taken when the interval starts
+     */
+    void advance(uint32_t n);
+
+    HardwareTimer *timer;       ///< step timer
+
+    StepperAxis *axes[STEPPER_MAX_AXES];    ///< axes
+    uint32_t delta[STEPPER_MAX_AXES];       ///< steps per axis in the move
+    uint32_t error[STEPPER_MAX_AXES];       ///< Bresenham accumulators
+    uint8_t numAxes;                        ///< axes in use
+
+    uint16_t maxSpeed;          ///< maximum speed, in steps/s
+    uint16_t acceleration;      ///< acceleration, in steps/s^2
+    uint16_t minInterval;       ///< interval at the maximum speed
+
+    volatile StepperState state;///< profile phase
+    uint32_t lineSteps;         ///< steps of the dominant axis in the move
+    volatile uint32_t totalSteps;   ///< steps to take (less if stopped early)
+    volatile uint32_t decelStart;   ///< step count deceleration starts at
+    volatile uint32_t stepCount;    ///< steps taken
+    uint32_t rampStep;          ///< acceleration step reached (n)
+    uint32_t interval;          ///< current step interval, in ticks
+    uint32_t rest;              ///< remainder carried between divisions
+    uint16_t nextInterval;      ///< interval to load at the next step
+};
+
+#endif /* LLAVR_STEPPER_H_ */
@@ -0,0 +1,269 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_STRING_ALLOCATOR_H_
+#define LLAVR_STRING_ALLOCATOR_H_
+
+#include "llavr-common.h"
+#include "WString.h"
+
+/*
+ * Pluggable storage for String buffers.
+ *
+ * By default Strings use the heap (malloc/realloc/free). String::setAllocator()
+ * switches all subsequent String allocations to another allocator:
+ *
+ *   StringHeapAllocator    the heap, with statistics (the default)
+ *   StringPool             fixed-size blocks carved from a static array, in
+ *                          STRING_POOL_CLASSES size classes of
+ *                          STRING_POOL_MIN_BLOCK, 2x, 4x, ... bytes
+ *   StringArena            bump allocation from a static array; everything
+ *                          is released at once by reset() (see
+ *                          StringArenaScope)
+ *
+ * Pools and arenas hand pointers they don't own (e.g., buffers of Strings
+ * created before the switch) to their parent allocator, so switching from the
+ * heap to a pool or arena is always safe. Switching back is only safe once
+ * every String using pool/arena storage has been destroyed.
+ *
+ * Inside a StringArenaScope only Strings created in the scope use the arena;
+ * Strings created before it keep using the allocator set when they were
+ * created, even when they grow inside the scope.
+ */
+
+/** @brief Number of size classes in a StringPool */
+#ifndef STRING_POOL_CLASSES
+#define STRING_POOL_CLASSES 3
+#endif
+
+/** @brief Block size of the smallest StringPool size class (bytes) */
+#ifndef STRING_POOL_MIN_BLOCK
+#define STRING_POOL_MIN_BLOCK 16
+#endif
+
+/**
+ * @brief Allocation statistics
+ */
+typedef struct {
+    uint32_t allocations;       ///< successful allocations and reallocations
+    uint32_t failures;          ///< allocations that could not be satisfied
+    size_t inUse;               ///< bytes currently allocated
+    size_t peak;                ///< highest value of inUse
+} StringAllocatorStats;
+
+/**
+ * @brief Allocator interface for String buffers
+ *
+ * Sizes are passed back on reallocate() and release(), so allocators need no
+ * per-block headers.
+ */
+class StringAllocator {
+public:
+    StringAllocator();
+
+    /**
+     * @brief Allocate a block of at least size bytes
+     *
+     * @return the block, or NULL if the request could not be satisfied
+     */
+    virtual void *allocate(size_t size) = 0;
+
+    /**
+     * @brief Resize a block, moving its contents if needed
+     *
+     * @return the (possibly moved) block, or NULL if the request could not be
+     *   satisfied (in which case the original block is left untouched)
+     */
+    virtual void *reallocate(void *ptr, size_t oldSize, size_t newSize) = 0;
+
+    /**
+     * @brief Give a block back
+     */
+    virtual void release(void *ptr, size_t size) = 0;
+
+    /**
+     * @brief Get the size of the largest block that could be allocated now
+     */
+    virtual size_t largestFreeBlock() const = 0;
+
+    /**
+     * @brief Get the allocation statistics
+     */
+    virtual const StringAllocatorStats &stats() const {
+        return counters;
+    }
+
+protected:
+    StringAllocatorStats counters;  ///< statistics for this allocator
+};
+
+/**
+ * @brief The heap, as an allocator
+ *
+ * NOTE: Strings use the heap through the static functions below while no
+ *   allocator is set, so heap statistics include Strings constructed before
+ *   main(); all instances share the same statistics.
+ */
+class StringHeapAllocator : public StringAllocator {
+public:
+    virtual void *allocate(size_t size);
+    virtual void *reallocate(void *ptr, size_t oldSize, size_t newSize);
+    virtual void release(void *ptr, size_t size);
+    virtual size_t largestFreeBlock() const;
+    virtual const StringAllocatorStats &stats() const;
+
+    static void *heapAllocate(size_t size);
+    static void *heapReallocate(void *ptr, size_t oldSize, size_t newSize);
+    static void heapRelease(void *ptr, size_t size);
+};
+
+/** @brief The default parent of pools and arenas */
+extern StringHeapAllocator stringHeap;
+
+/**
+ * @brief Fixed-block pool allocator
+ *
+ * The memory is split evenly between the size classes. A request is served
+ * from the smallest class with a free block that is large enough, so
+ * allocation time doesn't depend on the allocation history and the pool
+ * can't fragment. Requests larger than the biggest block (or made while the
+ * pool is exhausted) go to the parent allocator.
+ */
+class StringPool : public StringAllocator {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param memory The memory to carve blocks from
+     * @param size The size of memory
+     * @param parent Where to send requests the pool can't serve (defaults to
+     *   the heap)
+     */
+    StringPool(void *memory, size_t size, StringAllocator &parent = stringHeap);
+
+    virtual void *allocate(size_t size);
+    virtual void *reallocate(void *ptr, size_t oldSize, size_t newSize);
+    virtual void release(void *ptr, size_t size);
+    virtual size_t largestFreeBlock() const;
+
+    /**
+     * @brief Get the number of free blocks in a size class
+     */
+    size_t freeBlocks(uint8_t sizeClass) const;
+
+private:
+    /**
+     * @brief Get the size class a pointer belongs to
+     *
+     * @return the class, or STRING_POOL_CLASSES for foreign pointers
+     */
+    uint8_t classOf(const void *ptr) const;
+
+    void *freeList[STRING_POOL_CLASSES];            ///< free blocks per class
+    uint8_t *region[STRING_POOL_CLASSES + 1];       ///< class boundaries
+    StringAllocator *parent;                        ///< fallback allocator
+};
+
+/**
+ * @brief Scoped bump allocator
+ *
+ * Allocation just advances a pointer, and growing or releasing the most
+ * recent block is done in place; everything else is only reclaimed by
+ * reset(). Suited to building a response out of temporary Strings.
+ */
+class StringArena : public StringAllocator {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param memory The memory to allocate from
+     * @param size The size of memory
+     * @param parent Owner of pointers not allocated from the arena (defaults
+     *   to the heap)
+     */
+    StringArena(void *memory, size_t size, StringAllocator &parent = stringHeap);
+
+    virtual void *allocate(size_t size);
+    virtual void *reallocate(void *ptr, size_t oldSize, size_t newSize);
+    virtual void release(void *ptr, size_t size);
+    virtual size_t largestFreeBlock() const;
+
+    /**
+     * @brief Release every block in the arena
+     *
+     * NOTE: No String using arena storage may be alive when this is called.
+     */
+    void reset();
+
+private:
+    /**
+     * @brief Check whether a pointer lies within the arena
+     */
+    bool owns(const void *ptr) const {
+        return (const uint8_t *)ptr >= start && (const uint8_t *)ptr < end;
+    }
+
+    uint8_t *start;             ///< start of the arena memory
+    uint8_t *end;               ///< end of the arena memory
+    uint8_t *top;               ///< first unallocated byte
+    uint8_t *last;              ///< most recent block (NULL if none)
+    StringAllocator *parent;    ///< owner of foreign pointers
+};
+
+/**
+ * @brief Directs allocations of Strings created in the scope to an arena for
+ *   the lifetime of the scope object, then resets the arena
+ *
+ * Strings declared after the scope object in the same block are destroyed
+ * first, so they may use the arena:
+ *
+ *   {
+ *       StringArenaScope scope(arena);
+ *       String reply = F("T=");
+ *       reply += temperature;
+ *       Serial.println(reply);
+ *   }
+ *
+ * Strings created before the scope outlive the arena's reset, so their
+ * buffers never come from it; assigning a scoped String (or a concatenation)
+ * to one copies the value out of the arena.
+ *
+ * NOTE: Scopes nest, up to 127 deep. A String created in a scope must not
+ *   be kept (e.g., returned) beyond it.
+ */
+class StringArenaScope {
+public:
+    StringArenaScope(StringArena &arena);
+    ~StringArenaScope();
+
+    /**
+     * @brief Get the allocator that was set in the given scope (0 is
+     *   outside any scope)
+     *
+     * NOTE: scope must be less than the number of scopes entered.
+     */
+    static StringAllocator *allocatorAt(uint8_t scope);
+
+private:
+    StringArena *arena;         ///< the arena in use
+    StringAllocator *previous;  ///< allocator to restore
+    StringArenaScope *outer;    ///< enclosing scope (NULL if none)
+
+    static StringArenaScope *innermost;     ///< most recently entered scope
+};
+
+#endif /* LLAVR_STRING_ALLOCATOR_H_ */
@@ -0,0 +1,225 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_TASK_SCHEDULER_H_
+#define LLAVR_TASK_SCHEDULER_H_
+
+#include "llavr-common.h"
+#include "HardwareTimer.h"
+
+/*
+ * Cooperative run-to-completion task scheduling.
+ *
+ * Tasks are plain functions run from the main loop by run(), one at a time,
+ * each to completion. A task can be scheduled to run once after a delay or
+ * periodically, and can be woken by an event posted from an ISR (or another
+ * task). Times are in ticks of a timer in CTC mode (1 ms by default).
+ *
+ * Scheduled tasks are kept in a min-heap ordered by due time, so finding
+ * whether anything is due takes one comparison, and rescheduling a task
+ * O(log n); tasks that aren't due are never looked at.
+ *
+ * Per-task statistics (runs, run time, overruns) are kept, timed with the
+ * tick timer's count.
+ *
+ * Example:
+ *
+ *   TaskScheduler scheduler(&Timer0);
+ *
+ *   int8_t blink = scheduler.addTask(onBlink);
+ *   int8_t rx = scheduler.addTask(onPacket, &link);
+ *
+ *   scheduler.schedule(blink, 0, 500);      // now, then every 500 ms
+ *   scheduler.begin();
+ *
+ *   for(;;) {
+ *       if(!scheduler.run()) {
+ *           // nothing ran; could sleep until the next interrupt
+ *       }
+ *   }
+ *
+ *   ISR(...) { ...; scheduler.post(rx); }
+ */
+
+/** @brief Maximum number of tasks (at most 32) */
+#if !defined(SCHEDULER_MAX_TASKS)
+#define SCHEDULER_MAX_TASKS     16
+#endif
+
+/** @brief Tick rate, in Hz */
+#if !defined(SCHEDULER_TICK_HZ)
+#define SCHEDULER_TICK_HZ       1000
+#endif
+
+/**
+ * @brief Rate of the tick timer's count (prescale of 64), which run times are
+ *   measured in
+ */
+#define SCHEDULER_TIMER_HZ      (F_CPU / 64)
+
+/**
+ * @brief Task function
+ *
+ * @param context The context pointer given to addTask()
+ */
+typedef void (*TaskFunction)(void *context);
+
+/**
+ * @brief Per-task statistics
+ *
+ * Times are in ticks of SCHEDULER_TIMER_HZ (4 us at 16 MHz).
+ */
+typedef struct {
+    uint16_t runs;              ///< times run (saturates)
+    uint16_t overruns;          ///< periodic runs started a period or more late
+    uint16_t maxTime;           ///< longest run time (saturates)
+    uint32_t totalTime;         ///< total run time
+} TaskStats;
+
+class TaskScheduler {
+public:
+    /**
+     * @brief Constructor
+     *
+     * NOTE: Timer2's prescale steps differ from the other timers', and aren't
+     *   supported.
+     *
+     * @param timer The tick timer; its mode, prescaler and compare A
+     *   interrupt are taken over by begin()
+     */
+    TaskScheduler(HardwareTimer *timer);
+
+    /**
+     * @brief Start the tick
+     */
+    void begin();
+
+    /**
+     * @brief Stop the tick; scheduled tasks stop coming due
+     */
+    void end();
+
+    /**
+     * @brief Add a task, initially neither scheduled nor posted
+     *
+     * @param function The function to run
+     * @param context Passed to the function (defaults to NULL)
+     *
+     * @return The task number, or -1 if the task table is full
+     */
+    int8_t addTask(TaskFunction function, void *context = NULL);
+
+    /**
+     * @brief Schedule a task, replacing its previous schedule
+     *
+     * @param task The task number
+     * @param delay Ticks until the first run (0 runs it on the next run())
+     * @param period Ticks between runs, or 0 to run once (defaults to 0)
+     */
+    void schedule(uint8_t task, uint32_t delay, uint32_t period = 0);
+
+    /**
+     * @brief Unschedule a task (posted events still run it)
+     */
+    void cancel(uint8_t task);
+
+    /**
+     * @brief Wake a task: it runs on the next run(), once however many
+     *   times it was posted
+     *
+     * NOTE: Safe to use from ISRs.
+     */
+    void post(uint8_t task);
+
+    /**
+     * @brief Run the posted tasks, then the tasks that are due
+     *
+     * NOTE: Tasks that come due (or are posted) while running wait for the
+     *   next call, as do tasks scheduled while running (including a task
+     *   rescheduling itself with no delay).
+     *
+     * @return false if no task ran
+     */
+    bool run();
+
+    /**
+     * @brief Get the number of ticks since begin()
+     */
+    uint32_t getTicks();
+
+    /**
+     * @brief Get a task's statistics
+     */
+    const TaskStats *getStats(uint8_t task);
+
+    /**
+     * @brief Clear the statistics of all tasks
+     */
+    void resetStats();
+
+private:
+    /**
+     * @brief A task table entry
+     */
+    typedef struct {
+        TaskFunction function;  ///< function to run
+        void *context;          ///< function context
+        uint32_t due;           ///< tick the task is due at
+        uint32_t period;        ///< ticks between runs (0 = one-shot)
+        uint8_t heapIndex;      ///< position in the heap (or not queued)
+    } Task;
+
+    /**
+     * @brief Compare match callback; context is the TaskScheduler
+     */
+    static void onTick(void *context);
+
+    /**
+     * @brief Get a fine timestamp (tick * (TOP + 1) + count), to time tasks
+     */
+    uint32_t getTimestamp();
+
+    /**
+     * @brief Run a task, updating its statistics
+     */
+    void execute(uint8_t task);
+
+    /**
+     * @brief Heap operations (keyed by due time)
+     */
+    void heapPush(uint8_t task);
+    void heapRemove(uint8_t position);
+    void heapSiftUp(uint8_t position);
+    void heapSiftDown(uint8_t position);
+    void heapSet(uint8_t position, uint8_t task);
+
+    HardwareTimer *timer;       ///< tick timer
+    uint16_t top;               ///< tick timer TOP
+
+    Task tasks[SCHEDULER_MAX_TASKS];        ///< task table
+    TaskStats stats[SCHEDULER_MAX_TASKS];   ///< task statistics
+    uint8_t numTasks;                       ///< tasks in use
+
+    uint8_t heap[SCHEDULER_MAX_TASKS];      ///< scheduled tasks, min-heap
+    uint8_t heapSize;                       ///< scheduled tasks
+    uint32_t dueNow;                        ///< due tasks not yet run, one bit per task
+
+    volatile uint32_t ticks;    ///< ticks since begin()
+    volatile uint32_t pending;  ///< posted tasks, one bit per task
+};
+
+#endif /* LLAVR_TASK_SCHEDULER_H_ */
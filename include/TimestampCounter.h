@@ -0,0 +1,83 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_TIMESTAMP_COUNTER_H_
+#define LLAVR_TIMESTAMP_COUNTER_H_
+
+#include "llavr-common.h"
+#include "HardwareTimer.h"
+
+/*
+ * Free-running 32-bit timestamps from a timer and a count of its overflows.
+ *
+ * The timer's count gives the low 16 (or 8) bits, and the overflow ISR
+ * counts the rest. Reading both together is done with interrupts disabled,
+ * and a read that races an overflow not yet serviced is corrected with the
+ * timer's overflow flag, so timestamps never step backwards.
+ *
+ * Example (latency measurement at 0.5 us resolution, wrapping after ~35
+ * minutes):
+ *
+ *   TimestampCounter clock(&Timer5);
+ *
+ *   Timer5.setPrescaler(TIMER_PRESCALE_8);
+ *   clock.begin();
+ *   ...
+ *   uint32_t start = clock.now();
+ *   ...
+ *   uint32_t ticks = clock.now() - start;   // correct across wraps
+ */
+class TimestampCounter {
+public:
+    /**
+     * @brief Constructor
+     *
+     * @param timer The timer to count with; a 16-bit timer overflows 256
+     *   times less often than an 8-bit one
+     */
+    TimestampCounter(HardwareTimer *timer);
+
+    /**
+     * @brief Start counting from zero, with the timer's prescaler as set
+     *
+     * NOTE: Puts the timer in normal mode and takes its overflow interrupt.
+     */
+    void begin();
+
+    /**
+     * @brief Stop counting overflows
+     */
+    void end();
+
+    /**
+     * @brief Get the current timestamp, in timer ticks
+     *
+     * NOTE: Safe to use from ISRs; interrupts are disabled while reading.
+     */
+    uint32_t now();
+
+private:
+    /**
+     * @brief Overflow callback; context is the TimestampCounter
+     */
+    static void onOverflow(void *context);
+
+    HardwareTimer *timer;       ///< timer giving the low bits
+    volatile uint32_t overflows;///< timer overflows counted
+};
+
+#endif /* LLAVR_TIMESTAMP_COUNTER_H_ */
@@ -0,0 +1,140 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_TONE_GENERATOR_H_
+#define LLAVR_TONE_GENERATOR_H_
+
+#include "llavr-common.h"
+#include "HardwareTimer.h"
+
+/*
+ * Square wave generation on a timer's OCnA pin.
+ *
+ * The timer runs in CTC mode with channel A toggling its pin at TOP, so a
+ * steady tone costs no CPU time at all. The prescaler and TOP are chosen
+ * for the smallest frequency error over all prescale settings.
+ *
+ * Sequences of notes (frequency and duration) can be played from flash; the
+ * length of a note is counted in half periods by the compare A interrupt,
+ * which only does work at the end of each note.
+ *
+ * Example (alarm on OC1A):
+ *
+ *   static const ToneNote alarm[] PROGMEM = {
+ *       { 2000, 150 }, { 0, 50 }, { 2500, 150 }, { 0, 400 }, { 0, 0 },
+ *   };
+ *
+ *   ToneGenerator buzzer(&Timer1);
+ *
+ *   buzzer.play(alarm, true);       // repeat until stop()
+ *   ...
+ *   buzzer.setFrequency(32768);     // steady calibration clock
+ */
+
+/**
+ * @brief Rate the timer runs at during rests, so their length can be counted
+ */
+#define TONE_REST_FREQUENCY     1000
+
+/**
+ * @brief One note of a sequence
+ *
+ * A duration of zero ends the sequence.
+ */
+typedef struct {
+    uint16_t frequency;         ///< frequency in Hz, or 0 for a rest
+    uint16_t duration;          ///< duration in milliseconds
+} ToneNote;
+
+class ToneGenerator {
+public:
+    /**
+     * @brief Constructor
+     *
+     * NOTE: Timer2's prescale steps differ from the other timers', and aren't
+     *   supported.
+     *
+     * @param timer The timer to use; its OCnA pin is the output
+     */
+    ToneGenerator(HardwareTimer *timer);
+
+    /**
+     * @brief Output a square wave of (close to) the given frequency until
+     *   stop() or the next call
+     *
+     * NOTE: Stops any sequence being played.
+     *
+     * @param frequency The frequency in Hz
+     *
+     * @return The frequency generated, rounded to Hz; 0 (and no output) if
+     *   the frequency is 0 or out of the timer's range
+     */
+    uint32_t setFrequency(uint32_t frequency);
+
+    /**
+     * @brief Play a sequence of notes from flash
+     *
+     * @param notes The notes (in PROGMEM), ending with a zero duration
+     * @param repeat Whether to restart the sequence at its end (defaults to
+     *   false)
+     */
+    void play(const ToneNote *notes, bool repeat = false);
+
+    /**
+     * @brief Stop the output (the pin is left low) and any sequence
+     */
+    void stop();
+
+    /**
+     * @brief Check whether a sequence is being played
+     */
+    bool isPlaying();
+
+private:
+    /**
+     * @brief Compare match callback; context is the ToneGenerator
+     */
+    static void onCompare(void *context);
+
+    /**
+     * @brief Count a half period of the current note
+     */
+    void handleCompare();
+
+    /**
+     * @brief Start the next note of the sequence, or end the sequence
+     */
+    void nextNote();
+
+    /**
+     * @brief Run the timer at the given frequency, with or without output
+     *
+     * @return The half period in CPU cycles (prescale * (TOP + 1)), or 0 if
+     *   the frequency is out of range
+     */
+    uint32_t configure(uint32_t frequency, bool output);
+
+    HardwareTimer *timer;       ///< timer generating the wave
+
+    const ToneNote *notes;      ///< sequence being played (PROGMEM)
+    uint8_t next;               ///< index of the next note
+    bool repeat;                ///< restart the sequence at its end
+    volatile bool playing;      ///< a sequence is being played
+    uint32_t remaining;         ///< half periods left of the current note
+};
+
+#endif /* LLAVR_TONE_GENERATOR_H_ */
@@ -34,13 +34,43 @@
 //     -felide-constructors
 //     -std=c++0x
 
+// Strings of up to STRING_SSO_SIZE - 1 characters are stored inside the
+// String object itself instead of on the heap.  The inline buffer overlays
+// the heap capacity field, so it can't be smaller than that; every byte
+// beyond it grows every String (members, array elements) by a byte.  On AVR
+// sizeof(String) is 5 + STRING_SSO_SIZE: 13 bytes by default, against 7
+// before inline storage.  On parts with little RAM and many Strings, define
+// STRING_SSO_SIZE as 2 for the original 7 bytes (only "" and one character
+// values are then stored inline).
+#ifndef STRING_SSO_SIZE
+#define STRING_SSO_SIZE 8
+#endif
+#if STRING_SSO_SIZE < 2
+#error "STRING_SSO_SIZE must be at least 2"
+#endif
+
+// Growth policy for concatenation: when appending needs a bigger heap
+// buffer, capacity grows by capacity >> STRING_GROWTH_SHIFT extra bytes
+// (i.e. 1.5x by default), but by no more than STRING_GROWTH_MAX_SLACK.
+// Set STRING_GROWTH_MAX_SLACK to 0 to always allocate an exact fit.
+#ifndef STRING_GROWTH_SHIFT
+#define STRING_GROWTH_SHIFT 1
+#endif
+#ifndef STRING_GROWTH_MAX_SLACK
+#define STRING_GROWTH_MAX_SLACK 32
+#endif
+
 class __FlashStringHelper;
+class StringAllocator;
 #define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(PSTR(string_literal)))
 
-// An inherited class for holding the result of a concatenation.  These
-// result objects are assumed to be writable by subsequent concatenations.
+// An inherited class formerly used for holding the result of a
+// concatenation; kept for source compatibility.
 class StringSumHelper;
 
+// A lazily evaluated concatenation ("a" + s + 5 + ...).  See below.
+template<typename L, typename R> class StringConcat;
+
 // The string class
 class String
 {
@@ -58,6 +88,7 @@ public:
 	// be false).
 	String(const char *cstr = "");
 	String(const String &str);
+	String(const __FlashStringHelper *pstr);
 	#ifdef __GXX_EXPERIMENTAL_CXX0X__
 	String(String &&rval);
 	String(StringSumHelper &&rval);
@@ -68,6 +99,8 @@ public:
 	explicit String(unsigned int, unsigned char base=10);
 	explicit String(long, unsigned char base=10);
 	explicit String(unsigned long, unsigned char base=10);
+	// evaluates a concatenation expression with a single allocation
+	template<typename L, typename R> String(const StringConcat<L, R> &expr);
 	~String(void);
 
 	// memory management
@@ -77,15 +110,26 @@ public:
 	unsigned char reserve(unsigned int size);
 	inline unsigned int length(void) const {return len;}
 
+	// release any spare capacity left by the growth policy (short values
+	// move back into the String object).  returns true on success, false
+	// on failure (in which case the string is left unchanged).
+	unsigned char shrinkToFit(void);
+	// where new String buffers come from (see StringAllocator.h); NULL
+	// selects the heap
+	static void setAllocator(StringAllocator *alloc) {allocator = alloc;}
+	static StringAllocator * getAllocator(void) {return allocator;}
+
 	// creates a copy of the assigned value.  if the value is null or
 	// invalid, or if the memory allocation fails, the string will be 
 	// marked as invalid ("if (s)" will be false).
 	String & operator = (const String &rhs);
 	String & operator = (const char *cstr);
+	String & operator = (const __FlashStringHelper *pstr);
 	#ifdef __GXX_EXPERIMENTAL_CXX0X__
 	String & operator = (String &&rval);
 	String & operator = (StringSumHelper &&rval);
 	#endif
+	template<typename L, typename R> String & operator = (const StringConcat<L, R> &expr);
 
 	// concatenate (works w/ built-in types)
 	
@@ -94,42 +138,42 @@ public:
 	// concatenation is considered unsucessful.  
 	unsigned char concat(const String &str);
 	unsigned char concat(const char *cstr);
+	unsigned char concat(const __FlashStringHelper *pstr);
 	unsigned char concat(char c);
 	unsigned char concat(unsigned char c);
 	unsigned char concat(int num);
 	unsigned char concat(unsigned int num);
 	unsigned char concat(long num);
 	unsigned char concat(unsigned long num);
+	template<typename L, typename R> unsigned char concat(const StringConcat<L, R> &expr);
 	
 	// if there's not enough memory for the concatenated value, the string
 	// will be left unchanged (but this isn't signalled in any way)
 	String & operator += (const String &rhs)	{concat(rhs); return (*this);}
 	String & operator += (const char *cstr)		{concat(cstr); return (*this);}
+	String & operator += (const __FlashStringHelper *pstr)	{concat(pstr); return (*this);}
 	String & operator += (char c)			{concat(c); return (*this);}
 	String & operator += (unsigned char num)		{concat(num); return (*this);}
 	String & operator += (int num)			{concat(num); return (*this);}
 	String & operator += (unsigned int num)		{concat(num); return (*this);}
 	String & operator += (long num)			{concat(num); return (*this);}
 	String & operator += (unsigned long num)	{concat(num); return (*this);}
+	template<typename L, typename R>
+	String & operator += (const StringConcat<L, R> &expr)	{concat(expr); return (*this);}
 
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, const String &rhs);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, const char *cstr);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, char c);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, unsigned char num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, int num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, unsigned int num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, long num);
-	friend StringSumHelper & operator + (const StringSumHelper &lhs, unsigned long num);
-
-	// comparison (only works w/ Strings and "strings")
+	// comparison (only works w/ Strings, "strings" and F("strings");
+	// flash strings are read in place, not copied to RAM first)
 	operator StringIfHelperType() const { return buffer ? &String::StringIfHelper : 0; }
 	int compareTo(const String &s) const;
 	unsigned char equals(const String &s) const;
 	unsigned char equals(const char *cstr) const;
+	unsigned char equals(const __FlashStringHelper *pstr) const;
 	unsigned char operator == (const String &rhs) const {return equals(rhs);}
 	unsigned char operator == (const char *cstr) const {return equals(cstr);}
+	unsigned char operator == (const __FlashStringHelper *pstr) const {return equals(pstr);}
 	unsigned char operator != (const String &rhs) const {return !equals(rhs);}
 	unsigned char operator != (const char *cstr) const {return !equals(cstr);}
+	unsigned char operator != (const __FlashStringHelper *pstr) const {return !equals(pstr);}
 	unsigned char operator <  (const String &rhs) const;
 	unsigned char operator >  (const String &rhs) const;
 	unsigned char operator <= (const String &rhs) const;
@@ -137,6 +181,8 @@ public:
 	unsigned char equalsIgnoreCase(const String &s) const;
 	unsigned char startsWith( const String &prefix) const;
 	unsigned char startsWith(const String &prefix, unsigned int offset) const;
+	unsigned char startsWith(const __FlashStringHelper *prefix) const;
+	unsigned char startsWith(const __FlashStringHelper *prefix, unsigned int offset) const;
 	unsigned char endsWith(const String &suffix) const;
 
 	// character acccess
@@ -154,6 +200,8 @@ public:
 	int indexOf( char ch, unsigned int fromIndex ) const;
 	int indexOf( const String &str ) const;
 	int indexOf( const String &str, unsigned int fromIndex ) const;
+	int indexOf( const __FlashStringHelper *str ) const;
+	int indexOf( const __FlashStringHelper *str, unsigned int fromIndex ) const;
 	int lastIndexOf( char ch ) const;
 	int lastIndexOf( char ch, unsigned int fromIndex ) const;
 	int lastIndexOf( const String &str ) const;
@@ -169,24 +217,47 @@ public:
 	void trim(void);
 
 	// parsing/conversion
+	// (see NumberParser.h; out of range values saturate)
 	long toInt(void) const;
+	float toFloat(void) const;
 
 protected:
-	char *buffer;	        // the actual char array
-	unsigned int capacity;  // the array length minus one (for the '\0')
+	char *buffer;	        // the actual char array (heap or storage.sso)
 	unsigned int len;       // the String length (not counting the '\0')
-	unsigned char flags;    // unused, for future features
+	unsigned char flags;    // STRING_FLAG_* bits
+	union {
+		unsigned int capacity;     // heap array length minus one (for the '\0')
+		char sso[STRING_SSO_SIZE]; // inline array for short strings
+	} storage;
 protected:
-	void init(void);
+	enum {
+		STRING_FLAG_INLINE = 0x01,	// buffer points at storage.sso
+		STRING_SCOPE_SHIFT = 1		// the other bits: allocatorScope at construction
+	};
+	inline unsigned char isInline(void) const {return flags & STRING_FLAG_INLINE;}
+	inline unsigned int capacity(void) const
+		{return isInline() ? (STRING_SSO_SIZE - 1) : storage.capacity;}
+	inline unsigned char scope(void) const {return flags >> STRING_SCOPE_SHIFT;}
+	inline void init(void)
+		{buffer = NULL; storage.capacity = 0; len = 0; flags = allocatorScope << STRING_SCOPE_SHIFT;}
 	void invalidate(void);
 	unsigned char changeBuffer(unsigned int maxStrLen);
+	unsigned char reserveGrowth(unsigned int size);
+	static StringAllocator *allocator;
+	// number of StringArenaScopes entered; a String created outside the
+	// innermost scope keeps using the allocator set where it was created
+	static unsigned char allocatorScope;
+	friend class StringArenaScope;
+	StringAllocator *bufferAllocator(void) const;
+	char *allocateBuffer(unsigned int size) const;
+	char *reallocateBuffer(char *ptr, unsigned int oldSize, unsigned int newSize) const;
+	void releaseBuffer(char *ptr, unsigned int size) const;
 	unsigned char concat(const char *cstr, unsigned int length);
 
 	// copy and move
 	String & copy(const char *cstr, unsigned int length);
-	#ifdef __GXX_EXPERIMENTAL_CXX0X__
+	String & copy(const __FlashStringHelper *pstr, unsigned int length);
 	void move(String &rhs);
-	#endif
 };
 
 class StringSumHelper : public String
@@ -202,5 +273,273 @@ public:
 	StringSumHelper(unsigned long num) : String(num) {}
 };
 
+/*
+ * Concatenation with operator+ builds a StringConcat expression instead of
+ * appending to a temporary String piece by piece.  The total length is known
+ * before anything is copied, so evaluating the expression (assigning it to a
+ * String, appending it with +=, or passing it where a String is expected)
+ * allocates once and writes every piece directly into place.  Numbers are
+ * formatted into a small buffer inside the expression, not a String.
+ *
+ *   String msg = "x=" + String(x) + ",y=" + y;   // one allocation
+ *
+ * Expressions only live until the end of the statement that creates them.
+ * The const String methods can also be called on an expression directly,
+ * e.g. (a + b).indexOf(','); each such call evaluates it into a String.
+ * (a + b).c_str() returns that String, which converts to const char * and
+ * (like the temporary String operator+ used to return) lasts until the end
+ * of the statement.
+ */
+
+// the value of an expression, returned by its c_str()
+class StringConcatValue : public String
+{
+public:
+	template<typename L, typename R>
+	StringConcatValue(const StringConcat<L, R> &expr) : String(expr) {}
+	operator const char * () const {return c_str();}
+};
+
+// pieces of an expression: each knows its length up front and can write
+// itself into a buffer
+class StringConcatString
+{
+public:
+	StringConcatString(const String &s) : str(s) {}
+	unsigned int length(void) const {return str.length();}
+	unsigned char valid(void) const {return str.c_str() != NULL;}
+	unsigned char aliases(const String *s) const {return &str == s;}
+	char * writeTo(char *dest) const
+		{memcpy(dest, str.c_str(), str.length()); return dest + str.length();}
+private:
+	const String &str;
+};
+
+class StringConcatCstr
+{
+public:
+	StringConcatCstr(const char *cstr) : cstr(cstr), len(cstr ? strlen(cstr) : 0) {}
+	unsigned int length(void) const {return len;}
+	unsigned char valid(void) const {return cstr != NULL;}
+	// the pointer may be into the String's own value (s.c_str() + n)
+	unsigned char aliases(const String *s) const
+		{return s->c_str() && cstr >= s->c_str() && cstr <= s->c_str() + s->length();}
+	char * writeTo(char *dest) const {memcpy(dest, cstr, len); return dest + len;}
+private:
+	const char *cstr;
+	unsigned int len;
+};
+
+class StringConcatFlash
+{
+public:
+	StringConcatFlash(const __FlashStringHelper *pstr)
+		: pstr((PGM_P)pstr), len(pstr ? strlen_P((PGM_P)pstr) : 0) {}
+	unsigned int length(void) const {return len;}
+	unsigned char valid(void) const {return pstr != NULL;}
+	unsigned char aliases(const String *) const {return 0;}
+	char * writeTo(char *dest) const {memcpy_P(dest, pstr, len); return dest + len;}
+private:
+	PGM_P pstr;
+	unsigned int len;
+};
+
+class StringConcatChar
+{
+public:
+	StringConcatChar(char c) : c(c) {}
+	unsigned int length(void) const {return 1;}
+	unsigned char valid(void) const {return 1;}
+	unsigned char aliases(const String *) const {return 0;}
+	char * writeTo(char *dest) const {*dest = c; return dest + 1;}
+private:
+	char c;
+};
+
+class StringConcatNumber
+{
+public:
+	StringConcatNumber(unsigned char num) {utoa(num, buf, 10); len = strlen(buf);}
+	StringConcatNumber(int num) {itoa(num, buf, 10); len = strlen(buf);}
+	StringConcatNumber(unsigned int num) {utoa(num, buf, 10); len = strlen(buf);}
+	StringConcatNumber(long num) {ltoa(num, buf, 10); len = strlen(buf);}
+	StringConcatNumber(unsigned long num) {ultoa(num, buf, 10); len = strlen(buf);}
+	unsigned int length(void) const {return len;}
+	unsigned char valid(void) const {return 1;}
+	unsigned char aliases(const String *) const {return 0;}
+	char * writeTo(char *dest) const {memcpy(dest, buf, len); return dest + len;}
+private:
+	char buf[12];
+	unsigned char len;
+};
+
+// maps an operand type to the piece that represents it; types without a
+// mapping don't take part in concatenation
+template<typename T> struct StringConcatPiece {};
+template<> struct StringConcatPiece<const char *> {typedef StringConcatCstr type;};
+template<> struct StringConcatPiece<char *> {typedef StringConcatCstr type;};
+template<size_t N> struct StringConcatPiece<char[N]> {typedef StringConcatCstr type;};
+template<> struct StringConcatPiece<const __FlashStringHelper *> {typedef StringConcatFlash type;};
+template<> struct StringConcatPiece<char> {typedef StringConcatChar type;};
+template<> struct StringConcatPiece<unsigned char> {typedef StringConcatNumber type;};
+template<> struct StringConcatPiece<int> {typedef StringConcatNumber type;};
+template<> struct StringConcatPiece<unsigned int> {typedef StringConcatNumber type;};
+template<> struct StringConcatPiece<long> {typedef StringConcatNumber type;};
+template<> struct StringConcatPiece<unsigned long> {typedef StringConcatNumber type;};
+template<typename L, typename R> struct StringConcatPiece< StringConcat<L, R> >
+	{typedef StringConcat<L, R> type;};
+
+// pieces are held by value; nested expressions by reference (they live as
+// long as the enclosing expression, as temporaries of the same statement).
+// operands are passed to the StringConcat constructor as-is, so that a
+// nested expression binds directly instead of through a local copy.
+template<typename T> struct StringConcatOperand {typedef T type;};
+template<typename L, typename R> struct StringConcatOperand< StringConcat<L, R> >
+	{typedef const StringConcat<L, R> &type;};
+
+template<typename L, typename R>
+class StringConcat
+{
+public:
+	StringConcat(const L &lhs, const R &rhs)
+		: lhs(lhs), rhs(rhs), len(lhs.length() + rhs.length()) {}
+	unsigned int length(void) const {return len;}
+	unsigned char valid(void) const {return lhs.valid() && rhs.valid();}
+	unsigned char aliases(const String *s) const {return lhs.aliases(s) || rhs.aliases(s);}
+	char * writeTo(char *dest) const {return rhs.writeTo(lhs.writeTo(dest));}
+
+	// the const String API, each evaluating the expression into a local
+	// String; c_str() returns the evaluated String, which converts to its
+	// const char * and lasts until the end of the statement
+	StringConcatValue c_str() const {return StringConcatValue(*this);}
+	int compareTo(const String &s) const {return String(*this).compareTo(s);}
+	unsigned char equals(const String &s) const {return String(*this).equals(s);}
+	unsigned char equals(const char *cstr) const {return String(*this).equals(cstr);}
+	unsigned char equals(const __FlashStringHelper *pstr) const {return String(*this).equals(pstr);}
+	unsigned char operator == (const String &rhs) const {return String(*this).equals(rhs);}
+	unsigned char operator == (const char *cstr) const {return String(*this).equals(cstr);}
+	unsigned char operator == (const __FlashStringHelper *pstr) const {return String(*this).equals(pstr);}
+	unsigned char operator != (const String &rhs) const {return !String(*this).equals(rhs);}
+	unsigned char operator != (const char *cstr) const {return !String(*this).equals(cstr);}
+	unsigned char operator != (const __FlashStringHelper *pstr) const {return !String(*this).equals(pstr);}
+	unsigned char operator <  (const String &rhs) const {return String(*this) < rhs;}
+	unsigned char operator >  (const String &rhs) const {return String(*this) > rhs;}
+	unsigned char operator <= (const String &rhs) const {return String(*this) <= rhs;}
+	unsigned char operator >= (const String &rhs) const {return String(*this) >= rhs;}
+	unsigned char equalsIgnoreCase(const String &s) const {return String(*this).equalsIgnoreCase(s);}
+	unsigned char startsWith(const String &prefix) const {return String(*this).startsWith(prefix);}
+	unsigned char startsWith(const String &prefix, unsigned int offset) const
+		{return String(*this).startsWith(prefix, offset);}
+	unsigned char startsWith(const __FlashStringHelper *prefix) const {return String(*this).startsWith(prefix);}
+	unsigned char startsWith(const __FlashStringHelper *prefix, unsigned int offset) const
+		{return String(*this).startsWith(prefix, offset);}
+	unsigned char endsWith(const String &suffix) const {return String(*this).endsWith(suffix);}
+	char charAt(unsigned int index) const {return String(*this).charAt(index);}
+	char operator [] (unsigned int index) const {return String(*this)[index];}
+	void getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index=0) const
+		{String(*this).getBytes(buf, bufsize, index);}
+	void toCharArray(char *buf, unsigned int bufsize, unsigned int index=0) const
+		{String(*this).toCharArray(buf, bufsize, index);}
+	int indexOf(char ch) const {return String(*this).indexOf(ch);}
+	int indexOf(char ch, unsigned int fromIndex) const {return String(*this).indexOf(ch, fromIndex);}
+	int indexOf(const String &str) const {return String(*this).indexOf(str);}
+	int indexOf(const String &str, unsigned int fromIndex) const {return String(*this).indexOf(str, fromIndex);}
+	int indexOf(const __FlashStringHelper *str) const {return String(*this).indexOf(str);}
+	int indexOf(const __FlashStringHelper *str, unsigned int fromIndex) const
+		{return String(*this).indexOf(str, fromIndex);}
+	int lastIndexOf(char ch) const {return String(*this).lastIndexOf(ch);}
+	int lastIndexOf(char ch, unsigned int fromIndex) const {return String(*this).lastIndexOf(ch, fromIndex);}
+	int lastIndexOf(const String &str) const {return String(*this).lastIndexOf(str);}
+	int lastIndexOf(const String &str, unsigned int fromIndex) const
+		{return String(*this).lastIndexOf(str, fromIndex);}
+	String substring(unsigned int beginIndex) const {return String(*this).substring(beginIndex);}
+	String substring(unsigned int beginIndex, unsigned int endIndex) const
+		{return String(*this).substring(beginIndex, endIndex);}
+	long toInt(void) const {return String(*this).toInt();}
+	float toFloat(void) const {return String(*this).toFloat();}
+private:
+	typename StringConcatOperand<L>::type lhs;
+	typename StringConcatOperand<R>::type rhs;
+	unsigned int len;
+};
+
+inline StringConcat<StringConcatString, StringConcatString>
+operator + (const String &lhs, const String &rhs)
+{
+	return StringConcat<StringConcatString, StringConcatString>(lhs, rhs);
+}
+
+template<typename R>
+inline StringConcat<StringConcatString, typename StringConcatPiece<R>::type>
+operator + (const String &lhs, const R &rhs)
+{
+	return StringConcat<StringConcatString, typename StringConcatPiece<R>::type>(lhs, rhs);
+}
+
+template<typename L>
+inline StringConcat<typename StringConcatPiece<L>::type, StringConcatString>
+operator + (const L &lhs, const String &rhs)
+{
+	return StringConcat<typename StringConcatPiece<L>::type, StringConcatString>(lhs, rhs);
+}
+
+template<typename L1, typename L2, typename R>
+inline StringConcat<StringConcat<L1, L2>, typename StringConcatPiece<R>::type>
+operator + (const StringConcat<L1, L2> &lhs, const R &rhs)
+{
+	return StringConcat<StringConcat<L1, L2>, typename StringConcatPiece<R>::type>(lhs, rhs);
+}
+
+template<typename L, typename R>
+String::String(const StringConcat<L, R> &expr)
+{
+	init();
+	if (!expr.valid() || !reserve(expr.length())) {
+		invalidate();
+		return;
+	}
+	len = expr.length();
+	*expr.writeTo(buffer) = 0;
+}
+
+template<typename L, typename R>
+String & String::operator = (const StringConcat<L, R> &expr)
+{
+	if (!expr.valid()) {
+		invalidate();
+	} else if (expr.aliases(this)) {
+		// our value is one of the pieces (e.g. s = "<" + s + ">"); build
+		// the result separately so it isn't overwritten while being read
+		String result(expr);
+		if (result) move(result);
+		else invalidate();
+	} else if (reserve(expr.length())) {
+		len = expr.length();
+		*expr.writeTo(buffer) = 0;
+	} else {
+		invalidate();
+	}
+	return *this;
+}
+
+template<typename L, typename R>
+unsigned char String::concat(const StringConcat<L, R> &expr)
+{
+	if (!expr.valid()) return 0;
+	if (expr.aliases(this)) {
+		// a piece reads our value (e.g. s += s.c_str() + 1 + "x"), possibly
+		// through a pointer that growing the buffer would leave dangling;
+		// build the result separately first
+		String result(expr);
+		if (!result) return 0;
+		return concat(result.buffer, result.len);
+	}
+	unsigned int newlen = len + expr.length();
+	if (!reserveGrowth(newlen)) return 0;
+	*expr.writeTo(buffer + len) = 0;
+	len = newlen;
+	return 1;
+}
+
 #endif  // __cplusplus
 #endif  // String_class_h
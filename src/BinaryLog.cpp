@@ -0,0 +1,89 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BinaryLog.h"
+
+#if (BINLOG_TIMESTAMP_BYTES != 0) && (BINLOG_TIMESTAMP_BYTES != 1) && \
+    (BINLOG_TIMESTAMP_BYTES != 2) && (BINLOG_TIMESTAMP_BYTES != 4)
+#error BINLOG_TIMESTAMP_BYTES must be 0, 1, 2 or 4
+#endif
+
+/** @brief sync + len + id (2) + timestamp + check */
+#define __BINLOG_OVERHEAD (5 + BINLOG_TIMESTAMP_BYTES)
+
+BinaryLog::BinaryLog(Print &out, BinaryLogClock clock)
+    : out(&out),
+      clock(clock),
+      enabled(true) {
+    // nop
+}
+
+void BinaryLog::setClock(BinaryLogClock clock) {
+    this->clock = clock;
+}
+
+void BinaryLog::setEnabled(bool enabled) {
+    this->enabled = enabled;
+}
+
+size_t BinaryLog::writeRecord(const __FlashStringHelper *msg,
+        const uint8_t *args, uint8_t argLen) {
+    uint8_t record[__BINLOG_OVERHEAD + BINLOG_MAX_ARG_BYTES];
+    uint16_t id = (uint16_t)(uintptr_t)msg;
+    uint8_t n = 0;
+    uint8_t check = 0;
+    uint8_t i;
+
+    if(!enabled) {
+        return 0;
+    }
+
+    if(argLen > BINLOG_MAX_ARG_BYTES) {
+        argLen = BINLOG_MAX_ARG_BYTES;
+    }
+
+    record[n++] = BINLOG_SYNC;
+    record[n++] = 2 + BINLOG_TIMESTAMP_BYTES + argLen;
+    record[n++] = lowByte(id);
+    record[n++] = highByte(id);
+
+#if BINLOG_TIMESTAMP_BYTES > 0
+    {
+        uint32_t ts = (clock != 0) ? clock() : 0;
+
+        // little-endian, same as the argument bytes on AVR
+        for(i = 0; i < BINLOG_TIMESTAMP_BYTES; i++) {
+            record[n++] = (uint8_t)(ts & 0xFF);
+            ts >>= 8;
+        }
+    }
+#endif
+
+    if(argLen > 0) {
+        memcpy(record + n, args, argLen);
+        n += argLen;
+    }
+
+    // checksum covers everything after the sync byte
+    for(i = 1; i < n; i++) {
+        check ^= record[i];
+    }
+
+    record[n++] = check;
+
+    return out->write(record, n);
+}
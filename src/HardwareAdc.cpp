@@ -0,0 +1,345 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "HardwareAdc.h"
+
+#if defined(ADCSRA)
+
+#define __ADC_BUFFER_MASK   ((uint8_t)(ADC_BUFFER_SIZE - 1))
+#define __ADC_PRESCALE_MASK ((uint8_t)(bit(ADPS2) | bit(ADPS1) | bit(ADPS0)))
+#define __ADC_TRIGGER_MASK  ((uint8_t)(bit(ADTS2) | bit(ADTS1) | bit(ADTS0)))
+
+#define __ADC_MAX_VALUE     1023
+
+/**
+ * @brief Clear the timer interrupt flag behind an auto-trigger source
+ *
+ * NOTE: Conversions are triggered by the rising edge of the flag, so it must
+ *   be cleared before the next trigger can occur.
+ */
+static inline void __clearTriggerFlag(uint8_t trigger) {
+    switch(trigger) {
+    case ADC_TRIGGER_TIMER0_COMPARE_A:
+        TIFR0 = bit(OCF0A);
+        break;
+
+    case ADC_TRIGGER_TIMER0_OVERFLOW:
+        TIFR0 = bit(TOV0);
+        break;
+
+    case ADC_TRIGGER_TIMER1_COMPARE_B:
+        TIFR1 = bit(OCF1B);
+        break;
+
+    case ADC_TRIGGER_TIMER1_OVERFLOW:
+        TIFR1 = bit(TOV1);
+        break;
+
+    case ADC_TRIGGER_TIMER1_CAPTURE:
+        TIFR1 = bit(ICF1);
+        break;
+    }
+}
+
+/**
+ * @brief Disable the digital input buffer of an analog input pin
+ */
+static inline void __disableDigitalInput(uint8_t channel) {
+#if defined(DIDR2)
+    if(channel >= 8) {
+        DIDR2 |= bit(channel - 8);
+        return;
+    }
+#endif
+
+    DIDR0 |= bit(channel);
+}
+
+/**
+ * @brief Run a sample through a filter, keeping the result in ADC range
+ */
+static inline uint16_t __filterSample(SampleFilter *filter, uint16_t value) {
+    int16_t out = filter->process((int16_t)value);
+
+    if(out < 0) {
+        return 0;
+    } else if(out > __ADC_MAX_VALUE) {
+        return __ADC_MAX_VALUE;
+    }
+
+    return (uint16_t)out;
+}
+
+HardwareAdc::HardwareAdc()
+    : head(0),
+      tail(0),
+      overruns(0),
+      scanLength(0),
+      current(0),
+      next(0),
+      discard(false),
+      isrFilters(0),
+      reference(ADC_REF_AVCC),
+      trigger(ADC_TRIGGER_FREE_RUNNING),
+      running(false) {
+    uint8_t i;
+
+    for(i = 0; i < ADC_CHANNELS; i++) {
+        filters[i] = NULL;
+    }
+}
+
+void HardwareAdc::begin(AdcReference reference, AdcPrescaler prescale) {
+    stop();
+
+    this->reference = (uint8_t)reference;
+    ADMUX = this->reference;
+    ADCSRA = bit(ADEN) | ((uint8_t)prescale & __ADC_PRESCALE_MASK);
+}
+
+void HardwareAdc::end() {
+    stop();
+    ADCSRA = 0;
+}
+
+bool HardwareAdc::setChannels(const uint8_t *channels, uint8_t count) {
+    uint8_t i;
+
+    if(running || count == 0 || count > ADC_MAX_SCAN) {
+        return false;
+    }
+
+    for(i = 0; i < count; i++) {
+        if(channels[i] >= ADC_CHANNELS) {
+            return false;
+        }
+    }
+
+    for(i = 0; i < count; i++) {
+        scan[i] = channels[i];
+        __disableDigitalInput(channels[i]);
+    }
+
+    scanLength = count;
+
+    return true;
+}
+
+bool HardwareAdc::setFilter(uint8_t channel, SampleFilter *filter, AdcFilterStage stage) {
+    uint8_t saveSreg;
+
+    if(channel >= ADC_CHANNELS) {
+        return false;
+    }
+
+    if(filter) {
+        filter->reset();
+    }
+
+    saveSreg = SREG;
+    cli();
+
+    filters[channel] = filter;
+
+    if(stage == ADC_FILTER_IN_ISR) {
+        isrFilters |= bit(channel);
+    } else {
+        isrFilters &= ~bit(channel);
+    }
+
+    SREG = saveSreg;
+
+    return true;
+}
+
+bool HardwareAdc::start(AdcTrigger trigger) {
+    uint8_t ctrl;
+
+    if(!(ADCSRA & bit(ADEN)) || scanLength == 0) {
+        return false;
+    }
+
+    stop();
+
+    this->trigger = (uint8_t)trigger;
+    head = 0;
+    tail = 0;
+    overruns = 0;
+    current = 0;
+    next = 0;
+
+    // the first free-running result is dropped (see conversionComplete())
+    discard = (trigger == ADC_TRIGGER_FREE_RUNNING);
+
+    selectChannel(scan[0]);
+    ADCSRB = (ADCSRB & ~__ADC_TRIGGER_MASK) | (uint8_t)trigger;
+
+    // discard any stale trigger edge and completed conversion
+    __clearTriggerFlag(trigger);
+
+    ctrl = (ADCSRA & __ADC_PRESCALE_MASK) |
+            bit(ADEN) | bit(ADATE) | bit(ADIF) | bit(ADIE);
+
+    if(trigger == ADC_TRIGGER_FREE_RUNNING) {
+        bitSet(ctrl, ADSC);
+    }
+
+    running = true;
+    ADCSRA = ctrl;
+
+    return true;
+}
+
+void HardwareAdc::stop() {
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+
+    // stop triggering and drop any conversion in flight
+    ADCSRA = (ADCSRA & ~(bit(ADATE) | bit(ADIE))) | bit(ADIF);
+    running = false;
+
+    SREG = saveSreg;
+
+    // let a conversion in progress finish, so it can't clobber convert()
+    while(ADCSRA & bit(ADSC));
+}
+
+uint16_t HardwareAdc::convert(uint8_t channel) {
+    if(running || !(ADCSRA & bit(ADEN)) || channel >= ADC_CHANNELS) {
+        return ADC_NO_SAMPLE;
+    }
+
+    selectChannel(channel);
+
+    // start, then wait for the conversion to complete
+    ADCSRA |= bit(ADSC);
+    while(ADCSRA & bit(ADSC));
+
+    return ADC;
+}
+
+uint8_t HardwareAdc::available() {
+    return (uint8_t)(head - tail) & __ADC_BUFFER_MASK;
+}
+
+uint8_t HardwareAdc::read(uint16_t *samples, uint8_t count) {
+    SampleFilter *filter;
+    uint16_t sample;
+    uint8_t h = head;
+    uint8_t t = tail;
+    uint8_t n = 0;
+    uint8_t channel;
+
+    // head is only written by the ISR and tail only here, so no critical
+    // section is needed
+    while(t != h && n < count) {
+        sample = buffer[t];
+        t = (t + 1) & __ADC_BUFFER_MASK;
+
+        channel = ADC_SAMPLE_CHANNEL(sample);
+        filter = filters[channel];
+
+        if(filter && !(isrFilters & bit(channel))) {
+            sample = __filterSample(filter, ADC_SAMPLE_VALUE(sample)) |
+                    ((uint16_t)channel << 12);
+        }
+
+        samples[n++] = sample;
+    }
+
+    tail = t;
+
+    return n;
+}
+
+uint16_t HardwareAdc::getOverruns() {
+    uint16_t result;
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+    result = overruns;
+    SREG = saveSreg;
+
+    return result;
+}
+
+void HardwareAdc::conversionComplete() {
+    uint16_t value = ADC;
+    uint8_t channel = scan[current];
+    uint8_t h;
+
+    __clearTriggerFlag(trigger);
+
+    /*
+     * In free-running mode the following conversion started as this one
+     * completed, using the channel selected in the previous interrupt; a
+     * channel selected now applies to the conversion after that. Triggered
+     * conversions start later, so they use the channel selected now.
+     */
+    if(trigger == ADC_TRIGGER_FREE_RUNNING) {
+        current = next;
+        next = (next + 1 < scanLength) ? next + 1 : 0;
+        selectChannel(scan[next]);
+    } else {
+        current = (current + 1 < scanLength) ? current + 1 : 0;
+        selectChannel(scan[current]);
+    }
+
+    if(discard) {
+        // the first result after enabling free-running mode is repeated by
+        // the second (same channel), and includes the ADC start-up
+        discard = false;
+        return;
+    }
+
+    if(filters[channel] && (isrFilters & bit(channel))) {
+        value = __filterSample(filters[channel], value);
+    }
+
+    h = (head + 1) & __ADC_BUFFER_MASK;
+
+    if(h == tail) {
+        overruns++;
+        return;
+    }
+
+    buffer[head] = value | ((uint16_t)channel << 12);
+    head = h;
+}
+
+void HardwareAdc::selectChannel(uint8_t channel) {
+#if defined(MUX5)
+    if(channel & 0x08) {
+        ADCSRB |= bit(MUX5);
+    } else {
+        ADCSRB &= ~bit(MUX5);
+    }
+#endif
+
+    ADMUX = reference | (channel & 0x07);
+}
+
+ISR(ADC_vect) {
+    Adc.conversionComplete();
+}
+
+HardwareAdc Adc;
+
+#endif /* ADCSRA */
@@ -0,0 +1,454 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "HardwareInterrupt.h"
+
+/*
+ * External interrupt pins (PINx register, bit) of the target MCU, and a mask
+ * of the INTn that exist. Other MCUs get no external or pin change
+ * interrupts: attach() returns false.
+ */
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define __EXT_INT_COUNT 8
+#define __EXT_INT_MASK  0xFF
+#define __INT0_PIN  PIND, 0
+#define __INT1_PIN  PIND, 1
+#define __INT2_PIN  PIND, 2
+#define __INT3_PIN  PIND, 3
+#define __INT4_PIN  PINE, 4
+#define __INT5_PIN  PINE, 5
+#define __INT6_PIN  PINE, 6
+#define __INT7_PIN  PINE, 7
+#elif defined(__AVR_ATmega48__) || defined(__AVR_ATmega48A__) || \
+        defined(__AVR_ATmega48P__) || defined(__AVR_ATmega48PA__) || \
+        defined(__AVR_ATmega88__) || defined(__AVR_ATmega88A__) || \
+        defined(__AVR_ATmega88P__) || defined(__AVR_ATmega88PA__) || \
+        defined(__AVR_ATmega168__) || defined(__AVR_ATmega168A__) || \
+        defined(__AVR_ATmega168P__) || defined(__AVR_ATmega168PA__) || \
+        defined(__AVR_ATmega328__) || defined(__AVR_ATmega328P__)
+#define __EXT_INT_COUNT 2
+#define __EXT_INT_MASK  0x03
+#define __INT0_PIN  PIND, 2
+#define __INT1_PIN  PIND, 3
+#elif defined(__AVR_ATmega32U4__)
+#define __EXT_INT_COUNT 7
+#define __EXT_INT_MASK  0x4F
+#define __INT0_PIN  PIND, 0
+#define __INT1_PIN  PIND, 1
+#define __INT2_PIN  PIND, 2
+#define __INT3_PIN  PIND, 3
+#define __INT6_PIN  PINE, 6
+#endif
+
+/*
+ * Pin change groups: the inputs of each group, read as one byte in PCINT
+ * bit order, the input register and bit of each pin, and the bits that
+ * exist.
+ */
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define __PCINT_GROUPS 3
+#define __PCINT_READ_0() (PINB)
+// PCINT8 is PE0, PCINT9..15 are PJ0..6
+#define __PCINT_READ_1() ((uint8_t)((PINE & 0x01) | (PINJ << 1)))
+#define __PCINT_READ_2() (PINK)
+#define __PCINT_INPUT_0(b) (&PINB)
+#define __PCINT_INPUT_1(b) (((b) == 0) ? &PINE : &PINJ)
+#define __PCINT_INPUT_2(b) (&PINK)
+#define __PCINT_BIT_1(b) (((b) == 0) ? 0 : (b) - 1)
+static const uint8_t __pcintValid[__PCINT_GROUPS] PROGMEM = { 0xFF, 0xFF, 0xFF };
+#elif defined(__AVR_ATmega48__) || defined(__AVR_ATmega48A__) || \
+        defined(__AVR_ATmega48P__) || defined(__AVR_ATmega48PA__) || \
+        defined(__AVR_ATmega88__) || defined(__AVR_ATmega88A__) || \
+        defined(__AVR_ATmega88P__) || defined(__AVR_ATmega88PA__) || \
+        defined(__AVR_ATmega168__) || defined(__AVR_ATmega168A__) || \
+        defined(__AVR_ATmega168P__) || defined(__AVR_ATmega168PA__) || \
+        defined(__AVR_ATmega328__) || defined(__AVR_ATmega328P__)
+#define __PCINT_GROUPS 3
+#define __PCINT_READ_0() (PINB)
+#define __PCINT_READ_1() (PINC)
+#define __PCINT_READ_2() (PIND)
+#define __PCINT_INPUT_0(b) (&PINB)
+#define __PCINT_INPUT_1(b) (&PINC)
+#define __PCINT_INPUT_2(b) (&PIND)
+static const uint8_t __pcintValid[__PCINT_GROUPS] PROGMEM = { 0xFF, 0x7F, 0xFF };
+#elif defined(__AVR_ATmega32U4__)
+#define __PCINT_GROUPS 1
+#define __PCINT_READ_0() (PINB)
+#define __PCINT_INPUT_0(b) (&PINB)
+static const uint8_t __pcintValid[__PCINT_GROUPS] PROGMEM = { 0xFF };
+#endif
+
+/*
+ * With LLAVR_INTERRUPT_NOBLOCK the dispatch ISRs re-enable interrupts once
+ * the pins are read (and the pin change state updated), just before calling
+ * the handlers. Using ISR_NOBLOCK instead would let a nested interrupt of the
+ * same group read and update the state first, so this one would report
+ * stale levels and lose or repeat edges.
+ */
+#if defined(LLAVR_INTERRUPT_NOBLOCK)
+#define __LLAVR_DISPATCH_SEI() sei()
+#else
+#define __LLAVR_DISPATCH_SEI()
+#endif
+
+/**
+ * @brief An attached handler
+ */
+typedef struct {
+    InterruptHandler handler;   ///< function to call (NULL if none)
+    void *context;              ///< passed to handler
+} __InterruptSlot;
+
+#if defined(__EXT_INT_COUNT)
+static __InterruptSlot __extSlots[__EXT_INT_COUNT];
+#endif
+
+#if defined(__PCINT_GROUPS)
+static __InterruptSlot __pcintSlots[__PCINT_GROUPS * 8];
+
+/** @brief Group inputs as of the last pin change interrupt (or attach) */
+static volatile uint8_t __pcintState[__PCINT_GROUPS];
+
+/** @brief Index of the lowest set bit of a nibble (0 for none) */
+static const uint8_t __lowestBit[16] PROGMEM = {
+    0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0
+};
+#endif
+
+#if defined(__EXT_INT_COUNT) || defined(__PCINT_GROUPS)
+/**
+ * @brief Copy a slot with interrupts disabled, so it is never half-written
+ */
+static void __setSlot(__InterruptSlot *slot, InterruptHandler handler, void *context) {
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+
+    slot->handler = handler;
+    slot->context = context;
+
+    SREG = saveSreg;
+}
+#endif
+
+// ExternalInterrupt ///////////////////////////////////////////////////////////
+
+#if defined(__EXT_INT_COUNT)
+
+/**
+ * @brief Check whether INTn exists on the target MCU
+ */
+static inline bool __extIntExists(uint8_t number) {
+    return number < 8 && (__EXT_INT_MASK & bit(number));
+}
+
+bool ExternalInterrupt::attach(uint8_t number, InterruptSense sense,
+        InterruptHandler handler, void *context) {
+    volatile uint8_t *eicr;
+    uint8_t shift;
+    uint8_t saveSreg;
+
+    if(!__extIntExists(number)) {
+        return false;
+    }
+
+    detach(number);
+    __setSlot(&__extSlots[number], handler, context);
+
+    // two ISCn bits per interrupt; EICRA holds INT0..3, EICRB INT4..7
+#if defined(EICRB)
+    eicr = (number < 4) ? &EICRA : &EICRB;
+#else
+    eicr = &EICRA;
+#endif
+    shift = (number & 0x03) * 2;
+
+    saveSreg = SREG;
+    cli();
+
+    *eicr = (*eicr & ~(0x03 << shift)) | ((uint8_t)sense << shift);
+
+    // changing the sense can raise the flag; clear it before enabling
+    EIFR = bit(number);
+    EIMSK |= bit(number);
+
+    SREG = saveSreg;
+
+    return true;
+}
+
+void ExternalInterrupt::detach(uint8_t number) {
+    if(!__extIntExists(number)) {
+        return;
+    }
+
+    // EIMSK is in the sbi/cbi range
+    EIMSK &= ~bit(number);
+    __setSlot(&__extSlots[number], NULL, NULL);
+}
+
+/*
+ * The INTn ISRs. The pin is read first, so its level is as close as possible
+ * to the edge that triggered the interrupt.
+ *
+ * NOTE: With LLAVR_INTERRUPT_NOBLOCK, a low level interrupt re-enters as soon
+ *   as interrupts are re-enabled; the handler should detach it.
+ */
+#define __EXT_INT_DISPATCH(n, pin) __EXT_INT_DISPATCH_PIN(n, pin)
+#define __EXT_INT_DISPATCH_PIN(n, reg, b) \
+    { \
+        uint8_t state = (reg >> b) & 0x01; \
+        \
+        __LLAVR_DISPATCH_SEI(); \
+        \
+        if(__extSlots[n].handler) { \
+            __extSlots[n].handler(__extSlots[n].context, state); \
+        } \
+    }
+
+#if defined(__INT0_PIN) && !defined(LLAVR_NO_INT0_ISR)
+ISR(INT0_vect)
+__EXT_INT_DISPATCH(0, __INT0_PIN)
+#endif
+
+#if defined(__INT1_PIN) && !defined(LLAVR_NO_INT1_ISR)
+ISR(INT1_vect)
+__EXT_INT_DISPATCH(1, __INT1_PIN)
+#endif
+
+#if defined(__INT2_PIN) && !defined(LLAVR_NO_INT2_ISR)
+ISR(INT2_vect)
+__EXT_INT_DISPATCH(2, __INT2_PIN)
+#endif
+
+#if defined(__INT3_PIN) && !defined(LLAVR_NO_INT3_ISR)
+ISR(INT3_vect)
+__EXT_INT_DISPATCH(3, __INT3_PIN)
+#endif
+
+#if defined(__INT4_PIN) && !defined(LLAVR_NO_INT4_ISR)
+ISR(INT4_vect)
+__EXT_INT_DISPATCH(4, __INT4_PIN)
+#endif
+
+#if defined(__INT5_PIN) && !defined(LLAVR_NO_INT5_ISR)
+ISR(INT5_vect)
+__EXT_INT_DISPATCH(5, __INT5_PIN)
+#endif
+
+#if defined(__INT6_PIN) && !defined(LLAVR_NO_INT6_ISR)
+ISR(INT6_vect)
+__EXT_INT_DISPATCH(6, __INT6_PIN)
+#endif
+
+#if defined(__INT7_PIN) && !defined(LLAVR_NO_INT7_ISR)
+ISR(INT7_vect)
+__EXT_INT_DISPATCH(7, __INT7_PIN)
+#endif
+
+#else
+
+bool ExternalInterrupt::attach(uint8_t number, InterruptSense sense,
+        InterruptHandler handler, void *context) {
+    return false;
+}
+
+void ExternalInterrupt::detach(uint8_t number) {
+    // nop
+}
+
+#endif /* __EXT_INT_COUNT */
+
+// PinChangeInterrupt //////////////////////////////////////////////////////////
+
+#if defined(__PCINT_GROUPS)
+
+/**
+ * @brief Get the mask register of a group (PCMSK0..2 are consecutive)
+ */
+static inline volatile uint8_t *__pcintMask(uint8_t group) {
+    return &PCMSK0 + group;
+}
+
+/**
+ * @brief Read a group's inputs
+ */
+static uint8_t __pcintRead(uint8_t group) {
+    switch(group) {
+#if defined(__PCINT_READ_1)
+    case 1:
+        return __PCINT_READ_1();
+#endif
+#if defined(__PCINT_READ_2)
+    case 2:
+        return __PCINT_READ_2();
+#endif
+    default:
+        return __PCINT_READ_0();
+    }
+}
+
+/**
+ * @brief Call the handlers of the pins of a group that changed
+ *
+ * Called from the group's ISR with interrupts disabled; the state is updated
+ * before they are re-enabled (with LLAVR_INTERRUPT_NOBLOCK) for the handlers.
+ */
+static inline void __pcintDispatch(uint8_t group, uint8_t now) {
+    __InterruptSlot *slots = &__pcintSlots[group * 8];
+    uint8_t changed = (now ^ __pcintState[group]) & *__pcintMask(group);
+    uint8_t b;
+
+    __pcintState[group] = now;
+
+    __LLAVR_DISPATCH_SEI();
+
+    while(changed) {
+        if(changed & 0x0F) {
+            b = pgm_read_byte(&__lowestBit[changed & 0x0F]);
+        } else {
+            b = 4 + pgm_read_byte(&__lowestBit[changed >> 4]);
+        }
+
+        // clear the lowest set bit
+        changed &= changed - 1;
+
+        if(slots[b].handler) {
+            slots[b].handler(slots[b].context, (now >> b) & 0x01);
+        }
+    }
+}
+
+bool PinChangeInterrupt::attach(uint8_t pin, InterruptHandler handler, void *context) {
+    uint8_t group = pin >> 3;
+    uint8_t mask = bit(pin & 0x07);
+    uint8_t saveSreg;
+
+    if(group >= __PCINT_GROUPS || !(pgm_read_byte(&__pcintValid[group]) & mask)) {
+        return false;
+    }
+
+    __setSlot(&__pcintSlots[pin], handler, context);
+
+    saveSreg = SREG;
+    cli();
+
+    // the ISR only tracks enabled pins, so refresh this pin's last state
+    __pcintState[group] = (__pcintState[group] & ~mask) | (__pcintRead(group) & mask);
+
+    *__pcintMask(group) |= mask;
+    PCICR |= bit(group);
+
+    SREG = saveSreg;
+
+    return true;
+}
+
+void PinChangeInterrupt::detach(uint8_t pin) {
+    uint8_t group = pin >> 3;
+    uint8_t saveSreg;
+
+    if(group >= __PCINT_GROUPS) {
+        return;
+    }
+
+    saveSreg = SREG;
+    cli();
+
+    *__pcintMask(group) &= ~bit(pin & 0x07);
+
+    if(*__pcintMask(group) == 0) {
+        PCICR &= ~bit(group);
+    }
+
+    SREG = saveSreg;
+
+    __setSlot(&__pcintSlots[pin], NULL, NULL);
+}
+
+uint8_t PinChangeInterrupt::read(uint8_t pin) {
+    if((pin >> 3) >= __PCINT_GROUPS) {
+        return 0;
+    }
+
+    return (__pcintRead(pin >> 3) >> (pin & 0x07)) & 0x01;
+}
+
+volatile uint8_t *PinChangeInterrupt::getInputRegister(uint8_t pin, uint8_t *mask) {
+    uint8_t b = pin & 0x07;
+
+    switch(pin >> 3) {
+    case 0:
+        *mask = bit(b);
+        return __PCINT_INPUT_0(b);
+#if defined(__PCINT_INPUT_1)
+    case 1:
+#if defined(__PCINT_BIT_1)
+        *mask = bit(__PCINT_BIT_1(b));
+#else
+        *mask = bit(b);
+#endif
+        return __PCINT_INPUT_1(b);
+#endif
+#if defined(__PCINT_INPUT_2)
+    case 2:
+        *mask = bit(b);
+        return __PCINT_INPUT_2(b);
+#endif
+    default:
+        return NOREG;
+    }
+}
+
+#if defined(__PCINT_READ_0) && !defined(LLAVR_NO_PCINT0_ISR)
+ISR(PCINT0_vect) {
+    __pcintDispatch(0, __PCINT_READ_0());
+}
+#endif
+
+#if defined(__PCINT_READ_1) && !defined(LLAVR_NO_PCINT1_ISR)
+ISR(PCINT1_vect) {
+    __pcintDispatch(1, __PCINT_READ_1());
+}
+#endif
+
+#if defined(__PCINT_READ_2) && !defined(LLAVR_NO_PCINT2_ISR)
+ISR(PCINT2_vect) {
+    __pcintDispatch(2, __PCINT_READ_2());
+}
+#endif
+
+#else
+
+bool PinChangeInterrupt::attach(uint8_t pin, InterruptHandler handler, void *context) {
+    return false;
+}
+
+void PinChangeInterrupt::detach(uint8_t pin) {
+    // nop
+}
+
+uint8_t PinChangeInterrupt::read(uint8_t pin) {
+    return 0;
+}
+
+volatile uint8_t *PinChangeInterrupt::getInputRegister(uint8_t pin, uint8_t *mask) {
+    return NOREG;
+}
+
+#endif /* __PCINT_GROUPS */
@@ -87,82 +87,10 @@ static uint16_t __setupServoTimer(HardwareTimer *t) {
     return resultTicks;
 }
 
-/**
- * @brief Sets the given pin to be an output
- */
-static void __setPinModeOutput(ServoPin pin) {
-
-    /*
-     * TODO make sure these pin mapping work for devices other than ATmega2560
-     */
-
-    switch(pin) {
-#if defined(OCR1A)
-    case OC1A:
-        sbi(DDRB, PB5);
-        break;
-#endif
-#if defined(OCR1B)
-    case OC1B:
-        sbi(DDRB, PB6);
-        break;
-#endif
-#if defined(OCR1C)
-    case OC1C:
-        sbi(DDRB, PB7);
-        break;
-#endif
-#if defined(OCR3A)
-    case OC3A:
-        sbi(DDRE, PE3);
-        break;
-#endif
-#if defined(OCR3B)
-    case OC3B:
-        sbi(DDRE, PE4);
-        break;
-#endif
-#if defined(OCR3C)
-    case OC3C:
-        sbi(DDRE, PE5);
-        break;
-#endif
-#if defined(OCR4A)
-    case OC4A:
-        sbi(DDRH, PH3);
-        break;
-#endif
-#if defined(OCR4B)
-    case OC4B:
-        sbi(DDRH, PH4);
-        break;
-#endif
-#if defined(OCR4C)
-    case OC4C:
-        sbi(DDRH, PH5);
-        break;
-#endif
-#if defined(OCR5A)
-    case OC5A:
-        sbi(DDRL, PL3);
-        break;
-#endif
-#if defined(OCR5B)
-    case OC5B:
-        sbi(DDRL, PL4);
-        break;
-#endif
-#if defined(OCR5C)
-    case OC5C:
-        sbi(DDRL, PL5);
-        break;
-#endif
-    }
-}
-
 HardwareServo::HardwareServo(
         ServoPin outputPin, uint16_t minUs, uint16_t maxUs, uint16_t initUs)
     : timer(NULL_HWTIMER),
+      channel(getOutputCompareChannel(outputPin)),
       timerTicks1us(0.0F),
       outputPin(outputPin),
       minPulseWidthUs(minUs),
@@ -189,71 +117,16 @@ HardwareServo::HardwareServo(
     microsPerPercent =
             (uint16_t)round((float)((maxPulseWidthUs - minPulseWidthUs) / 100.0F));
 
-    // set the correct timer reference based on our pin
-    switch(outputPin) {
-    // Timer 1
-#if defined(TCCR1A)
-#if defined(OCR1A)
-    case OC1A:
-#endif
-#if defined(OCR1B)
-    case OC1B:
-#endif
-#if defined(OCR1C)
-    case OC1C:
-#endif
-        timer = &Timer1;
-        break;
-#endif
-
-    // Timer 3
-#if defined(TCCR3A)
-#if defined(OCR3A)
-    case OC3A:
-#endif
-#if defined(OCR3B)
-    case OC3B:
-#endif
-#if defined(OCR3C)
-    case OC3C:
-#endif
-        timer = &Timer3;
-        break;
-#endif
-
-    // Timer 4
-#if defined(TCCR4A)
-#if defined(OCR4A)
-    case OC4A:
-#endif
-#if defined(OCR4B)
-    case OC4B:
-#endif
-#if defined(OCR4C)
-    case OC4C:
-#endif
-        timer = &Timer4;
-        break;
-#endif
-
-    // Timer 5
-#if defined(TCCR5A)
-#if defined(OCR5A)
-    case OC5A:
-#endif
-#if defined(OCR5B)
-    case OC5B:
-#endif
-#if defined(OCR5C)
-    case OC5C:
-#endif
-        timer = &Timer5;
-        break;
-#endif
+    // servo pulses need a 16-bit timer
+    timer = getOutputCompareTimer(outputPin);
+
+    if(timer == NULL_HWTIMER || !timer->isWide()) {
+        timer = NULL_HWTIMER;
+        return;
     }
 
     // set pin output
-    __setPinModeOutput(outputPin);
+    setOutputComparePinOutput(outputPin);
 
     // setup the timer
     ticksPer20ms = __setupServoTimer(timer);
@@ -275,6 +148,10 @@ bool HardwareServo::setPulseWidth(uint16_t pulseWidthUs) {
     float pulseTicks;
     bool result = false;
 
+    if(timer == NULL_HWTIMER) {
+        return false;
+    }
+
     if(pulseWidthUs < minPulseWidthUs) {
         pw = minPulseWidthUs;
     } else if(pulseWidthUs > maxPulseWidthUs) {
@@ -296,69 +173,8 @@ bool HardwareServo::setPulseWidth(uint16_t pulseWidthUs) {
 //    Serial.print(F("*** Servo setting pulse ticks: "));
 //    Serial.println(ocValue, DEC);
 
-    // set the new compare value in the right channel
-    switch(outputPin) {
-#if defined(OCR1A)
-    case OC1A:
-        timer->setCompareValueA(ocValue);
-        break;
-#endif
-#if defined(OCR1B)
-    case OC1B:
-        timer->setCompareValueB(ocValue);
-        break;
-#endif
-#if defined(OCR1C)
-    case OC1C:
-        timer->setCompareValueC(ocValue);
-        break;
-#endif
-#if defined(OCR3A)
-    case OC3A:
-        timer->setCompareValueA(ocValue);
-        break;
-#endif
-#if defined(OCR3B)
-    case OC3B:
-        timer->setCompareValueB(ocValue);
-        break;
-#endif
-#if defined(OCR3C)
-    case OC3C:
-        timer->setCompareValueC(ocValue);
-        break;
-#endif
-#if defined(OCR4A)
-    case OC4A:
-        timer->setCompareValueA(ocValue);
-        break;
-#endif
-#if defined(OCR4B)
-    case OC4B:
-        timer->setCompareValueB(ocValue);
-        break;
-#endif
-#if defined(OCR4C)
-    case OC4C:
-        timer->setCompareValueC(ocValue);
-        break;
-#endif
-#if defined(OCR5A)
-    case OC5A:
-        timer->setCompareValueA(ocValue);
-        break;
-#endif
-#if defined(OCR5B)
-    case OC5B:
-        timer->setCompareValueB(ocValue);
-        break;
-#endif
-#if defined(OCR5C)
-    case OC5C:
-        timer->setCompareValueC(ocValue);
-        break;
-#endif
-    }
+    // set the new compare value in the servo's channel
+    timer->setCompareValue(channel, ocValue);
 
     return result;
 }
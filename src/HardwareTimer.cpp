@@ -17,6 +17,7 @@
  */
 
 #include "HardwareTimer.h"
+#include "McuPinMap.h"
 
 #define __CS_PRESCALE_NONE ((uint8_t)(bit(CS00)))
 #define __CS_PRESCALE_8    ((uint8_t)(bit(CS01)))
@@ -54,14 +55,46 @@ static inline void __setClockSelect(uint8_t *value, TimerPrescaler ps) {
 
 /**
  * @brief Write to a 16-bit register
+ *
+ * NOTE: The high byte goes through a TEMP register shared by all 16-bit
+ *   registers of the timer, so interrupts are disabled between the two
+ *   writes; an ISR accessing another of the timer's registers would
+ *   otherwise change the high byte written.
  */
 static inline void __setWideReg(
         volatile uint8_t *regH, volatile uint8_t *regL, uint16_t value) {
-    if(regH != NOREG) {
-        *regH = highByte(value);
+    uint8_t saveSreg;
+
+    if(regH == NOREG) {
+        *regL = lowByte(value);
+        return;
     }
 
+    saveSreg = SREG;
+    cli();
+
+    *regH = highByte(value);
     *regL = lowByte(value);
+
+    SREG = saveSreg;
+}
+
+/**
+ * @brief Read a 16-bit register
+ *
+ * NOTE: Call with interrupts disabled; the low byte is read first, which
+ *   latches the high byte (for registers that go through TEMP).
+ */
+static inline uint16_t __getWideReg(volatile uint8_t *regH, volatile uint8_t *regL) {
+    uint8_t low;
+
+    if(regH == NOREG) {
+        return *regL;
+    }
+
+    low = *regL;
+
+    return ((uint16_t)*regH << 8) | low;
 }
 
 HardwareTimer::HardwareTimer(
@@ -85,7 +118,12 @@ HardwareTimer::HardwareTimer(
       prescale(TIMER_PRESCALE_NONE),
       mode(TIMER_MODE_NONE),
       topValue(0xFFFF) {
-    // nop
+    uint8_t i;
+
+    for(i = 0; i < 4; i++) {
+        callbacks[i] = NULL;
+        contexts[i] = NULL;
+    }
 }
 
 void HardwareTimer::setPrescaler(TimerPrescaler prescale) {
@@ -115,6 +153,38 @@ void HardwareTimer::setNormalMode() {
     __setWideReg(tcnth, tcntl, 0);
 }
 
+void HardwareTimer::setCtcMode(uint16_t topValue) {
+    uint8_t ctrlA = 0;
+    uint8_t ctrlB = 0;
+    uint8_t ctrlC = 0;
+
+    mode = TIMER_MODE_CTC;
+
+    /*
+     * For 16-bit timers, use mode 4 (TOP == OCRnA)
+     * For 8-bit timers, use mode 2 (TOP == OCRnA)
+     */
+
+    if(is16Bit) {
+        bitSet(ctrlB, WGM12);
+        this->topValue = topValue;
+    } else {
+        bitSet(ctrlA, WGM01);
+        this->topValue = lowByte(topValue);
+    }
+
+    // set ocrna to top value
+    __setWideReg(ocrAh, ocrAl, topValue);
+
+    __setClockSelect(&ctrlB, prescale);
+
+    // set the control registers
+    resetTimerControl(ctrlA, ctrlB, ctrlC);
+
+    // reset timer counter
+    __setWideReg(tcnth, tcntl, 0);
+}
+
 void HardwareTimer::setFastPwmMode(uint16_t topValue) {
     uint8_t ctrlA = 0;
     uint8_t ctrlB = 0;
@@ -149,6 +219,56 @@ void HardwareTimer::setFastPwmMode(uint16_t topValue) {
     __setWideReg(tcnth, tcntl, 0);
 }
 
+void HardwareTimer::setPhaseCorrectPwmMode(uint16_t topValue) {
+    uint8_t ctrlA = 0;
+    uint8_t ctrlB = 0;
+    uint8_t ctrlC = 0;
+
+    mode = TIMER_MODE_PHASE_CORRECT_PWM;
+    this->topValue = topValue;
+
+    /*
+     * For 16-bit timers, use mode 10 (TOP == ICRn)
+     * For 8-bit timers, use mode 1 (TOP == 0xFF)
+     */
+
+    if(is16Bit) {
+        bitSet(ctrlA, WGM11);
+        bitSet(ctrlB, WGM13);
+
+        // set icrn to top value
+        __setWideReg(icrh, icrl, topValue);
+    } else {
+        bitSet(ctrlA, WGM00);
+    }
+
+    __setClockSelect(&ctrlB, prescale);
+
+    // set the control registers
+    resetTimerControl(ctrlA, ctrlB, ctrlC);
+
+    // reset timer counter
+    __setWideReg(tcnth, tcntl, 0);
+}
+
+void HardwareTimer::haltSync(bool includeTimer2) {
+    uint8_t value = bit(TSM) | bit(PSRSYNC);
+
+#if defined(PSRASY)
+    if(includeTimer2) {
+        value |= bit(PSRASY);
+    }
+#endif
+
+    // with TSM set, the reset bits stay set and hold the prescalers
+    GTCCR = value;
+}
+
+void HardwareTimer::releaseSync() {
+    // clearing TSM lets the hardware clear the reset bits, all at once
+    GTCCR = 0;
+}
+
 void HardwareTimer::setCompareValue(uint8_t channels, uint16_t value, bool inverting) {
     uint8_t curTccrA, curTccrB, curTccrC = 0;
     uint8_t comVal = 0;
@@ -169,25 +289,211 @@ void HardwareTimer::setCompareValue(uint8_t channels, uint16_t value, bool inver
 
     // check for each channel
 
+    // previous output modes are cleared, so a channel can switch between
+    // inverting and non-inverting
+
     if(channels & TIMER_OCR_A) {
+        curTccrA &= ~(0x03 << COM0A0);
         curTccrA |= (comVal << COM0A0);
         __setWideReg(ocrAh, ocrAl, value);
     }
 
     if(channels & TIMER_OCR_B) {
+        curTccrA &= ~(0x03 << COM0B0);
         curTccrA |= (comVal << COM0B0);
         __setWideReg(ocrBh, ocrBl, value);
     }
 
+#if defined(COM1C0)
     if((numOcrChannels > 2) && (channels & TIMER_OCR_C)) {
+        curTccrA &= ~(0x03 << COM1C0);
         curTccrA |= (comVal << COM1C0);
         __setWideReg(ocrCh, ocrCl, value);
     }
+#endif
 
     // reset control
     resetTimerControl(curTccrA, curTccrB, curTccrC);
 }
 
+void HardwareTimer::setCompareOutputMode(uint8_t channels, TimerOutputMode outputMode) {
+    uint8_t curTccrA, curTccrB, curTccrC = 0;
+    uint8_t comVal = (uint8_t)outputMode;
+
+    // get current tccrx
+    curTccrA = *tccrA;
+    curTccrB = *tccrB;
+
+    if(is16Bit) {
+        curTccrC = *tccrC;
+    }
+
+    if(channels & TIMER_OCR_A) {
+        curTccrA &= ~(0x03 << COM0A0);
+        curTccrA |= (comVal << COM0A0);
+    }
+
+    if(channels & TIMER_OCR_B) {
+        curTccrA &= ~(0x03 << COM0B0);
+        curTccrA |= (comVal << COM0B0);
+    }
+
+#if defined(COM1C0)
+    if((numOcrChannels > 2) && (channels & TIMER_OCR_C)) {
+        curTccrA &= ~(0x03 << COM1C0);
+        curTccrA |= (comVal << COM1C0);
+    }
+#endif
+
+    // reset control
+    resetTimerControl(curTccrA, curTccrB, curTccrC);
+}
+
+void HardwareTimer::setComplementaryPair(uint8_t highChannel, uint8_t lowChannel,
+        uint16_t value, uint16_t deadTime) {
+    uint16_t top = is16Bit ? topValue : 0xFF;
+    uint16_t lowValue, oldValue;
+    volatile uint8_t *highH, *highL;
+    uint8_t highShift, lowShift;
+    uint8_t curTccrA;
+    uint8_t saveSreg;
+
+    if(value > top) {
+        value = top;
+    }
+
+    // low side compare value, saturating at TOP (low side off)
+    lowValue = (deadTime < top - value) ? (value + deadTime) : top;
+
+    if(!getCompareOutput(highChannel, &highH, &highL, &highShift)
+            || !getCompareOutput(lowChannel, NULL, NULL, &lowShift)) {
+        return;
+    }
+
+    saveSreg = SREG;
+    cli();
+
+    // high side non-inverting, low side inverting, in a single write
+    curTccrA = *tccrA & ~((0x03 << highShift) | (0x03 << lowShift));
+    *tccrA = curTccrA | (0x02 << highShift) | (0x03 << lowShift);
+
+    // write the side whose on time shrinks first: if the double buffered
+    // OCRs are updated between the two writes, the outputs then get a longer
+    // dead time for one period instead of overlapping
+    oldValue = __getWideReg(highH, highL);
+
+    if(value > oldValue) {
+        setCompareRegister(lowChannel, lowValue);
+        setCompareRegister(highChannel, value);
+    } else {
+        setCompareRegister(highChannel, value);
+        setCompareRegister(lowChannel, lowValue);
+    }
+
+    SREG = saveSreg;
+}
+
+bool HardwareTimer::getCompareOutput(uint8_t channel,
+        volatile uint8_t **regH, volatile uint8_t **regL, uint8_t *comShift) {
+    volatile uint8_t *h, *l;
+
+    switch(channel) {
+    case TIMER_OCR_A:
+        h = ocrAh;
+        l = ocrAl;
+        *comShift = COM0A0;
+        break;
+
+    case TIMER_OCR_B:
+        h = ocrBh;
+        l = ocrBl;
+        *comShift = COM0B0;
+        break;
+
+#if defined(COM1C0)
+    case TIMER_OCR_C:
+        if(numOcrChannels <= 2) {
+            return false;
+        }
+
+        h = ocrCh;
+        l = ocrCl;
+        *comShift = COM1C0;
+        break;
+#endif
+
+    default:
+        return false;
+    }
+
+    if(regH) {
+        *regH = h;
+        *regL = l;
+    }
+
+    return true;
+}
+
+void HardwareTimer::enableOutputs(uint8_t channels) {
+    uint8_t i;
+
+    for(i = 0; i < OC_PIN_COUNT; i++) {
+        if(getOutputCompareTimer((OutputComparePin)i) == this &&
+                (getOutputCompareChannel((OutputComparePin)i) & channels)) {
+            setOutputComparePinOutput((OutputComparePin)i);
+        }
+    }
+}
+
+uint16_t HardwareTimer::getCount() {
+    uint8_t saveSreg;
+    uint8_t low, high;
+
+    if(tcnth == NOREG) {
+        return *tcntl;
+    }
+
+    // the high byte is latched when the low byte is read, through a TEMP
+    // register shared by all 16-bit registers of the timer
+    saveSreg = SREG;
+    cli();
+
+    low = *tcntl;
+    high = *tcnth;
+
+    SREG = saveSreg;
+
+    return ((uint16_t)high << 8) | low;
+}
+
+void HardwareTimer::setCount(uint16_t count) {
+    __setWideReg(tcnth, tcntl, count);
+}
+
+bool HardwareTimer::isOverflowPending() {
+    // TOVn is bit 0 of TIFRn on all timers
+    return (*tifr & bit(TOV0)) != 0;
+}
+
+bool HardwareTimer::isCompareMatchPending(uint8_t channels) {
+    // OCFnA..C are bits 1..3 of TIFRn on all timers
+    return (*tifr & (channels << 1)) != 0;
+}
+
+void HardwareTimer::setCompareRegister(uint8_t channels, uint16_t value) {
+    if(channels & TIMER_OCR_A) {
+        __setWideReg(ocrAh, ocrAl, value);
+    }
+
+    if(channels & TIMER_OCR_B) {
+        __setWideReg(ocrBh, ocrBl, value);
+    }
+
+    if((numOcrChannels > 2) && (channels & TIMER_OCR_C)) {
+        __setWideReg(ocrCh, ocrCl, value);
+    }
+}
+
 TimerPrescaler HardwareTimer::getPrescale() {
     return prescale;
 }
@@ -226,6 +532,26 @@ void HardwareTimer::resetTimerControl(uint8_t controlA, uint8_t controlB, uint8_
 
 // static timers
 
+/*
+ * Channel C of the 16-bit timers is missing on some MCUs (e.g., the 328P).
+ */
+
+#if defined(OCR1CL)
+#define __TIMER1_CHANNELS 3
+#define __TIMER1_OCR_C &OCR1CH, &OCR1CL
+#else
+#define __TIMER1_CHANNELS 2
+#define __TIMER1_OCR_C NOREG, NOREG
+#endif
+
+#if defined(OCR3CL)
+#define __TIMER3_CHANNELS 3
+#define __TIMER3_OCR_C &OCR3CH, &OCR3CL
+#else
+#define __TIMER3_CHANNELS 2
+#define __TIMER3_OCR_C NOREG, NOREG
+#endif
+
 #if defined(TCCR0A)
 HardwareTimer Timer0(
         false, 2,
@@ -240,12 +566,12 @@ HardwareTimer Timer0(
 
 #if defined(TCCR1A)
 HardwareTimer Timer1(
-        true, 3,
+        true, __TIMER1_CHANNELS,
         &TCCR1A, &TCCR1B, &TCCR1C,
         &TCNT1H, &TCNT1L,
         &OCR1AH, &OCR1AL,
         &OCR1BH, &OCR1BL,
-        &OCR1CH, &OCR1CL,
+        __TIMER1_OCR_C,
         &ICR1H, &ICR1L,
         &TIMSK1, &TIFR1);
 #endif
@@ -264,17 +590,18 @@ HardwareTimer Timer2(
 
 #if defined(TCCR3A)
 HardwareTimer Timer3(
-        true, 3,
+        true, __TIMER3_CHANNELS,
         &TCCR3A, &TCCR3B, &TCCR3C,
         &TCNT3H, &TCNT3L,
         &OCR3AH, &OCR3AL,
         &OCR3BH, &OCR3BL,
-        &OCR3CH, &OCR3CL,
+        __TIMER3_OCR_C,
         &ICR3H, &ICR3L,
         &TIMSK3, &TIFR3);
 #endif
 
-#if defined(TCCR4A)
+// the 32U4's Timer4 is a 10-bit high-speed timer, not supported here
+#if defined(TCCR4A) && defined(ICR4L)
 HardwareTimer Timer4(
         true, 3,
         &TCCR4A, &TCCR4B, &TCCR4C,
@@ -0,0 +1,131 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Timer interrupt callbacks.
+ *
+ * Kept apart from HardwareTimer.cpp so the timer ISRs are only linked into
+ * programs that set a callback.
+ */
+
+#include "HardwareTimer.h"
+
+/*
+ * TIMSKn/TIFRn bit of each TimerInterrupt; the same on all timers (TOIEn,
+ * OCIEnA, OCIEnB, OCIEnC).
+ */
+#define __TIMER_INTERRUPT_BIT(source) ((uint8_t)bit(source))
+
+/**
+ * @brief Install or remove a callback, enabling or disabling its interrupt
+ */
+static void __setTimerInterrupt(
+        volatile uint8_t *timsk, volatile uint8_t *tifr, uint8_t source,
+        TimerCallback *callbacks, void **contexts,
+        TimerCallback callback, void *context) {
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+
+    callbacks[source] = callback;
+    contexts[source] = context;
+
+    if(callback) {
+        // discard a stale event, so the first callback is for a new one
+        *tifr = __TIMER_INTERRUPT_BIT(source);
+        *timsk |= __TIMER_INTERRUPT_BIT(source);
+    } else {
+        *timsk &= ~__TIMER_INTERRUPT_BIT(source);
+    }
+
+    SREG = saveSreg;
+}
+
+void HardwareTimer::setOverflowInterrupt(TimerCallback callback, void *context) {
+    __setTimerInterrupt(timsk, tifr, TIMER_INTERRUPT_OVERFLOW,
+            callbacks, contexts, callback, context);
+}
+
+void HardwareTimer::setCompareMatchInterrupt(
+        uint8_t channels, TimerCallback callback, void *context) {
+    if(channels & TIMER_OCR_A) {
+        __setTimerInterrupt(timsk, tifr, TIMER_INTERRUPT_COMPARE_A,
+                callbacks, contexts, callback, context);
+    }
+
+    if(channels & TIMER_OCR_B) {
+        __setTimerInterrupt(timsk, tifr, TIMER_INTERRUPT_COMPARE_B,
+                callbacks, contexts, callback, context);
+    }
+
+    if((numOcrChannels > 2) && (channels & TIMER_OCR_C)) {
+        __setTimerInterrupt(timsk, tifr, TIMER_INTERRUPT_COMPARE_C,
+                callbacks, contexts, callback, context);
+    }
+}
+
+// ISRs
+
+#define __TIMER_ISR(vector, timer, source) \
+    ISR(vector) { \
+        timer.handleInterrupt(source); \
+    }
+
+#if defined(TCCR0A) && !defined(LLAVR_NO_TIMER0_ISRS)
+__TIMER_ISR(TIMER0_OVF_vect, Timer0, TIMER_INTERRUPT_OVERFLOW)
+__TIMER_ISR(TIMER0_COMPA_vect, Timer0, TIMER_INTERRUPT_COMPARE_A)
+__TIMER_ISR(TIMER0_COMPB_vect, Timer0, TIMER_INTERRUPT_COMPARE_B)
+#endif
+
+#if defined(TCCR1A) && !defined(LLAVR_NO_TIMER1_ISRS)
+__TIMER_ISR(TIMER1_OVF_vect, Timer1, TIMER_INTERRUPT_OVERFLOW)
+__TIMER_ISR(TIMER1_COMPA_vect, Timer1, TIMER_INTERRUPT_COMPARE_A)
+__TIMER_ISR(TIMER1_COMPB_vect, Timer1, TIMER_INTERRUPT_COMPARE_B)
+#if defined(OCR1CL)
+__TIMER_ISR(TIMER1_COMPC_vect, Timer1, TIMER_INTERRUPT_COMPARE_C)
+#endif
+#endif
+
+#if defined(TCCR2A) && !defined(LLAVR_NO_TIMER2_ISRS)
+__TIMER_ISR(TIMER2_OVF_vect, Timer2, TIMER_INTERRUPT_OVERFLOW)
+__TIMER_ISR(TIMER2_COMPA_vect, Timer2, TIMER_INTERRUPT_COMPARE_A)
+__TIMER_ISR(TIMER2_COMPB_vect, Timer2, TIMER_INTERRUPT_COMPARE_B)
+#endif
+
+#if defined(TCCR3A) && !defined(LLAVR_NO_TIMER3_ISRS)
+__TIMER_ISR(TIMER3_OVF_vect, Timer3, TIMER_INTERRUPT_OVERFLOW)
+__TIMER_ISR(TIMER3_COMPA_vect, Timer3, TIMER_INTERRUPT_COMPARE_A)
+__TIMER_ISR(TIMER3_COMPB_vect, Timer3, TIMER_INTERRUPT_COMPARE_B)
+#if defined(OCR3CL)
+__TIMER_ISR(TIMER3_COMPC_vect, Timer3, TIMER_INTERRUPT_COMPARE_C)
+#endif
+#endif
+
+#if defined(TCCR4A) && defined(ICR4L) && !defined(LLAVR_NO_TIMER4_ISRS)
+__TIMER_ISR(TIMER4_OVF_vect, Timer4, TIMER_INTERRUPT_OVERFLOW)
+__TIMER_ISR(TIMER4_COMPA_vect, Timer4, TIMER_INTERRUPT_COMPARE_A)
+__TIMER_ISR(TIMER4_COMPB_vect, Timer4, TIMER_INTERRUPT_COMPARE_B)
+__TIMER_ISR(TIMER4_COMPC_vect, Timer4, TIMER_INTERRUPT_COMPARE_C)
+#endif
+
+#if defined(TCCR5A) && !defined(LLAVR_NO_TIMER5_ISRS)
+__TIMER_ISR(TIMER5_OVF_vect, Timer5, TIMER_INTERRUPT_OVERFLOW)
+__TIMER_ISR(TIMER5_COMPA_vect, Timer5, TIMER_INTERRUPT_COMPARE_A)
+__TIMER_ISR(TIMER5_COMPB_vect, Timer5, TIMER_INTERRUPT_COMPARE_B)
+__TIMER_ISR(TIMER5_COMPC_vect, Timer5, TIMER_INTERRUPT_COMPARE_C)
+#endif
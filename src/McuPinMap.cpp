@@ -0,0 +1,106 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "McuPinMap.h"
+
+#if !defined(LLAVR_NO_OC_PINS)
+
+/**
+ * @brief Output compare pin descriptor
+ *
+ * NOTE: DDRx is the register just below PORTx on all supported MCUs.
+ */
+typedef struct {
+    HardwareTimer *timer;       ///< timer driving the pin
+    volatile uint8_t *port;     ///< PORTx register of the pin
+    uint8_t mask;               ///< bit of the pin in its port registers
+    uint8_t channel;            ///< TimerCompareChannel of the pin
+} __OcPinInfo;
+
+#define __LLAVR_OC_INFO(name, timer, channel, port, bit) \
+    { &Timer##timer, &PORT##port, (uint8_t)_BV(bit), (uint8_t)TIMER_OCR_##channel },
+
+static const __OcPinInfo __ocPins[OC_PIN_COUNT] PROGMEM = {
+    LLAVR_OC_PINS(__LLAVR_OC_INFO)
+};
+
+#undef __LLAVR_OC_INFO
+
+/**
+ * @brief Copy a pin descriptor out of flash
+ */
+static inline void __readOcPin(uint8_t pin, __OcPinInfo *info) {
+    memcpy_P(info, &__ocPins[pin], sizeof(__OcPinInfo));
+}
+
+/**
+ * @brief Set the DDR bit of a pin
+ *
+ * NOTE: DDRH..DDRL on the 1280/2560 are outside the sbi/cbi range, so the
+ *   read-modify-write is done with interrupts disabled.
+ */
+static void __setOcPinOutput(const __OcPinInfo *info) {
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+
+    *(info->port - 1) |= info->mask;
+
+    SREG = saveSreg;
+}
+
+HardwareTimer *getOutputCompareTimer(OutputComparePin pin) {
+    __OcPinInfo info;
+
+    __readOcPin(pin, &info);
+
+    return info.timer;
+}
+
+TimerCompareChannel getOutputCompareChannel(OutputComparePin pin) {
+    __OcPinInfo info;
+
+    __readOcPin(pin, &info);
+
+    return (TimerCompareChannel)info.channel;
+}
+
+void setOutputComparePinOutput(OutputComparePin pin) {
+    __OcPinInfo info;
+
+    __readOcPin(pin, &info);
+    __setOcPinOutput(&info);
+}
+
+#else
+
+// no pins to drive
+
+HardwareTimer *getOutputCompareTimer(OutputComparePin pin) {
+    return NULL_HWTIMER;
+}
+
+TimerCompareChannel getOutputCompareChannel(OutputComparePin pin) {
+    return TIMER_OCR_A;
+}
+
+void setOutputComparePinOutput(OutputComparePin pin) {
+    // nop
+}
+
+#endif /* LLAVR_NO_OC_PINS */
@@ -0,0 +1,416 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NumberParser.h"
+
+#include <ctype.h>
+#include <util/delay.h>
+
+/** @brief scanner state bits */
+#define __NUMBER_FLAG_SIGN          0x0001  ///< sign seen
+#define __NUMBER_FLAG_NEGATIVE      0x0002  ///< sign was '-'
+#define __NUMBER_FLAG_DIGITS        0x0004  ///< mantissa digit seen
+#define __NUMBER_FLAG_HEX           0x0008  ///< 0x prefix seen
+#define __NUMBER_FLAG_FRACTION      0x0010  ///< decimal point seen
+#define __NUMBER_FLAG_EXPONENT      0x0020  ///< exponent marker seen
+#define __NUMBER_FLAG_EXP_SIGN      0x0040  ///< exponent sign seen
+#define __NUMBER_FLAG_EXP_NEGATIVE  0x0080  ///< exponent sign was '-'
+#define __NUMBER_FLAG_EXP_DIGITS    0x0100  ///< exponent digit seen
+#define __NUMBER_FLAG_OVERFLOW      0x0200  ///< integer digits didn't fit
+
+/** @brief mantissa * 10 + d fits in 32 bits iff mantissa < this (or equal
+ *  and d <= 5); avoids a 32-bit division per digit */
+#define __MANTISSA_LIMIT            429496729UL
+
+/** @brief large enough that any non-zero mantissa overflows */
+#define __MAX_EXPONENT              999
+
+static const uint32_t __pow10[10] PROGMEM = {
+    1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL, 10000000UL,
+    100000000UL, 1000000000UL
+};
+
+// NumberScanner ///////////////////////////////////////////////////////////////
+
+NumberScanner::NumberScanner(NumberFormat format)
+    : mantissa(0),
+      exponent(0),
+      expValue(0),
+      flags(0),
+      format(format) {
+    // nop
+}
+
+void NumberScanner::reset() {
+    mantissa = 0;
+    exponent = 0;
+    expValue = 0;
+    flags = 0;
+}
+
+bool NumberScanner::accept(char c) {
+    uint8_t d;
+
+    if(flags & __NUMBER_FLAG_EXPONENT) {
+        if(c >= '0' && c <= '9') {
+            if(expValue < __MAX_EXPONENT) {
+                expValue = expValue * 10 + (c - '0');
+            }
+
+            flags |= __NUMBER_FLAG_EXP_DIGITS;
+            return true;
+        }
+
+        if((c == '-' || c == '+') &&
+                !(flags & (__NUMBER_FLAG_EXP_SIGN | __NUMBER_FLAG_EXP_DIGITS))) {
+            flags |= __NUMBER_FLAG_EXP_SIGN;
+
+            if(c == '-') {
+                flags |= __NUMBER_FLAG_EXP_NEGATIVE;
+            }
+
+            return true;
+        }
+
+        return false;
+    }
+
+    if(c >= '0' && c <= '9') {
+        d = c - '0';
+    } else if((flags & __NUMBER_FLAG_HEX) && c >= 'a' && c <= 'f') {
+        d = c - 'a' + 10;
+    } else if((flags & __NUMBER_FLAG_HEX) && c >= 'A' && c <= 'F') {
+        d = c - 'A' + 10;
+    } else if((c == '-' || c == '+') &&
+            !(flags & (__NUMBER_FLAG_SIGN | __NUMBER_FLAG_DIGITS | __NUMBER_FLAG_FRACTION))) {
+        flags |= __NUMBER_FLAG_SIGN;
+
+        if(c == '-') {
+            flags |= __NUMBER_FLAG_NEGATIVE;
+        }
+
+        return true;
+    } else if(format == NUMBER_INTEGER && (c == 'x' || c == 'X') &&
+            (flags & __NUMBER_FLAG_DIGITS) && !(flags & __NUMBER_FLAG_HEX) &&
+            mantissa == 0) {
+        flags |= __NUMBER_FLAG_HEX;
+        return true;
+    } else if(format == NUMBER_DECIMAL && c == '.' &&
+            !(flags & __NUMBER_FLAG_FRACTION)) {
+        flags |= __NUMBER_FLAG_FRACTION;
+        return true;
+    } else if(format == NUMBER_DECIMAL && (c == 'e' || c == 'E') &&
+            (flags & __NUMBER_FLAG_DIGITS)) {
+        flags |= __NUMBER_FLAG_EXPONENT;
+        return true;
+    } else {
+        return false;
+    }
+
+    flags |= __NUMBER_FLAG_DIGITS;
+
+    if(flags & __NUMBER_FLAG_HEX) {
+        if(mantissa & 0xF0000000UL) {
+            flags |= __NUMBER_FLAG_OVERFLOW;
+        } else {
+            mantissa = (mantissa << 4) | d;
+        }
+    } else if(mantissa < __MANTISSA_LIMIT ||
+            (mantissa == __MANTISSA_LIMIT && d <= 5)) {
+        mantissa = mantissa * 10 + d;
+
+        if(flags & __NUMBER_FLAG_FRACTION) {
+            exponent--;
+        }
+    } else if(format == NUMBER_INTEGER) {
+        flags |= __NUMBER_FLAG_OVERFLOW;
+    } else if(!(flags & __NUMBER_FLAG_FRACTION) && exponent < __MAX_EXPONENT) {
+        // out of significant digits; drop this one but keep its weight
+        exponent++;
+    }
+
+    return true;
+}
+
+NumberStatus NumberScanner::scaled(uint8_t decimals, uint32_t *value) const {
+    int16_t scale = exponent + decimals;
+    uint32_t m = mantissa;
+    uint32_t p, r;
+
+    if(flags & __NUMBER_FLAG_OVERFLOW) {
+        return NUMBER_OVERFLOW;
+    }
+
+    if(flags & __NUMBER_FLAG_EXP_NEGATIVE) {
+        scale -= expValue;
+    } else {
+        scale += expValue;
+    }
+
+    for(; scale > 0 && m != 0; scale--) {
+        if(m > __MANTISSA_LIMIT) {
+            return NUMBER_OVERFLOW;
+        }
+
+        m *= 10;
+    }
+
+    if(scale < -9) {
+        // 10^10 is more than any mantissa
+        m = 0;
+    } else if(scale < 0) {
+        // round half away from zero
+        p = pgm_read_dword(&__pow10[-scale]);
+        r = m % p;
+        m /= p;
+
+        if(r >= p - r) {
+            m++;
+        }
+    }
+
+    *value = m;
+
+    return NUMBER_OK;
+}
+
+NumberStatus NumberScanner::toLong(long *value) const {
+    return toFixed(0, value);
+}
+
+NumberStatus NumberScanner::toUnsignedLong(unsigned long *value) const {
+    uint32_t m;
+    NumberStatus status;
+
+    *value = 0;
+
+    if(!(flags & __NUMBER_FLAG_DIGITS)) {
+        return NUMBER_EMPTY;
+    }
+
+    status = scaled(0, &m);
+
+    if(status != NUMBER_OK) {
+        *value = 0xFFFFFFFFUL;
+    } else if((flags & __NUMBER_FLAG_NEGATIVE) && m != 0) {
+        status = NUMBER_OVERFLOW;
+    } else {
+        *value = m;
+    }
+
+    return status;
+}
+
+NumberStatus NumberScanner::toFixed(uint8_t decimals, long *value) const {
+    uint32_t m;
+    uint32_t limit;
+    NumberStatus status;
+
+    *value = 0;
+
+    if(!(flags & __NUMBER_FLAG_DIGITS)) {
+        return NUMBER_EMPTY;
+    }
+
+    // one more in magnitude for LONG_MIN
+    limit = (flags & __NUMBER_FLAG_NEGATIVE) ? 0x80000000UL : 0x7FFFFFFFUL;
+    status = scaled(decimals, &m);
+
+    if(status != NUMBER_OK || m > limit) {
+        m = limit;
+        status = NUMBER_OVERFLOW;
+    }
+
+    *value = (flags & __NUMBER_FLAG_NEGATIVE) ? (long)(0UL - m) : (long)m;
+
+    return status;
+}
+
+NumberStatus NumberScanner::toFloat(float *value) const {
+    int16_t e = exponent;
+    uint16_t n;
+    float f = (float)mantissa;
+    float p = 1.0;
+    float b = 10.0;
+
+    *value = 0.0;
+
+    if(!(flags & __NUMBER_FLAG_DIGITS)) {
+        return NUMBER_EMPTY;
+    }
+
+    if(flags & __NUMBER_FLAG_EXP_NEGATIVE) {
+        e -= expValue;
+    } else {
+        e += expValue;
+    }
+
+    if(mantissa == 0) {
+        // 0 * inf would be NaN
+        e = 0;
+    }
+
+    // 10^|e| by squaring, so a single rounding step is applied to f
+    for(n = (e < 0) ? -e : e; n != 0; n >>= 1) {
+        if(n & 1) {
+            p *= b;
+        }
+
+        b *= b;
+    }
+
+    f = (e < 0) ? (f / p) : (f * p);
+
+    if(flags & __NUMBER_FLAG_NEGATIVE) {
+        f = -f;
+    }
+
+    *value = f;
+
+    return isinf(f) ? NUMBER_OVERFLOW : NUMBER_OK;
+}
+
+// parsing from buffers ////////////////////////////////////////////////////////
+
+/**
+ * @brief Feed a buffer to a scanner, skipping leading whitespace (as atol()
+ *   and strtod() do, so e.g. a "\r\n" left over from the previous line is
+ *   ignored)
+ */
+static void __scan(NumberScanner &scanner, const char *str, size_t len, size_t *used) {
+    size_t i = 0;
+
+    if(!str) {
+        len = 0;
+    }
+
+    while(i < len && isspace((unsigned char)str[i])) {
+        i++;
+    }
+
+    while(i < len && scanner.accept(str[i])) {
+        i++;
+    }
+
+    if(used) {
+        *used = i;
+    }
+}
+
+NumberStatus parseInt(const char *str, size_t len, long *value, size_t *used) {
+    NumberScanner scanner(NUMBER_INTEGER);
+
+    __scan(scanner, str, len, used);
+
+    return scanner.toLong(value);
+}
+
+NumberStatus parseUnsigned(const char *str, size_t len, unsigned long *value, size_t *used) {
+    NumberScanner scanner(NUMBER_INTEGER);
+
+    __scan(scanner, str, len, used);
+
+    return scanner.toUnsignedLong(value);
+}
+
+NumberStatus parseFixed(const char *str, size_t len, uint8_t decimals, long *value, size_t *used) {
+    NumberScanner scanner(NUMBER_DECIMAL);
+
+    __scan(scanner, str, len, used);
+
+    return scanner.toFixed(decimals, value);
+}
+
+NumberStatus parseFloat(const char *str, size_t len, float *value, size_t *used) {
+    NumberScanner scanner(NUMBER_DECIMAL);
+
+    __scan(scanner, str, len, used);
+
+    return scanner.toFloat(value);
+}
+
+// parsing from serial ports ///////////////////////////////////////////////////
+
+/**
+ * @brief Feed received characters to a scanner until the number ends or the
+ *   line is idle for timeout ms
+ *
+ * @return false if the timeout expired before the number started
+ */
+static bool __scan(NumberScanner &scanner, HardwareSerial &in, uint16_t timeout) {
+    uint16_t idle = 0;
+    int c;
+
+    while(true) {
+        c = in.peek();
+
+        if(c < 0) {
+            if(idle >= timeout) {
+                return scanner.started();
+            }
+
+            _delay_ms(1);
+            idle++;
+            continue;
+        }
+
+        idle = 0;
+
+        if(scanner.accept((char)c)) {
+            in.read();
+        } else if(scanner.started()) {
+            // leave the terminator for the caller
+            return true;
+        } else {
+            // discard anything before the number
+            in.read();
+        }
+    }
+}
+
+NumberStatus parseInt(HardwareSerial &in, long *value, uint16_t timeout) {
+    NumberScanner scanner(NUMBER_INTEGER);
+
+    if(!__scan(scanner, in, timeout)) {
+        *value = 0;
+        return NUMBER_TIMEOUT;
+    }
+
+    return scanner.toLong(value);
+}
+
+NumberStatus parseFixed(HardwareSerial &in, uint8_t decimals, long *value, uint16_t timeout) {
+    NumberScanner scanner(NUMBER_DECIMAL);
+
+    if(!__scan(scanner, in, timeout)) {
+        *value = 0;
+        return NUMBER_TIMEOUT;
+    }
+
+    return scanner.toFixed(decimals, value);
+}
+
+NumberStatus parseFloat(HardwareSerial &in, float *value, uint16_t timeout) {
+    NumberScanner scanner(NUMBER_DECIMAL);
+
+    if(!__scan(scanner, in, timeout)) {
+        *value = 0.0;
+        return NUMBER_TIMEOUT;
+    }
+
+    return scanner.toFloat(value);
+}
@@ -0,0 +1,287 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PacketFraming.h"
+
+/** @brief longest run of non-zero bytes a single COBS block can hold */
+#define __COBS_MAX_RUN 254
+
+// CobsEncoder /////////////////////////////////////////////////////////////////
+
+CobsEncoder::CobsEncoder(Print &out, bool appendCrc)
+    : out(&out),
+      appendCrc(appendCrc) {
+    // nop
+}
+
+size_t CobsEncoder::writeFrame(const uint8_t *buffer, size_t size) {
+    uint8_t crc[2];
+    size_t total = size;
+    size_t i = 0;
+    size_t j, run, n;
+    size_t written = 0;
+    uint8_t code;
+
+    /*
+     * The CRC is treated as two extra payload bytes following the caller's
+     * buffer, so runs may span the end of the buffer.
+     */
+
+    if(appendCrc) {
+        uint16_t c = crc16Update(CRC16_INIT, buffer, size);
+        crc[0] = highByte(c);
+        crc[1] = lowByte(c);
+        total += 2;
+    }
+
+    while(true) {
+        // find the end of the current run of non-zero bytes
+        for(j = i; j < total && (j - i) < __COBS_MAX_RUN; j++) {
+            if(((j < size) ? buffer[j] : crc[j - size]) == 0) {
+                break;
+            }
+        }
+
+        run = j - i;
+        code = (uint8_t)(run + 1);
+        written += out->write(code);
+
+        // write the run, straight from the caller's buffer where possible
+        if(i < size) {
+            n = (run < size - i) ? run : (size - i);
+            written += out->write(buffer + i, n);
+            i += n;
+            run -= n;
+        }
+
+        if(run > 0) {
+            written += out->write(crc + (i - size), run);
+            i += run;
+        }
+
+        if(i >= total) {
+            break;
+        }
+
+        if(code != 0xFF) {
+            // skip the zero this block stands for
+            i++;
+
+            if(i >= total) {
+                // trailing zero: terminate with an empty block
+                written += out->write((uint8_t)1);
+                break;
+            }
+        }
+    }
+
+    written += out->write(COBS_DELIM);
+
+    return written;
+}
+
+// SlipEncoder /////////////////////////////////////////////////////////////////
+
+SlipEncoder::SlipEncoder(Print &out, bool appendCrc)
+    : out(&out),
+      appendCrc(appendCrc),
+      crc(CRC16_INIT) {
+    // nop
+}
+
+size_t SlipEncoder::beginFrame() {
+    crc = CRC16_INIT;
+
+    return out->write(SLIP_END);
+}
+
+size_t SlipEncoder::write(const uint8_t *buffer, size_t size) {
+    static const uint8_t escEnd[2] = { SLIP_ESC, SLIP_ESC_END };
+    static const uint8_t escEsc[2] = { SLIP_ESC, SLIP_ESC_ESC };
+    size_t start = 0;
+    size_t i;
+    size_t written = 0;
+
+    if(appendCrc) {
+        crc = crc16Update(crc, buffer, size);
+    }
+
+    for(i = 0; i < size; i++) {
+        if(buffer[i] == SLIP_END || buffer[i] == SLIP_ESC) {
+            // flush the run of plain bytes before the escape
+            if(i > start) {
+                written += out->write(buffer + start, i - start);
+            }
+
+            written += out->write(
+                    (buffer[i] == SLIP_END) ? escEnd : escEsc, 2);
+            start = i + 1;
+        }
+    }
+
+    if(size > start) {
+        written += out->write(buffer + start, size - start);
+    }
+
+    return written;
+}
+
+size_t SlipEncoder::endFrame() {
+    size_t written = 0;
+
+    if(appendCrc) {
+        uint8_t c[2];
+
+        c[0] = highByte(crc);
+        c[1] = lowByte(crc);
+
+        // don't fold the CRC bytes into the CRC
+        appendCrc = false;
+        written += write(c, 2);
+        appendCrc = true;
+    }
+
+    written += out->write(SLIP_END);
+
+    return written;
+}
+
+// FrameDecoder ////////////////////////////////////////////////////////////////
+
+FrameDecoder::FrameDecoder(uint8_t *buffer, size_t size, bool checkCrc)
+    : buffer(buffer),
+      size(size),
+      pos(0),
+      frameLength(0),
+      checkCrc(checkCrc),
+      overflow(false) {
+    // nop
+}
+
+FrameStatus FrameDecoder::poll(HardwareSerial &in) {
+    FrameStatus status = FRAME_PENDING;
+    int c;
+
+    while(status == FRAME_PENDING && (c = in.read()) >= 0) {
+        status = decode((uint8_t)c);
+    }
+
+    return status;
+}
+
+void FrameDecoder::reset() {
+    pos = 0;
+    overflow = false;
+}
+
+FrameStatus FrameDecoder::finish(bool malformed) {
+    FrameStatus status = FRAME_OK;
+
+    if(overflow) {
+        status = FRAME_ERROR_OVERFLOW;
+    } else if(malformed) {
+        status = FRAME_ERROR_ENCODING;
+    } else if(checkCrc) {
+        // CRC over payload + CRC leaves a zero remainder
+        if(pos < 2 || crc16Update(CRC16_INIT, buffer, pos) != 0) {
+            status = FRAME_ERROR_CRC;
+        } else {
+            frameLength = pos - 2;
+        }
+    } else {
+        frameLength = pos;
+    }
+
+    reset();
+
+    return status;
+}
+
+// CobsDecoder /////////////////////////////////////////////////////////////////
+
+CobsDecoder::CobsDecoder(uint8_t *buffer, size_t size, bool checkCrc)
+    : FrameDecoder(buffer, size, checkCrc),
+      blockCode(0),
+      blockLeft(0) {
+    // nop
+}
+
+FrameStatus CobsDecoder::decode(uint8_t c) {
+    FrameStatus status = FRAME_PENDING;
+
+    if(c == COBS_DELIM) {
+        // ignore back-to-back delimiters (idle line / resync)
+        if(blockCode != 0) {
+            status = finish(blockLeft != 0);
+        }
+
+        blockCode = 0;
+        blockLeft = 0;
+    } else if(blockLeft == 0) {
+        // new block; the previous one stood for a zero unless it was full
+        if(blockCode != 0 && blockCode != 0xFF) {
+            append(0);
+        }
+
+        blockCode = c;
+        blockLeft = c - 1;
+    } else {
+        append(c);
+        blockLeft--;
+    }
+
+    return status;
+}
+
+// SlipDecoder /////////////////////////////////////////////////////////////////
+
+SlipDecoder::SlipDecoder(uint8_t *buffer, size_t size, bool checkCrc)
+    : FrameDecoder(buffer, size, checkCrc),
+      escaped(false),
+      malformed(false) {
+    // nop
+}
+
+FrameStatus SlipDecoder::decode(uint8_t c) {
+    FrameStatus status = FRAME_PENDING;
+
+    if(c == SLIP_END) {
+        // ignore empty frames (leading END / idle line)
+        if(pos > 0 || overflow || malformed || escaped) {
+            status = finish(malformed || escaped);
+        }
+
+        escaped = false;
+        malformed = false;
+    } else if(escaped) {
+        if(c == SLIP_ESC_END) {
+            append(SLIP_END);
+        } else if(c == SLIP_ESC_ESC) {
+            append(SLIP_ESC);
+        } else {
+            malformed = true;
+        }
+
+        escaped = false;
+    } else if(c == SLIP_ESC) {
+        escaped = true;
+    } else {
+        append(c);
+    }
+
+    return status;
+}
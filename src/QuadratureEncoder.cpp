@@ -0,0 +1,243 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "QuadratureEncoder.h"
+
+/** @brief Table entry for a transition that skipped a state */
+#define __ENCODER_INVALID 2
+
+/**
+ * @brief Count step, indexed by (previous AB << 2) | current AB
+ *
+ * Forward is 00 -> 01 -> 11 -> 10 -> 00.
+ */
+#if defined(LLAVR_ENCODER_TABLE_IN_RAM)
+static const int8_t __encoderSteps[16] = {
+#else
+static const int8_t __encoderSteps[16] PROGMEM = {
+#endif
+     0, +1, -1, __ENCODER_INVALID,
+    -1,  0, __ENCODER_INVALID, +1,
+    +1, __ENCODER_INVALID,  0, -1,
+    __ENCODER_INVALID, -1, +1,  0,
+};
+
+static inline int8_t __encoderStep(uint8_t index) {
+#if defined(LLAVR_ENCODER_TABLE_IN_RAM)
+    return __encoderSteps[index];
+#else
+    return (int8_t)pgm_read_byte(&__encoderSteps[index]);
+#endif
+}
+
+QuadratureEncoder::QuadratureEncoder(uint8_t pinA, uint8_t pinB, HardwareTimer *timer)
+    : pinA(pinA),
+      pinB(pinB),
+      inputA(NOREG),
+      inputB(NOREG),
+      maskA(0),
+      maskB(0),
+      timer(timer),
+      count(0),
+      errors(0),
+      lastEdge(0),
+      interval(0),
+      direction(0),
+      edges(0),
+      state(0) {
+    // nop
+}
+
+bool QuadratureEncoder::begin() {
+    inputA = PinChangeInterrupt::getInputRegister(pinA, &maskA);
+    inputB = PinChangeInterrupt::getInputRegister(pinB, &maskB);
+
+    if(inputA == NOREG || inputB == NOREG) {
+        return false;
+    }
+
+    state = readChannels();
+
+    if(!PinChangeInterrupt::attach(pinA, onEdge, this)) {
+        return false;
+    }
+
+    if(!PinChangeInterrupt::attach(pinB, onEdge, this)) {
+        PinChangeInterrupt::detach(pinA);
+        return false;
+    }
+
+    return true;
+}
+
+void QuadratureEncoder::end() {
+    PinChangeInterrupt::detach(pinA);
+    PinChangeInterrupt::detach(pinB);
+}
+
+int32_t QuadratureEncoder::getCount() {
+    int32_t result;
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+    result = count;
+    SREG = saveSreg;
+
+    return result;
+}
+
+void QuadratureEncoder::setCount(int32_t count) {
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+    this->count = count;
+    SREG = saveSreg;
+}
+
+uint16_t QuadratureEncoder::getErrors() {
+    uint16_t result;
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+    result = errors;
+    SREG = saveSreg;
+
+    return result;
+}
+
+uint16_t QuadratureEncoder::getEdgeInterval() {
+    uint16_t result = 0;
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+
+    if(edges >= 2) {
+        result = interval;
+    }
+
+    SREG = saveSreg;
+
+    return result;
+}
+
+int32_t QuadratureEncoder::getVelocity() {
+    uint32_t ticksPerSecond = F_CPU;
+    uint16_t ticks;
+    int8_t dir;
+    uint8_t saveSreg;
+
+    if(timer == NULL_HWTIMER) {
+        return 0;
+    }
+
+    saveSreg = SREG;
+    cli();
+    ticks = (edges >= 2) ? interval : 0;
+    dir = direction;
+    SREG = saveSreg;
+
+    if(ticks == 0) {
+        return 0;
+    }
+
+    switch(timer->getPrescale()) {
+    case TIMER_PRESCALE_NONE:
+        break;
+
+    case TIMER_PRESCALE_8:
+        ticksPerSecond >>= 3;
+        break;
+
+    case TIMER_PRESCALE_64:
+        ticksPerSecond >>= 6;
+        break;
+
+    case TIMER_PRESCALE_256:
+        ticksPerSecond >>= 8;
+        break;
+
+    case TIMER_PRESCALE_1024:
+        ticksPerSecond >>= 10;
+        break;
+    }
+
+    return (dir < 0) ? -(int32_t)(ticksPerSecond / ticks) : (int32_t)(ticksPerSecond / ticks);
+}
+
+inline uint8_t QuadratureEncoder::readChannels() {
+    uint8_t a, b;
+
+    // one read when both channels are on the same port (the usual case)
+    a = *inputA;
+    b = (inputB == inputA) ? a : *inputB;
+
+    return (((a & maskA) != 0) << 1) | ((b & maskB) != 0);
+}
+
+void QuadratureEncoder::update(uint8_t ab) {
+    int8_t step = __encoderStep((state << 2) | ab);
+    uint16_t now;
+
+    state = ab;
+
+    if(step == 0) {
+        return;
+    }
+
+    if(step == __ENCODER_INVALID) {
+        errors++;
+        return;
+    }
+
+    count += step;
+
+    if(timer != NULL_HWTIMER) {
+        now = timer->getCount();
+        interval = now - lastEdge;
+        lastEdge = now;
+        direction = step;
+
+        if(edges < 2) {
+            edges++;
+        }
+    }
+}
+
+void QuadratureEncoder::onEdge(void *context, uint8_t state) {
+    QuadratureEncoder *encoder = (QuadratureEncoder *)context;
+#if defined(LLAVR_INTERRUPT_NOBLOCK)
+    uint8_t saveSreg;
+
+    // the handler runs with interrupts enabled; keep a nested pin change
+    // from decoding between the read and the update
+    saveSreg = SREG;
+    cli();
+#endif
+
+    // read both channels together (the dispatcher's state is only the level
+    // of the pin that changed), so an edge missed on the other channel shows
+    // up as an invalid transition
+    encoder->update(encoder->readChannels());
+
+#if defined(LLAVR_INTERRUPT_NOBLOCK)
+    SREG = saveSreg;
+#endif
+}
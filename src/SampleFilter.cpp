@@ -0,0 +1,240 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SampleFilter.h"
+
+#ifndef __AVR__
+#include <math.h>
+#endif
+
+/**
+ * @brief Saturate a 32-bit value to int16_t
+ */
+static inline int16_t __saturate16(int32_t value) {
+    if(value > 32767L) {
+        return 32767;
+    } else if(value < -32768L) {
+        return -32768;
+    }
+
+    return (int16_t)value;
+}
+
+/**
+ * @brief Convert a float coefficient to Q2.14, rounding to nearest
+ */
+static int16_t __toQ14(float value) {
+    float scaled = value * 16384.0F;
+
+    return __saturate16((int32_t)(scaled >= 0.0F ? scaled + 0.5F : scaled - 0.5F));
+}
+
+// OnePoleFilter ///////////////////////////////////////////////////////////////
+
+OnePoleFilter::OnePoleFilter(int16_t alpha)
+    : state(0),
+      alpha(alpha),
+      primed(false) {
+    // nop
+}
+
+int16_t OnePoleFilter::process(int16_t sample) {
+    int16_t out;
+
+    if(!primed) {
+        // start from the first sample rather than ramping up from zero
+        state = (int32_t)sample << 15;
+        primed = true;
+        return sample;
+    }
+
+    out = (int16_t)((state + 0x4000L) >> 15);
+    state += (int32_t)alpha * (int16_t)(sample - out);
+
+    return (int16_t)((state + 0x4000L) >> 15);
+}
+
+void OnePoleFilter::reset() {
+    state = 0;
+    primed = false;
+}
+
+// BiquadFilter ////////////////////////////////////////////////////////////////
+
+BiquadFilter::BiquadFilter(const BiquadCoefficients &coefficients)
+    : c(coefficients),
+      x1(0), x2(0),
+      y1(0), y2(0),
+      error(0),
+      error2(0) {
+    // nop
+}
+
+int16_t BiquadFilter::process(int16_t sample) {
+    int32_t acc = 2L * error - error2;
+    int16_t out;
+
+    acc += (int32_t)c.b0 * sample;
+    acc += (int32_t)c.b1 * x1;
+    acc += (int32_t)c.b2 * x2;
+    acc -= (int32_t)c.a1 * y1;
+    acc -= (int32_t)c.a2 * y2;
+
+    out = __saturate16(acc >> 14);
+    error2 = error;
+    error = (int16_t)(acc & 0x3FFF);
+
+    x2 = x1;
+    x1 = sample;
+    y2 = y1;
+    y1 = out;
+
+    return out;
+}
+
+void BiquadFilter::reset() {
+    x1 = x2 = 0;
+    y1 = y2 = 0;
+    error = 0;
+    error2 = 0;
+}
+
+BiquadCoefficients BiquadFilter::lowPass(float cutoff, float q) {
+    BiquadCoefficients result;
+    float w0 = 2.0F * (float)M_PI * cutoff;
+    float cw = cos(w0);
+    float alpha = sin(w0) / (2.0F * q);
+    float a0 = 1.0F + alpha;
+
+    result.b0 = __toQ14((1.0F - cw) / 2.0F / a0);
+    result.b1 = __toQ14((1.0F - cw) / a0);
+    result.b2 = result.b0;
+    result.a1 = __toQ14(-2.0F * cw / a0);
+    result.a2 = __toQ14((1.0F - alpha) / a0);
+
+    return result;
+}
+
+BiquadCoefficients BiquadFilter::highPass(float cutoff, float q) {
+    BiquadCoefficients result;
+    float w0 = 2.0F * (float)M_PI * cutoff;
+    float cw = cos(w0);
+    float alpha = sin(w0) / (2.0F * q);
+    float a0 = 1.0F + alpha;
+
+    result.b0 = __toQ14((1.0F + cw) / 2.0F / a0);
+    result.b1 = __toQ14(-(1.0F + cw) / a0);
+    result.b2 = result.b0;
+    result.a1 = __toQ14(-2.0F * cw / a0);
+    result.a2 = __toQ14((1.0F - alpha) / a0);
+
+    return result;
+}
+
+// MovingAverageBase ///////////////////////////////////////////////////////////
+
+MovingAverageBase::MovingAverageBase(int16_t *window, uint8_t length)
+    : window(window),
+      length(length),
+      index(0),
+      count(0),
+      sum(0) {
+    // power-of-two windows divide with a shift once full
+    for(shift = 0; shift < 8 && (1 << shift) < length; shift++);
+
+    if((1 << shift) != length) {
+        shift = 0xFF;
+    }
+}
+
+int16_t MovingAverageBase::process(int16_t sample) {
+    int32_t n;
+
+    if(count == length) {
+        sum -= window[index];
+    } else {
+        count++;
+    }
+
+    sum += sample;
+    window[index] = sample;
+    index = (index + 1 < length) ? index + 1 : 0;
+
+    if(count == length && shift != 0xFF) {
+        // rounds half up
+        return (int16_t)((sum + ((1L << shift) >> 1)) >> shift);
+    }
+
+    // round half away from zero
+    n = count;
+    return (int16_t)((sum >= 0 ? sum + n / 2 : sum - n / 2) / n);
+}
+
+void MovingAverageBase::reset() {
+    index = 0;
+    count = 0;
+    sum = 0;
+}
+
+// MedianBase //////////////////////////////////////////////////////////////////
+
+MedianBase::MedianBase(int16_t *window, int16_t *sorted, uint8_t length)
+    : window(window),
+      sorted(sorted),
+      length(length),
+      index(0),
+      count(0) {
+    // nop
+}
+
+int16_t MedianBase::process(int16_t sample) {
+    int16_t tmp;
+    uint8_t i;
+
+    if(count == length) {
+        // overwrite the oldest sample's slot in the sorted copy
+        for(i = 0; sorted[i] != window[index]; i++);
+    } else {
+        i = count++;
+    }
+
+    sorted[i] = sample;
+    window[index] = sample;
+    index = (index + 1 < length) ? index + 1 : 0;
+
+    // move the new sample into place; only one direction can apply
+    while(i > 0 && sorted[i - 1] > sorted[i]) {
+        tmp = sorted[i - 1];
+        sorted[i - 1] = sorted[i];
+        sorted[i] = tmp;
+        i--;
+    }
+
+    while(i + 1 < count && sorted[i + 1] < sorted[i]) {
+        tmp = sorted[i + 1];
+        sorted[i + 1] = sorted[i];
+        sorted[i] = tmp;
+        i++;
+    }
+
+    return sorted[count / 2];
+}
+
+void MedianBase::reset() {
+    index = 0;
+    count = 0;
+}
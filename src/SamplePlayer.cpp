@@ -0,0 +1,281 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SamplePlayer.h"
+
+/** @brief Sample value of the idle (mid) level */
+#define __IDLE_SAMPLE 0x80
+
+#if defined(LLAVR_SAMPLE_PLAYER_TIMER)
+#define __PLAYER_TIMER(n) __PLAYER_TIMER_(n)
+#define __PLAYER_TIMER_(n) Timer##n
+#define __PLAYER_VECTOR(n) __PLAYER_VECTOR_(n)
+#define __PLAYER_VECTOR_(n) TIMER##n##_OVF_vect
+
+/** @brief The player on the timer with the dedicated vector (or NULL) */
+static SamplePlayer *__player;
+#endif
+
+SamplePlayer::SamplePlayer(HardwareTimer *timer, TimerCompareChannel channel)
+    : timer(timer),
+      channel(channel),
+      levels(256),
+      divider(1),
+      sigmaDelta(false),
+      countdown(1),
+      scaled(0),
+      residue(0),
+      source(SAMPLE_SOURCE_NONE),
+      samples(NULL),
+      count(0),
+      index(0),
+      loop(false),
+      size(0),
+      readBuffer(0),
+      fillBuffer(0),
+      lastSample(__IDLE_SAMPLE),
+      underruns(0) {
+    buffers[0] = NULL;
+    buffers[1] = NULL;
+    full[0] = false;
+    full[1] = false;
+}
+
+void SamplePlayer::begin(uint8_t top, uint8_t divider, bool sigmaDelta) {
+    uint8_t comShift;
+
+    levels = timer->isWide() ? (uint16_t)top + 1 : 256;
+    this->divider = (divider > 0) ? divider : 1;
+    this->sigmaDelta = sigmaDelta;
+    countdown = 1;
+    residue = 0;
+
+    timer->setPrescaler(TIMER_PRESCALE_NONE);
+    timer->setFastPwmMode(top);
+    timer->setCompareValue(channel, (__IDLE_SAMPLE * levels) >> 8);
+    timer->enableOutputs(channel);
+
+    // for the ISR; registers of the timer objects are only known once
+    // they are constructed
+    timer->getCompareOutput(channel, &ocrH, &ocrL, &comShift);
+    timsk = timer->getInterruptMask();
+
+#if defined(LLAVR_SAMPLE_PLAYER_TIMER)
+    if(timer == &__PLAYER_TIMER(LLAVR_SAMPLE_PLAYER_TIMER)) {
+        __player = this;
+    }
+#endif
+}
+
+void SamplePlayer::end() {
+    stop();
+    timer->setCompareOutputMode(channel, TIMER_OUTPUT_DISCONNECTED);
+}
+
+uint32_t SamplePlayer::getSampleRate() {
+    return F_CPU / ((uint32_t)levels * divider);
+}
+
+void SamplePlayer::play(const uint8_t *samples, uint16_t count, bool loop) {
+    uint8_t saveSreg;
+
+    if(count == 0) {
+        return;
+    }
+
+    saveSreg = SREG;
+    cli();
+
+    this->samples = samples;
+    this->count = count;
+    this->loop = loop;
+    index = 0;
+    source = SAMPLE_SOURCE_PROGMEM;
+
+    timer->setOverflowInterrupt(onOverflow, this);
+
+    SREG = saveSreg;
+}
+
+void SamplePlayer::stream(uint8_t *bufferA, uint8_t *bufferB, uint16_t size) {
+    stop();
+
+    buffers[0] = bufferA;
+    buffers[1] = bufferB;
+    this->size = size;
+    full[0] = false;
+    full[1] = false;
+    readBuffer = 0;
+    fillBuffer = 0;
+    index = 0;
+    lastSample = __IDLE_SAMPLE;
+    underruns = 0;
+}
+
+uint8_t *SamplePlayer::getFreeBuffer() {
+    uint8_t b = readBuffer;
+
+    // the buffer being played is only free if it ran out
+    if(!full[b]) {
+        fillBuffer = b;
+    } else if(!full[b ^ 1]) {
+        fillBuffer = b ^ 1;
+    } else {
+        return NULL;
+    }
+
+    return buffers[fillBuffer];
+}
+
+void SamplePlayer::submitBuffer() {
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+
+    full[fillBuffer] = true;
+
+    if(source != SAMPLE_SOURCE_RAM) {
+        source = SAMPLE_SOURCE_RAM;
+        timer->setOverflowInterrupt(onOverflow, this);
+    }
+
+    SREG = saveSreg;
+}
+
+void SamplePlayer::stop() {
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+
+    timer->setOverflowInterrupt(NULL);
+    timer->setCompareRegister(channel, (__IDLE_SAMPLE * levels) >> 8);
+    source = SAMPLE_SOURCE_NONE;
+    countdown = 1;
+
+    SREG = saveSreg;
+}
+
+bool SamplePlayer::isPlaying() {
+    return source != SAMPLE_SOURCE_NONE;
+}
+
+uint16_t SamplePlayer::getUnderruns() {
+    uint16_t result;
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+    result = underruns;
+    SREG = saveSreg;
+
+    return result;
+}
+
+inline uint8_t SamplePlayer::nextSample() {
+    uint8_t sample;
+
+    switch(source) {
+    case SAMPLE_SOURCE_PROGMEM:
+        sample = pgm_read_byte(&samples[index]);
+
+        if(++index == count) {
+            index = 0;
+
+            if(!loop) {
+                // the last sample plays out, then the idle level
+                source = SAMPLE_SOURCE_NONE;
+            }
+        }
+
+        return sample;
+
+    case SAMPLE_SOURCE_RAM:
+        if(!full[readBuffer]) {
+            underruns++;
+            return lastSample;
+        }
+
+        sample = buffers[readBuffer][index];
+
+        if(++index == size) {
+            index = 0;
+            full[readBuffer] = false;
+            readBuffer ^= 1;
+        }
+
+        lastSample = sample;
+        return sample;
+
+    default:
+        // done: stop the interrupt (directly, to keep calls out of the ISR)
+        *timsk &= ~bit(TIMER_INTERRUPT_OVERFLOW);
+        return __IDLE_SAMPLE;
+    }
+}
+
+inline void SamplePlayer::writeLevel(uint8_t level) {
+    // TOP is at most 0xFF, so a 16-bit OCRnx's high byte is always 0; it's
+    // written first, as the low byte write takes the high byte from TEMP.
+    // Interrupts are already disabled here.
+    if(ocrH != NOREG) {
+        *ocrH = 0;
+    }
+
+    *ocrL = level;
+}
+
+inline void SamplePlayer::handleOverflow() {
+    uint16_t fraction;
+
+    if(--countdown == 0) {
+        countdown = divider;
+        scaled = (uint16_t)nextSample() * levels;
+
+        if(!sigmaDelta) {
+            // OCRnx is buffered until the next period in fast pwm
+            writeLevel(scaled >> 8);
+            return;
+        }
+    } else if(!sigmaDelta) {
+        return;
+    }
+
+    // first-order sigma-delta: round up whenever the fractions lost to the
+    // carrier's resolution add up to a whole level
+    fraction = (scaled & 0xFF) + residue;
+    residue = lowByte(fraction);
+    writeLevel((scaled >> 8) + highByte(fraction));
+}
+
+void SamplePlayer::onOverflow(void *context) {
+    ((SamplePlayer *)context)->handleOverflow();
+}
+
+/*
+ * The dedicated overflow vector: calls the player directly, instead of
+ * through the timer's callback, so the sample path inlines into the ISR and
+ * only the registers it uses are saved.
+ */
+#if defined(LLAVR_SAMPLE_PLAYER_TIMER)
+ISR(__PLAYER_VECTOR(LLAVR_SAMPLE_PLAYER_TIMER)) {
+    if(__player) {
+        __player->handleOverflow();
+    }
+}
+#endif
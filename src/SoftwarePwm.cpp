@@ -0,0 +1,253 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SoftwarePwm.h"
+
+/** @brief nextEdge value when the next event is the period start */
+#define __PERIOD_START 0xFF
+
+SoftwarePwm::SoftwarePwm(HardwareTimer *timer, uint16_t period)
+    : timer(timer),
+      period(period),
+      numPorts(0),
+      numChannels(0),
+      active(0),
+      pending(false),
+      nextEdge(__PERIOD_START),
+      periodStart(0) {
+    schedules[0].edgeCount = 0;
+    schedules[1].edgeCount = 0;
+}
+
+int8_t SoftwarePwm::addChannel(volatile uint8_t *port, uint8_t pin) {
+    uint8_t mask = (uint8_t)bit(pin);
+    uint8_t saveSreg;
+    uint8_t p;
+
+    if(numChannels >= SOFTPWM_MAX_CHANNELS) {
+        return -1;
+    }
+
+    for(p = 0; p < numPorts; p++) {
+        if(ports[p] == port) {
+            break;
+        }
+    }
+
+    if(p == numPorts) {
+        if(numPorts >= SOFTPWM_MAX_PORTS) {
+            return -1;
+        }
+
+        ports[p] = port;
+        portMask[p] = 0;
+        numPorts++;
+    }
+
+    saveSreg = SREG;
+    cli();
+
+    // low, then output (DDRx sits just below PORTx)
+    *port &= ~mask;
+    *(port - 1) |= mask;
+    portMask[p] |= mask;
+
+    SREG = saveSreg;
+
+    channelPort[numChannels] = p;
+    channelMask[numChannels] = mask;
+    duty[numChannels] = 0;
+
+    return numChannels++;
+}
+
+void SoftwarePwm::setDuty(uint8_t channel, uint16_t duty) {
+    if(channel < numChannels) {
+        this->duty[channel] = duty;
+    }
+}
+
+uint16_t SoftwarePwm::getDuty(uint8_t channel) {
+    return (channel < numChannels) ? duty[channel] : 0;
+}
+
+uint16_t SoftwarePwm::getPeriod() {
+    return period;
+}
+
+void SoftwarePwm::commit() {
+    SoftPwmSchedule *next;
+    SoftPwmEdge edge;
+    uint16_t time;
+    uint8_t saveSreg;
+    uint8_t count = 0;
+    uint8_t group = 0;
+    uint8_t c, i, j;
+
+    // withdraw any schedule not yet picked up; the ISR then only reads the
+    // active one, leaving the other free to rebuild
+    saveSreg = SREG;
+    cli();
+    pending = false;
+    SREG = saveSreg;
+
+    next = &schedules[active ^ 1];
+
+    for(i = 0; i < numPorts; i++) {
+        next->setMask[i] = 0;
+    }
+
+    // insertion sort by time; at most a few dozen entries
+    for(c = 0; c < numChannels; c++) {
+        time = duty[c];
+
+        if(time == 0) {
+            continue;
+        }
+
+        next->setMask[channelPort[c]] |= channelMask[c];
+
+        if(time + SOFTPWM_MIN_GAP >= period) {
+            // on for the whole period
+            continue;
+        }
+
+        if(time < SOFTPWM_MIN_GAP) {
+            time = SOFTPWM_MIN_GAP;
+        }
+
+        for(i = count; (i > 0) && (next->edges[i - 1].time > time); i--) {
+            next->edges[i] = next->edges[i - 1];
+        }
+
+        next->edges[i].time = time;
+        next->edges[i].port = channelPort[c];
+        next->edges[i].mask = channelMask[c];
+        count++;
+    }
+
+    // merge edges too close to handle apart into groups with one time, and
+    // within a group into one entry per port
+    next->edgeCount = 0;
+
+    for(i = 0; i < count; i++) {
+        edge = next->edges[i];
+
+        if((next->edgeCount > 0)
+                && (edge.time - next->edges[group].time < SOFTPWM_MIN_GAP)) {
+            edge.time = next->edges[group].time;
+
+            for(j = group; j < next->edgeCount; j++) {
+                if(next->edges[j].port == edge.port) {
+                    break;
+                }
+            }
+
+            if(j < next->edgeCount) {
+                next->edges[j].mask |= edge.mask;
+                continue;
+            }
+        } else {
+            group = next->edgeCount;
+        }
+
+        next->edges[next->edgeCount++] = edge;
+    }
+
+    pending = true;
+}
+
+void SoftwarePwm::begin() {
+    uint8_t saveSreg;
+
+    commit();
+
+    saveSreg = SREG;
+    cli();
+
+    timer->setNormalMode();
+
+    // first period starts after the minimum gap, with the new schedule
+    nextEdge = __PERIOD_START;
+    periodStart = SOFTPWM_MIN_GAP;
+    timer->setCompareRegister(TIMER_OCR_A, periodStart);
+    timer->setCompareMatchInterrupt(TIMER_OCR_A, onCompare, this);
+
+    SREG = saveSreg;
+}
+
+void SoftwarePwm::end() {
+    uint8_t saveSreg;
+    uint8_t p;
+
+    timer->setCompareMatchInterrupt(TIMER_OCR_A, NULL);
+
+    saveSreg = SREG;
+    cli();
+
+    for(p = 0; p < numPorts; p++) {
+        *ports[p] &= ~portMask[p];
+    }
+
+    SREG = saveSreg;
+}
+
+void SoftwarePwm::onCompare(void *context) {
+    ((SoftwarePwm *)context)->handleCompare();
+}
+
+void SoftwarePwm::handleCompare() {
+    SoftPwmSchedule *schedule;
+    SoftPwmEdge *edge;
+    uint16_t time;
+    uint8_t p;
+
+    if(nextEdge == __PERIOD_START) {
+        if(pending) {
+            active ^= 1;
+            pending = false;
+        }
+
+        schedule = &schedules[active];
+
+        // also clears channels that were on for the whole last period
+        for(p = 0; p < numPorts; p++) {
+            *ports[p] = (*ports[p] & ~portMask[p]) | schedule->setMask[p];
+        }
+
+        nextEdge = 0;
+    } else {
+        schedule = &schedules[active];
+        edge = &schedule->edges[nextEdge];
+        time = edge->time;
+
+        do {
+            *ports[edge->port] &= ~edge->mask;
+            edge++;
+            nextEdge++;
+        } while((nextEdge < schedule->edgeCount) && (edge->time == time));
+    }
+
+    if(nextEdge < schedule->edgeCount) {
+        timer->setCompareRegister(TIMER_OCR_A,
+                periodStart + schedule->edges[nextEdge].time);
+    } else {
+        periodStart += period;
+        nextEdge = __PERIOD_START;
+        timer->setCompareRegister(TIMER_OCR_A, periodStart);
+    }
+}
@@ -0,0 +1,593 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "StaticString.h"
+#include "Print.h"
+#include "NumberParser.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** @brief large enough for any 32-bit value in base 10, plus sign and NUL */
+#define __NUM_BUF_SIZE 12
+
+// assignment //////////////////////////////////////////////////////////////////
+
+void StaticStringBase::clear() {
+    len = 0;
+    buffer[0] = 0;
+}
+
+void StaticStringBase::copy(const char *cstr, unsigned int length) {
+    if(length > cap) {
+        length = cap;
+    }
+
+    // source may be part of this string (e.g., s = s.c_str() + 1)
+    memmove(buffer, cstr, length);
+    len = length;
+    buffer[len] = 0;
+}
+
+StaticStringBase &StaticStringBase::operator=(const StaticStringBase &rhs) {
+    if(this != &rhs) {
+        copy(rhs.buffer, rhs.len);
+    }
+
+    return *this;
+}
+
+StaticStringBase &StaticStringBase::operator=(const String &rhs) {
+    if(rhs.c_str()) {
+        copy(rhs.c_str(), rhs.length());
+    } else {
+        clear();
+    }
+
+    return *this;
+}
+
+StaticStringBase &StaticStringBase::operator=(const char *cstr) {
+    if(cstr) {
+        copy(cstr, strlen(cstr));
+    } else {
+        clear();
+    }
+
+    return *this;
+}
+
+void StaticStringBase::copy(const __FlashStringHelper *pstr, unsigned int length) {
+    if(length > cap) {
+        length = cap;
+    }
+
+    memcpy_P(buffer, (PGM_P)pstr, length);
+    len = length;
+    buffer[len] = 0;
+}
+
+StaticStringBase &StaticStringBase::operator=(const __FlashStringHelper *pstr) {
+    if(pstr) {
+        copy(pstr, strlen_P((PGM_P)pstr));
+    } else {
+        clear();
+    }
+
+    return *this;
+}
+
+unsigned char StaticStringBase::assign(const char *cstr, unsigned int length) {
+    if(!cstr || length > cap) {
+        return 0;
+    }
+
+    copy(cstr, length);
+
+    return 1;
+}
+
+unsigned char StaticStringBase::assign(const StaticStringBase &str) {
+    if(this == &str) {
+        return 1;
+    }
+
+    return assign(str.buffer, str.len);
+}
+
+unsigned char StaticStringBase::assign(const String &str) {
+    return assign(str.c_str(), str.length());
+}
+
+unsigned char StaticStringBase::assign(const char *cstr) {
+    if(!cstr) {
+        return 0;
+    }
+
+    return assign(cstr, strlen(cstr));
+}
+
+unsigned char StaticStringBase::assign(const __FlashStringHelper *pstr) {
+    unsigned int length;
+
+    if(!pstr) {
+        return 0;
+    }
+
+    length = strlen_P((PGM_P)pstr);
+
+    if(length > cap) {
+        return 0;
+    }
+
+    copy(pstr, length);
+
+    return 1;
+}
+
+// concatenation ///////////////////////////////////////////////////////////////
+
+unsigned char StaticStringBase::concat(const char *cstr, unsigned int length) {
+    if(!cstr || length > cap - len) {
+        return 0;
+    }
+
+    memmove(buffer + len, cstr, length);
+    len += length;
+    buffer[len] = 0;
+
+    return 1;
+}
+
+unsigned char StaticStringBase::concat(const StaticStringBase &str) {
+    return concat(str.buffer, str.len);
+}
+
+unsigned char StaticStringBase::concat(const String &str) {
+    return concat(str.c_str(), str.length());
+}
+
+unsigned char StaticStringBase::concat(const char *cstr) {
+    if(!cstr) {
+        return 0;
+    }
+
+    return concat(cstr, strlen(cstr));
+}
+
+unsigned char StaticStringBase::concat(const __FlashStringHelper *pstr) {
+    unsigned int length;
+
+    if(!pstr) {
+        return 0;
+    }
+
+    length = strlen_P((PGM_P)pstr);
+
+    if(length > cap - len) {
+        return 0;
+    }
+
+    memcpy_P(buffer + len, (PGM_P)pstr, length);
+    len += length;
+    buffer[len] = 0;
+
+    return 1;
+}
+
+unsigned char StaticStringBase::concat(char c) {
+    return concat(&c, 1);
+}
+
+unsigned char StaticStringBase::concat(unsigned char num) {
+    char buf[__NUM_BUF_SIZE];
+    utoa(num, buf, 10);
+    return concat(buf);
+}
+
+unsigned char StaticStringBase::concat(int num) {
+    char buf[__NUM_BUF_SIZE];
+    itoa(num, buf, 10);
+    return concat(buf);
+}
+
+unsigned char StaticStringBase::concat(unsigned int num) {
+    char buf[__NUM_BUF_SIZE];
+    utoa(num, buf, 10);
+    return concat(buf);
+}
+
+unsigned char StaticStringBase::concat(long num) {
+    char buf[__NUM_BUF_SIZE];
+    ltoa(num, buf, 10);
+    return concat(buf);
+}
+
+unsigned char StaticStringBase::concat(unsigned long num) {
+    char buf[__NUM_BUF_SIZE];
+    ultoa(num, buf, 10);
+    return concat(buf);
+}
+
+// comparison //////////////////////////////////////////////////////////////////
+
+int StaticStringBase::compareTo(const char *cstr) const {
+    return strcmp(buffer, cstr ? cstr : "");
+}
+
+unsigned char StaticStringBase::equals(const char *cstr, unsigned int length) const {
+    return (length == len) && (memcmp(buffer, cstr, len) == 0);
+}
+
+unsigned char StaticStringBase::equals(const char *cstr) const {
+    if(!cstr) {
+        return len == 0;
+    }
+
+    return strcmp(buffer, cstr) == 0;
+}
+
+unsigned char StaticStringBase::equals(const __FlashStringHelper *pstr) const {
+    if(!pstr) {
+        return len == 0;
+    }
+
+    return strcmp_P(buffer, (PGM_P)pstr) == 0;
+}
+
+unsigned char StaticStringBase::equalsIgnoreCase(const char *cstr) const {
+    if(!cstr) {
+        return len == 0;
+    }
+
+    return strcasecmp(buffer, cstr) == 0;
+}
+
+unsigned char StaticStringBase::startsWith(const char *prefix, unsigned int offset) const {
+    unsigned int n;
+
+    if(!prefix || offset > len) {
+        return 0;
+    }
+
+    n = strlen(prefix);
+
+    return (n <= len - offset) && (strncmp(buffer + offset, prefix, n) == 0);
+}
+
+unsigned char StaticStringBase::startsWith(const __FlashStringHelper *prefix, unsigned int offset) const {
+    PGM_P p = (PGM_P)prefix;
+    const char *s = buffer + offset;
+    char c;
+
+    if(!prefix || offset > len) {
+        return 0;
+    }
+
+    // the terminator ends the walk if the prefix is longer than the string
+    while((c = pgm_read_byte(p++)) != 0) {
+        if(*s++ != c) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+unsigned char StaticStringBase::endsWith(const char *suffix) const {
+    unsigned int n;
+
+    if(!suffix) {
+        return 0;
+    }
+
+    n = strlen(suffix);
+
+    return (n <= len) && (strcmp(buffer + len - n, suffix) == 0);
+}
+
+// character access ////////////////////////////////////////////////////////////
+
+void StaticStringBase::setCharAt(unsigned int index, char c) {
+    if(index < len) {
+        buffer[index] = c;
+    }
+}
+
+char StaticStringBase::operator[](unsigned int index) const {
+    return (index < len) ? buffer[index] : 0;
+}
+
+char &StaticStringBase::operator[](unsigned int index) {
+    static char dummy;
+
+    if(index >= len) {
+        dummy = 0;
+        return dummy;
+    }
+
+    return buffer[index];
+}
+
+void StaticStringBase::getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index) const {
+    unsigned int n;
+
+    if(!bufsize || !buf) {
+        return;
+    }
+
+    if(index >= len) {
+        buf[0] = 0;
+        return;
+    }
+
+    n = bufsize - 1;
+
+    if(n > len - index) {
+        n = len - index;
+    }
+
+    memcpy(buf, buffer + index, n);
+    buf[n] = 0;
+}
+
+// search //////////////////////////////////////////////////////////////////////
+
+int StaticStringBase::indexOf(char ch, unsigned int fromIndex) const {
+    const char *p;
+
+    if(fromIndex >= len) {
+        return -1;
+    }
+
+    p = (const char *)memchr(buffer + fromIndex, ch, len - fromIndex);
+
+    return p ? (int)(p - buffer) : -1;
+}
+
+int StaticStringBase::indexOf(const char *str, unsigned int fromIndex) const {
+    const char *p;
+
+    if(!str || fromIndex >= len) {
+        return -1;
+    }
+
+    p = strstr(buffer + fromIndex, str);
+
+    return p ? (int)(p - buffer) : -1;
+}
+
+int StaticStringBase::indexOf(const __FlashStringHelper *str, unsigned int fromIndex) const {
+    const char *p;
+
+    if(!str || fromIndex >= len) {
+        return -1;
+    }
+
+    p = strstr_P(buffer + fromIndex, (PGM_P)str);
+
+    return p ? (int)(p - buffer) : -1;
+}
+
+int StaticStringBase::lastIndexOf(char ch, unsigned int fromIndex) const {
+    unsigned int i;
+
+    if(fromIndex >= len) {
+        return -1;
+    }
+
+    for(i = fromIndex + 1; i > 0; i--) {
+        if(buffer[i - 1] == ch) {
+            return (int)(i - 1);
+        }
+    }
+
+    return -1;
+}
+
+int StaticStringBase::lastIndexOf(const char *str) const {
+    return lastIndexOf(str, len);
+}
+
+int StaticStringBase::lastIndexOf(const char *str, unsigned int fromIndex) const {
+    unsigned int n;
+    unsigned int i;
+
+    if(!str) {
+        return -1;
+    }
+
+    n = strlen(str);
+
+    if(n == 0 || n > len) {
+        return -1;
+    }
+
+    if(fromIndex > len - n) {
+        fromIndex = len - n;
+    }
+
+    for(i = fromIndex + 1; i > 0; i--) {
+        if(memcmp(buffer + i - 1, str, n) == 0) {
+            return (int)(i - 1);
+        }
+    }
+
+    return -1;
+}
+
+void StaticStringBase::substringTo(StaticStringBase &out, unsigned int left, unsigned int right) const {
+    if(left > right) {
+        unsigned int t = right;
+        right = left;
+        left = t;
+    }
+
+    if(left >= len) {
+        out.clear();
+        return;
+    }
+
+    if(right > len) {
+        right = len;
+    }
+
+    out.copy(buffer + left, right - left);
+}
+
+// modification ////////////////////////////////////////////////////////////////
+
+void StaticStringBase::replace(char find, char replace) {
+    char *p;
+
+    for(p = buffer; *p; p++) {
+        if(*p == find) {
+            *p = replace;
+        }
+    }
+}
+
+unsigned char StaticStringBase::replace(const char *find, const char *replace) {
+    unsigned int findLen, replaceLen, newLen;
+    unsigned int matches = 0;
+    const char *r;
+    char *w;
+    const char *m;
+
+    if(!find || !replace) {
+        return 0;
+    }
+
+    findLen = strlen(find);
+    replaceLen = strlen(replace);
+
+    if(findLen == 0) {
+        return 1;
+    }
+
+    for(r = buffer; (m = strstr(r, find)) != 0; r = m + findLen) {
+        matches++;
+    }
+
+    if(matches == 0) {
+        return 1;
+    }
+
+    if(replaceLen > findLen) {
+        if(matches * (replaceLen - findLen) > cap - len) {
+            return 0;
+        }
+
+        newLen = len + matches * (replaceLen - findLen);
+
+        /*
+         * Move the original to the end of the buffer and rebuild the result
+         * from the start; the write position never overtakes the read
+         * position, so this is done in place.
+         */
+        memmove(buffer + (newLen - len), buffer, len + 1);
+        r = buffer + (newLen - len);
+    } else {
+        newLen = len - matches * (findLen - replaceLen);
+        r = buffer;
+    }
+
+    w = buffer;
+
+    while((m = strstr(r, find)) != 0) {
+        memmove(w, r, m - r);
+        w += m - r;
+        memcpy(w, replace, replaceLen);
+        w += replaceLen;
+        r = m + findLen;
+    }
+
+    memmove(w, r, (buffer + newLen) - w);
+    len = newLen;
+    buffer[len] = 0;
+
+    return 1;
+}
+
+void StaticStringBase::remove(unsigned int index, unsigned int count) {
+    if(index >= len) {
+        return;
+    }
+
+    if(count > len - index) {
+        count = len - index;
+    }
+
+    memmove(buffer + index, buffer + index + count, len - index - count + 1);
+    len -= count;
+}
+
+void StaticStringBase::toLowerCase() {
+    char *p;
+
+    for(p = buffer; *p; p++) {
+        *p = tolower(*p);
+    }
+}
+
+void StaticStringBase::toUpperCase() {
+    char *p;
+
+    for(p = buffer; *p; p++) {
+        *p = toupper(*p);
+    }
+}
+
+void StaticStringBase::trim() {
+    char *begin = buffer;
+    char *end = buffer + len;
+
+    while(begin < end && isspace(*begin)) {
+        begin++;
+    }
+
+    while(end > begin && isspace(*(end - 1))) {
+        end--;
+    }
+
+    len = end - begin;
+    memmove(buffer, begin, len);
+    buffer[len] = 0;
+}
+
+// parsing/conversion //////////////////////////////////////////////////////////
+
+long StaticStringBase::toInt() const {
+    long value;
+
+    parseInt(buffer, len, &value);
+
+    return value;
+}
+
+float StaticStringBase::toFloat() const {
+    float value;
+
+    parseFloat(buffer, len, &value);
+
+    return value;
+}
+
+size_t StaticStringBase::printTo(Print &p) const {
+    return p.write((const uint8_t *)buffer, len);
+}
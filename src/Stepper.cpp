@@ -0,0 +1,358 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Stepper.h"
+
+/**
+ * @brief c[0] times 16 * sqrt(a): 0.676 * sqrt(2) * 16 * f
+ *
+ * Scaled by 16 so c[0] can be taken with an integer square root of a * 256
+ * without losing precision.
+ */
+#define __C0_SCALE ((uint32_t)(STEPPER_TIMER_HZ * 15.2966))
+
+/** @brief Step pulse width, in timer ticks */
+#define __PULSE_TICKS ((uint16_t)(STEPPER_PULSE_US * (STEPPER_TIMER_HZ / 1000000UL)))
+
+/**
+ * @brief Integer square root (rounded down)
+ */
+static uint16_t __isqrt(uint32_t value) {
+    uint32_t result = 0;
+    uint32_t one = 1UL << 30;
+
+    while(one > value) {
+        one >>= 2;
+    }
+
+    while(one != 0) {
+        if(value >= result + one) {
+            value -= result + one;
+            result = (result >> 1) + one;
+        } else {
+            result >>= 1;
+        }
+
+        one >>= 2;
+    }
+
+    return (uint16_t)result;
+}
+
+// StepperAxis ////////////////////////////////////////////////////////////////
+
+StepperAxis::StepperAxis(volatile uint8_t *stepPort, uint8_t stepPin,
+        volatile uint8_t *dirPort, uint8_t dirPin, bool invertDir)
+    : stepPort(stepPort),
+      dirPort(dirPort),
+      stepMask((uint8_t)bit(stepPin)),
+      dirMask((uint8_t)bit(dirPin)),
+      invertDir(invertDir),
+      position(0),
+      direction(1) {
+    // nop
+}
+
+void StepperAxis::begin() {
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+
+    // low, then output (DDRx sits just below PORTx)
+    *stepPort &= ~stepMask;
+    *dirPort &= ~dirMask;
+    *(stepPort - 1) |= stepMask;
+    *(dirPort - 1) |= dirMask;
+
+    SREG = saveSreg;
+}
+
+int32_t StepperAxis::getPosition() {
+    int32_t result;
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+    result = position;
+    SREG = saveSreg;
+
+    return result;
+}
+
+void StepperAxis::setPosition(int32_t position) {
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+    this->position = position;
+    SREG = saveSreg;
+}
+
+void StepperAxis::setDirection(bool forward) {
+    uint8_t saveSreg;
+
+    direction = forward ? 1 : -1;
+
+    saveSreg = SREG;
+    cli();
+
+    if(forward != invertDir) {
+        *dirPort |= dirMask;
+    } else {
+        *dirPort &= ~dirMask;
+    }
+
+    SREG = saveSreg;
+}
+
+// StepperMotion //////////////////////////////////////////////////////////////
+
+StepperMotion::StepperMotion(HardwareTimer *timer)
+    : timer(timer),
+      numAxes(0),
+      maxSpeed(1000),
+      acceleration(1000),
+      minInterval(STEPPER_TIMER_HZ / 1000),
+      state(STEPPER_IDLE),
+      lineSteps(0),
+      totalSteps(0),
+      decelStart(0),
+      stepCount(0),
+      rampStep(0),
+      interval(0),
+      rest(0),
+      nextInterval(0) {
+    // nop
+}
+
+bool StepperMotion::addAxis(StepperAxis *axis) {
+    if((numAxes >= STEPPER_MAX_AXES) || (state != STEPPER_IDLE)) {
+        return false;
+    }
+
+    axis->begin();
+    axes[numAxes++] = axis;
+
+    return true;
+}
+
+void StepperMotion::setMaxSpeed(uint16_t stepsPerSecond) {
+    maxSpeed = (stepsPerSecond > 0) ? stepsPerSecond : 1;
+}
+
+void StepperMotion::setAcceleration(uint16_t stepsPerSecond2) {
+    acceleration = (stepsPerSecond2 > 0) ? stepsPerSecond2 : 1;
+}
+
+bool StepperMotion::move(const int32_t *steps) {
+    uint32_t speed, rampSteps, c0;
+    uint8_t saveSreg;
+    uint8_t i;
+
+    if((state != STEPPER_IDLE) || !timer->isWide()) {
+        return false;
+    }
+
+    lineSteps = 0;
+
+    for(i = 0; i < numAxes; i++) {
+        delta[i] = (steps[i] < 0) ? -steps[i] : steps[i];
+        axes[i]->setDirection(steps[i] >= 0);
+
+        if(delta[i] > lineSteps) {
+            lineSteps = delta[i];
+        }
+    }
+
+    if(lineSteps == 0) {
+        return true;
+    }
+
+    // start every axis half a step into its line, so steps are centered
+    for(i = 0; i < numAxes; i++) {
+        error[i] = lineSteps >> 1;
+    }
+
+    minInterval = STEPPER_TIMER_HZ / maxSpeed;
+
+    if(minInterval < STEPPER_MIN_INTERVAL) {
+        minInterval = STEPPER_MIN_INTERVAL;
+    }
+
+    // steps to reach the (achievable) maximum speed: v^2 / 2a
+    speed = STEPPER_TIMER_HZ / minInterval;
+    rampSteps = (speed * speed) / ((uint32_t)acceleration << 1);
+
+    if(rampSteps > (lineSteps >> 1)) {
+        rampSteps = lineSteps >> 1;
+    }
+
+    c0 = __C0_SCALE / __isqrt((uint32_t)acceleration << 8);
+
+    if(c0 > 0xFFFF) {
+        c0 = 0xFFFF;
+    }
+
+    totalSteps = lineSteps;
+    stepCount = 0;
+    rampStep = 0;
+    rest = 0;
+
+    if(c0 <= minInterval) {
+        // can start (and stop) at full speed
+        interval = minInterval;
+        decelStart = totalSteps;
+        state = STEPPER_RUN;
+    } else {
+        interval = c0;
+        decelStart = totalSteps - rampSteps;
+        state = STEPPER_ACCEL;
+    }
+
+    advance(1);
+
+    timer->setPrescaler(TIMER_PRESCALE_8);
+
+    saveSreg = SREG;
+    cli();
+
+    timer->setCtcMode((uint16_t)interval);
+    timer->setCompareMatchInterrupt(TIMER_OCR_A, onCompare, this);
+
+    SREG = saveSreg;
+
+    return true;
+}
+
+void StepperMotion::stop() {
+    uint32_t total;
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+
+    if((state == STEPPER_ACCEL) || (state == STEPPER_RUN)) {
+        // the next interval is already computed; mirror the ramp after it
+        total = stepCount + 2 + rampStep;
+
+        if(total < totalSteps) {
+            totalSteps = total;
+            decelStart = stepCount + 2;
+        }
+    }
+
+    SREG = saveSreg;
+}
+
+void StepperMotion::halt() {
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+
+    timer->setCompareMatchInterrupt(TIMER_OCR_A, NULL);
+    state = STEPPER_IDLE;
+
+    SREG = saveSreg;
+}
+
+bool StepperMotion::isRunning() {
+    return state != STEPPER_IDLE;
+}
+
+StepperState StepperMotion::getState() {
+    return state;
+}
+
+void StepperMotion::onCompare(void *context) {
+    ((StepperMotion *)context)->handleCompare();
+}
+
+void StepperMotion::handleCompare() {
+    uint8_t i;
+
+    // load the next interval first, while the count is still low (CTC
+    // doesn't buffer OCRnA)
+    timer->setCompareRegister(TIMER_OCR_A, nextInterval);
+
+    for(i = 0; i < numAxes; i++) {
+        error[i] += delta[i];
+
+        if(error[i] >= lineSteps) {
+            error[i] -= lineSteps;
+            axes[i]->stepBegin();
+        }
+    }
+
+    stepCount++;
+
+    if(stepCount >= totalSteps) {
+        timer->setCompareMatchInterrupt(TIMER_OCR_A, NULL);
+        state = STEPPER_IDLE;
+    } else {
+        advance(stepCount + 1);
+    }
+
+    // the count restarted at the step, so it times the pulse
+    while(timer->getCount() < __PULSE_TICKS) {
+        // wait
+    }
+
+    for(i = 0; i < numAxes; i++) {
+        axes[i]->stepEnd();
+    }
+}
+
+void StepperMotion::advance(uint32_t n) {
+    uint32_t num, denom;
+
+    if(n >= totalSteps) {
+        return;
+    }
+
+    if(n >= decelStart) {
+        // c[n] = c[n-1] + 2 * c[n-1] / (4 * remaining - 1)
+        if(state != STEPPER_DECEL) {
+            state = STEPPER_DECEL;
+            rest = 0;
+        }
+
+        denom = ((totalSteps - n) << 2) - 1;
+        num = (interval << 1) + rest;
+        interval += num / denom;
+        rest = num % denom;
+    } else if(state == STEPPER_ACCEL) {
+        // c[n] = c[n-1] - 2 * c[n-1] / (4n + 1)
+        rampStep++;
+        denom = (rampStep << 2) + 1;
+        num = (interval << 1) + rest;
+        interval -= num / denom;
+        rest = num % denom;
+
+        if(interval <= minInterval) {
+            interval = minInterval;
+            rest = 0;
+            state = STEPPER_RUN;
+
+            // decelerate over as many steps as the acceleration took
+            decelStart = totalSteps - rampStep;
+        }
+    }
+
+    nextInterval = (interval > 0xFFFF) ? 0xFFFF : (uint16_t)interval;
+}
@@ -0,0 +1,402 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "StringAllocator.h"
+
+#ifdef __AVR__
+// avr-libc malloc internals, used to find the largest free block
+extern "C" {
+    struct __freelist {
+        size_t sz;
+        struct __freelist *nx;
+    };
+
+    extern struct __freelist *__flp;
+    extern char *__brkval;
+}
+#endif
+
+/** @brief heap statistics (plain data, so valid before constructors run) */
+static StringAllocatorStats __heapStats;
+
+StringHeapAllocator stringHeap;
+
+/**
+ * @brief Statistics bookkeeping
+ */
+static inline void __recordAllocation(StringAllocatorStats &s, size_t size) {
+    s.allocations++;
+    s.inUse += size;
+
+    if(s.inUse > s.peak) {
+        s.peak = s.inUse;
+    }
+}
+
+static inline void __recordRelease(StringAllocatorStats &s, size_t size) {
+    s.inUse -= size;
+}
+
+// StringAllocator /////////////////////////////////////////////////////////////
+
+StringAllocator::StringAllocator() {
+    counters.allocations = 0;
+    counters.failures = 0;
+    counters.inUse = 0;
+    counters.peak = 0;
+}
+
+// StringHeapAllocator /////////////////////////////////////////////////////////
+
+void *StringHeapAllocator::heapAllocate(size_t size) {
+    void *ptr = malloc(size);
+
+    if(ptr) {
+        __recordAllocation(__heapStats, size);
+    } else {
+        __heapStats.failures++;
+    }
+
+    return ptr;
+}
+
+void *StringHeapAllocator::heapReallocate(void *ptr, size_t oldSize, size_t newSize) {
+    void *p = realloc(ptr, newSize);
+
+    if(p) {
+        __recordRelease(__heapStats, oldSize);
+        __recordAllocation(__heapStats, newSize);
+    } else {
+        __heapStats.failures++;
+    }
+
+    return p;
+}
+
+void StringHeapAllocator::heapRelease(void *ptr, size_t size) {
+    if(ptr) {
+        free(ptr);
+        __recordRelease(__heapStats, size);
+    }
+}
+
+void *StringHeapAllocator::allocate(size_t size) {
+    return heapAllocate(size);
+}
+
+void *StringHeapAllocator::reallocate(void *ptr, size_t oldSize, size_t newSize) {
+    return heapReallocate(ptr, oldSize, newSize);
+}
+
+void StringHeapAllocator::release(void *ptr, size_t size) {
+    heapRelease(ptr, size);
+}
+
+size_t StringHeapAllocator::largestFreeBlock() const {
+#ifdef __AVR__
+    struct __freelist *fp;
+    char *top;
+    char *limit;
+    size_t largest = 0;
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+
+    for(fp = __flp; fp; fp = fp->nx) {
+        if(fp->sz > largest) {
+            largest = fp->sz;
+        }
+    }
+
+    // room left between the top of the heap and its limit (or the stack)
+    top = __brkval ? __brkval : __malloc_heap_start;
+    limit = __malloc_heap_end ? __malloc_heap_end : ((char *)SP - __malloc_margin);
+
+    SREG = saveSreg;
+
+    if(limit > top && (size_t)(limit - top) > largest + sizeof(size_t)) {
+        largest = limit - top - sizeof(size_t);
+    }
+
+    return largest;
+#else
+    return 0;
+#endif
+}
+
+const StringAllocatorStats &StringHeapAllocator::stats() const {
+    return __heapStats;
+}
+
+// StringPool //////////////////////////////////////////////////////////////////
+
+StringPool::StringPool(void *memory, size_t size, StringAllocator &parent)
+    : parent(&parent) {
+    size_t share = size / STRING_POOL_CLASSES;
+    size_t avail = 0;
+    size_t blockSize;
+    uint8_t *block;
+    uint8_t i;
+
+    region[0] = (uint8_t *)memory;
+
+    for(i = 0; i < STRING_POOL_CLASSES; i++) {
+        // bytes the previous class couldn't use carry over to this one
+        blockSize = (size_t)STRING_POOL_MIN_BLOCK << i;
+        avail += share;
+        region[i + 1] = region[i] + (avail / blockSize) * blockSize;
+        avail -= region[i + 1] - region[i];
+        freeList[i] = NULL;
+
+        // thread the blocks onto the free list, lowest address first
+        for(block = region[i + 1]; block > region[i]; ) {
+            block -= blockSize;
+            *(void **)block = freeList[i];
+            freeList[i] = block;
+        }
+    }
+}
+
+uint8_t StringPool::classOf(const void *ptr) const {
+    uint8_t i;
+
+    for(i = 0; i < STRING_POOL_CLASSES; i++) {
+        if((const uint8_t *)ptr >= region[i] && (const uint8_t *)ptr < region[i + 1]) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+void *StringPool::allocate(size_t size) {
+    void *block;
+    uint8_t i;
+
+    for(i = 0; i < STRING_POOL_CLASSES; i++) {
+        if(((size_t)STRING_POOL_MIN_BLOCK << i) >= size && freeList[i]) {
+            block = freeList[i];
+            freeList[i] = *(void **)block;
+            __recordAllocation(counters, (size_t)STRING_POOL_MIN_BLOCK << i);
+            return block;
+        }
+    }
+
+    // too large, or no block left that fits
+    block = parent->allocate(size);
+
+    if(!block) {
+        counters.failures++;
+    }
+
+    return block;
+}
+
+void *StringPool::reallocate(void *ptr, size_t oldSize, size_t newSize) {
+    uint8_t c = classOf(ptr);
+    void *p;
+
+    if(!ptr) {
+        return allocate(newSize);
+    }
+
+    if(c == STRING_POOL_CLASSES) {
+        // foreign block; it stays with its owner
+        return parent->reallocate(ptr, oldSize, newSize);
+    }
+
+    if(((size_t)STRING_POOL_MIN_BLOCK << c) >= newSize) {
+        // still fits the block
+        return ptr;
+    }
+
+    p = allocate(newSize);
+
+    if(p) {
+        memcpy(p, ptr, oldSize);
+        release(ptr, oldSize);
+    }
+
+    return p;
+}
+
+void StringPool::release(void *ptr, size_t size) {
+    uint8_t c = classOf(ptr);
+
+    if(!ptr) {
+        return;
+    }
+
+    if(c == STRING_POOL_CLASSES) {
+        parent->release(ptr, size);
+        return;
+    }
+
+    *(void **)ptr = freeList[c];
+    freeList[c] = ptr;
+    __recordRelease(counters, (size_t)STRING_POOL_MIN_BLOCK << c);
+}
+
+size_t StringPool::largestFreeBlock() const {
+    uint8_t i;
+
+    for(i = STRING_POOL_CLASSES; i > 0; i--) {
+        if(freeList[i - 1]) {
+            return (size_t)STRING_POOL_MIN_BLOCK << (i - 1);
+        }
+    }
+
+    return 0;
+}
+
+size_t StringPool::freeBlocks(uint8_t sizeClass) const {
+    size_t count = 0;
+    void *block;
+
+    if(sizeClass < STRING_POOL_CLASSES) {
+        for(block = freeList[sizeClass]; block; block = *(void **)block) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+// StringArena /////////////////////////////////////////////////////////////////
+
+StringArena::StringArena(void *memory, size_t size, StringAllocator &parent)
+    : start((uint8_t *)memory),
+      end((uint8_t *)memory + size),
+      top((uint8_t *)memory),
+      last(NULL),
+      parent(&parent) {
+    // nop
+}
+
+void *StringArena::allocate(size_t size) {
+    if(size > (size_t)(end - top)) {
+        counters.failures++;
+        return NULL;
+    }
+
+    last = top;
+    top += size;
+    __recordAllocation(counters, size);
+
+    return last;
+}
+
+void *StringArena::reallocate(void *ptr, size_t oldSize, size_t newSize) {
+    void *p;
+
+    if(!ptr) {
+        return allocate(newSize);
+    }
+
+    if(!owns(ptr)) {
+        // foreign block; it stays with its owner
+        return parent->reallocate(ptr, oldSize, newSize);
+    }
+
+    if(ptr == last) {
+        // most recent block: resize in place
+        if(newSize > (size_t)(end - last)) {
+            counters.failures++;
+            return NULL;
+        }
+
+        top = last + newSize;
+        __recordRelease(counters, oldSize);
+        __recordAllocation(counters, newSize);
+
+        return ptr;
+    }
+
+    if(newSize <= oldSize) {
+        return ptr;
+    }
+
+    p = allocate(newSize);
+
+    if(p) {
+        memcpy(p, ptr, oldSize);
+        release(ptr, oldSize);
+    }
+
+    return p;
+}
+
+void StringArena::release(void *ptr, size_t size) {
+    if(!ptr) {
+        return;
+    }
+
+    if(!owns(ptr)) {
+        parent->release(ptr, size);
+        return;
+    }
+
+    if(ptr == last) {
+        top = last;
+        last = NULL;
+    }
+
+    __recordRelease(counters, size);
+}
+
+size_t StringArena::largestFreeBlock() const {
+    return end - top;
+}
+
+void StringArena::reset() {
+    top = start;
+    last = NULL;
+    counters.inUse = 0;
+}
+
+// StringArenaScope ////////////////////////////////////////////////////////////
+
+StringArenaScope *StringArenaScope::innermost = NULL;
+
+StringArenaScope::StringArenaScope(StringArena &arena)
+    : arena(&arena),
+      previous(String::getAllocator()),
+      outer(innermost) {
+    innermost = this;
+    String::allocatorScope++;
+    String::setAllocator(&arena);
+}
+
+StringArenaScope::~StringArenaScope() {
+    String::setAllocator(previous);
+    String::allocatorScope--;
+    innermost = outer;
+    arena->reset();
+}
+
+StringAllocator *StringArenaScope::allocatorAt(uint8_t scope) {
+    StringArenaScope *s = innermost;
+    uint8_t depth;
+
+    // each scope holds the allocator of the one enclosing it
+    for(depth = String::allocatorScope; depth > scope + 1; depth--) {
+        s = s->outer;
+    }
+
+    return s->previous;
+}
@@ -0,0 +1,319 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TaskScheduler.h"
+
+/** @brief heapIndex of a task that isn't scheduled */
+#define __NOT_QUEUED 0xFF
+
+/** @brief Whether tick a is before tick b (valid across counter wraps) */
+#define __isBefore(a, b) ((int32_t)((a) - (b)) < 0)
+
+TaskScheduler::TaskScheduler(HardwareTimer *timer)
+    : timer(timer),
+      top(0),
+      numTasks(0),
+      heapSize(0),
+      dueNow(0),
+      ticks(0),
+      pending(0) {
+    // nop
+}
+
+void TaskScheduler::begin() {
+    uint8_t saveSreg;
+
+    top = (SCHEDULER_TIMER_HZ / SCHEDULER_TICK_HZ) - 1;
+
+    saveSreg = SREG;
+    cli();
+
+    ticks = 0;
+    timer->setPrescaler(TIMER_PRESCALE_64);
+    timer->setCtcMode(top);
+    timer->setCompareMatchInterrupt(TIMER_OCR_A, onTick, this);
+
+    SREG = saveSreg;
+}
+
+void TaskScheduler::end() {
+    timer->setCompareMatchInterrupt(TIMER_OCR_A, NULL);
+}
+
+int8_t TaskScheduler::addTask(TaskFunction function, void *context) {
+    Task *t;
+
+    if(numTasks >= SCHEDULER_MAX_TASKS) {
+        return -1;
+    }
+
+    t = &tasks[numTasks];
+    t->function = function;
+    t->context = context;
+    t->due = 0;
+    t->period = 0;
+    t->heapIndex = __NOT_QUEUED;
+
+    memset(&stats[numTasks], 0, sizeof(TaskStats));
+
+    return numTasks++;
+}
+
+void TaskScheduler::schedule(uint8_t task, uint32_t delay, uint32_t period) {
+    if(task >= numTasks) {
+        return;
+    }
+
+    cancel(task);
+
+    tasks[task].due = getTicks() + delay;
+    tasks[task].period = period;
+    heapPush(task);
+}
+
+void TaskScheduler::cancel(uint8_t task) {
+    if(task >= numTasks) {
+        return;
+    }
+
+    // also drop it from the tasks run() has yet to run
+    dueNow &= ~((uint32_t)1 << task);
+
+    if(tasks[task].heapIndex != __NOT_QUEUED) {
+        heapRemove(tasks[task].heapIndex);
+    }
+}
+
+void TaskScheduler::post(uint8_t task) {
+    uint8_t saveSreg;
+
+    if(task >= numTasks) {
+        return;
+    }
+
+    saveSreg = SREG;
+    cli();
+    pending |= (uint32_t)1 << task;
+    SREG = saveSreg;
+}
+
+bool TaskScheduler::run() {
+    uint8_t due[SCHEDULER_MAX_TASKS];
+    uint32_t events, now;
+    uint8_t saveSreg;
+    uint8_t count, i;
+    uint8_t task;
+    Task *t;
+    bool ran = false;
+
+    saveSreg = SREG;
+    cli();
+    events = pending;
+    pending = 0;
+    SREG = saveSreg;
+
+    for(task = 0; events != 0; task++, events >>= 1) {
+        if(events & 1) {
+            execute(task);
+            ran = true;
+        }
+    }
+
+    now = getTicks();
+
+    // take the due tasks off the heap first, so a task scheduled (or
+    // requeued) while they run waits for the next call, even if it is due
+    // already
+    count = 0;
+
+    while((heapSize > 0) && !__isBefore(now, tasks[heap[0]].due)) {
+        task = heap[0];
+        t = &tasks[task];
+
+        heapRemove(0);
+
+        // requeue before running, so the task may reschedule or cancel itself
+        if(t->period != 0) {
+            if(now - t->due >= t->period) {
+                // a period or more late: skip the missed runs
+                if(stats[task].overruns < 0xFFFF) {
+                    stats[task].overruns++;
+                }
+
+                t->due = now + t->period;
+            } else {
+                t->due += t->period;
+            }
+
+            heapPush(task);
+        }
+
+        due[count++] = task;
+        dueNow |= (uint32_t)1 << task;
+    }
+
+    // in due order; a task cancelled (or rescheduled) by an earlier one
+    // doesn't run
+    for(i = 0; i < count; i++) {
+        task = due[i];
+
+        if(dueNow & ((uint32_t)1 << task)) {
+            dueNow &= ~((uint32_t)1 << task);
+            execute(task);
+            ran = true;
+        }
+    }
+
+    return ran;
+}
+
+uint32_t TaskScheduler::getTicks() {
+    uint32_t result;
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+    result = ticks;
+    SREG = saveSreg;
+
+    return result;
+}
+
+const TaskStats *TaskScheduler::getStats(uint8_t task) {
+    return (task < numTasks) ? &stats[task] : NULL;
+}
+
+void TaskScheduler::resetStats() {
+    memset(stats, 0, sizeof(stats));
+}
+
+void TaskScheduler::onTick(void *context) {
+    ((TaskScheduler *)context)->ticks++;
+}
+
+uint32_t TaskScheduler::getTimestamp() {
+    uint32_t tick;
+    uint16_t count;
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+
+    count = timer->getCount();
+    tick = ticks;
+
+    // a tick the ISR hasn't counted yet belongs to a count read after it
+    if(timer->isCompareMatchPending(TIMER_OCR_A) && (count < (top >> 1))) {
+        tick++;
+    }
+
+    SREG = saveSreg;
+
+    return tick * ((uint32_t)top + 1) + count;
+}
+
+void TaskScheduler::execute(uint8_t task) {
+    TaskStats *s = &stats[task];
+    uint32_t start, time;
+
+    start = getTimestamp();
+    tasks[task].function(tasks[task].context);
+    time = getTimestamp() - start;
+
+    if(s->runs < 0xFFFF) {
+        s->runs++;
+    }
+
+    if(time > s->maxTime) {
+        s->maxTime = (time > 0xFFFF) ? 0xFFFF : (uint16_t)time;
+    }
+
+    s->totalTime += time;
+}
+
+// Heap ///////////////////////////////////////////////////////////////////////
+
+void TaskScheduler::heapSet(uint8_t position, uint8_t task) {
+    heap[position] = task;
+    tasks[task].heapIndex = position;
+}
+
+void TaskScheduler::heapPush(uint8_t task) {
+    heapSet(heapSize, task);
+    heapSiftUp(heapSize++);
+}
+
+void TaskScheduler::heapRemove(uint8_t position) {
+    uint8_t task = heap[position];
+
+    tasks[task].heapIndex = __NOT_QUEUED;
+    heapSize--;
+
+    if(position == heapSize) {
+        return;
+    }
+
+    // move the last task into the hole, then restore the order either way
+    heapSet(position, heap[heapSize]);
+    heapSiftUp(position);
+    heapSiftDown(position);
+}
+
+void TaskScheduler::heapSiftUp(uint8_t position) {
+    uint8_t task = heap[position];
+    uint8_t parent;
+
+    while(position > 0) {
+        parent = (position - 1) >> 1;
+
+        if(!__isBefore(tasks[task].due, tasks[heap[parent]].due)) {
+            break;
+        }
+
+        heapSet(position, heap[parent]);
+        position = parent;
+    }
+
+    heapSet(position, task);
+}
+
+void TaskScheduler::heapSiftDown(uint8_t position) {
+    uint8_t task = heap[position];
+    uint8_t child;
+
+    for(;;) {
+        child = (position << 1) + 1;
+
+        if(child >= heapSize) {
+            break;
+        }
+
+        if((child + 1 < heapSize)
+                && __isBefore(tasks[heap[child + 1]].due, tasks[heap[child]].due)) {
+            child++;
+        }
+
+        if(!__isBefore(tasks[heap[child]].due, tasks[task].due)) {
+            break;
+        }
+
+        heapSet(position, heap[child]);
+        position = child;
+    }
+
+    heapSet(position, task);
+}
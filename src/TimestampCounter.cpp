@@ -0,0 +1,71 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TimestampCounter.h"
+
+TimestampCounter::TimestampCounter(HardwareTimer *timer)
+    : timer(timer),
+      overflows(0) {
+    // nop
+}
+
+void TimestampCounter::begin() {
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+
+    overflows = 0;
+    timer->setNormalMode();
+    timer->setOverflowInterrupt(onOverflow, this);
+
+    SREG = saveSreg;
+}
+
+void TimestampCounter::end() {
+    timer->setOverflowInterrupt(NULL);
+}
+
+uint32_t TimestampCounter::now() {
+    uint32_t high;
+    uint16_t low;
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+
+    low = timer->getCount();
+    high = overflows;
+
+    // an overflow the ISR hasn't counted yet belongs to a count read just
+    // after it (a count from the top half was read before it)
+    if(timer->isOverflowPending() && !(low & (timer->isWide() ? 0x8000 : 0x80))) {
+        high++;
+    }
+
+    SREG = saveSreg;
+
+    if(timer->isWide()) {
+        return (high << 16) | low;
+    }
+
+    return (high << 8) | low;
+}
+
+void TimestampCounter::onOverflow(void *context) {
+    ((TimestampCounter *)context)->overflows++;
+}
@@ -0,0 +1,190 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ToneGenerator.h"
+
+/** @brief Number of prescale settings */
+#define __NUM_PRESCALES 5
+
+/** @brief log2 of the prescale values, indexed by TimerPrescaler */
+static const uint8_t __prescaleShift[__NUM_PRESCALES] = { 0, 3, 6, 8, 10 };
+
+ToneGenerator::ToneGenerator(HardwareTimer *timer)
+    : timer(timer),
+      notes(NULL),
+      next(0),
+      repeat(false),
+      playing(false),
+      remaining(0) {
+    // nop
+}
+
+uint32_t ToneGenerator::setFrequency(uint32_t frequency) {
+    uint32_t halfPeriod;
+
+    if(playing) {
+        timer->setCompareMatchInterrupt(TIMER_OCR_A, NULL);
+        playing = false;
+    }
+
+    halfPeriod = configure(frequency, true);
+
+    if(halfPeriod == 0) {
+        stop();
+        return 0;
+    }
+
+    return (F_CPU + halfPeriod) / (halfPeriod << 1);
+}
+
+void ToneGenerator::play(const ToneNote *notes, bool repeat) {
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+
+    this->notes = notes;
+    this->repeat = repeat;
+    next = 0;
+    playing = true;
+
+    nextNote();
+
+    if(playing) {
+        timer->setCompareMatchInterrupt(TIMER_OCR_A, onCompare, this);
+    }
+
+    SREG = saveSreg;
+}
+
+void ToneGenerator::stop() {
+    uint8_t saveSreg;
+
+    saveSreg = SREG;
+    cli();
+
+    timer->setCompareMatchInterrupt(TIMER_OCR_A, NULL);
+    timer->setCompareOutputMode(TIMER_OCR_A, TIMER_OUTPUT_DISCONNECTED);
+    playing = false;
+
+    SREG = saveSreg;
+}
+
+bool ToneGenerator::isPlaying() {
+    return playing;
+}
+
+void ToneGenerator::onCompare(void *context) {
+    ((ToneGenerator *)context)->handleCompare();
+}
+
+void ToneGenerator::handleCompare() {
+    if(--remaining == 0) {
+        nextNote();
+    }
+}
+
+void ToneGenerator::nextNote() {
+    ToneNote note;
+    uint32_t halfPeriod = 0;
+
+    while(halfPeriod == 0) {
+        memcpy_P(&note, &notes[next], sizeof(ToneNote));
+
+        if(note.duration == 0) {
+            if(!repeat || (next == 0)) {
+                stop();
+                return;
+            }
+
+            next = 0;
+            continue;
+        }
+
+        next++;
+
+        if(note.frequency != 0) {
+            halfPeriod = configure(note.frequency, true);
+        }
+
+        // rests, and notes out of range, are silent
+        if(halfPeriod == 0) {
+            halfPeriod = configure(TONE_REST_FREQUENCY, false);
+        }
+    }
+
+    // half periods (compare matches) in the note; at least one
+    remaining = ((uint32_t)note.duration * (F_CPU / 1000)) / halfPeriod;
+
+    if(remaining == 0) {
+        remaining = 1;
+    }
+}
+
+uint32_t ToneGenerator::configure(uint32_t frequency, bool output) {
+    uint32_t period, top, error;
+    uint32_t bestError = 0xFFFFFFFF;
+    uint32_t bestTop = 0;
+    uint32_t maxTop = timer->isWide() ? 0xFFFF : 0xFF;
+    uint8_t bestPrescale = 0;
+    uint8_t i;
+
+    if(frequency == 0) {
+        return 0;
+    }
+
+    // full period in CPU cycles, rounded
+    period = (F_CPU + (frequency >> 1)) / frequency;
+
+    // half period = prescale * (TOP + 1); closest TOP + 1 (top) for each
+    // prescale
+    for(i = 0; i < __NUM_PRESCALES; i++) {
+        top = (period + bit(__prescaleShift[i])) >> (__prescaleShift[i] + 1);
+
+        if(top == 0) {
+            break;
+        }
+
+        if(top - 1 > maxTop) {
+            continue;
+        }
+
+        error = top << (__prescaleShift[i] + 1);
+        error = (error > period) ? (error - period) : (period - error);
+
+        // ties go to the smaller prescale
+        if(error < bestError) {
+            bestError = error;
+            bestTop = top;
+            bestPrescale = i;
+        }
+    }
+
+    if(bestTop == 0) {
+        return 0;
+    }
+
+    timer->setPrescaler((TimerPrescaler)bestPrescale);
+    timer->setCtcMode((uint16_t)(bestTop - 1));
+
+    if(output) {
+        timer->enableOutputs(TIMER_OCR_A);
+        timer->setCompareOutputMode(TIMER_OCR_A, TIMER_OUTPUT_TOGGLE);
+    }
+
+    return bestTop << __prescaleShift[bestPrescale];
+}
@@ -20,6 +20,11 @@
 */
 
 #include "WString.h"
+#include "NumberParser.h"
+#include "StringAllocator.h"
+
+StringAllocator *String::allocator = NULL;
+unsigned char String::allocatorScope = 0;
 
 
 /*********************************************/
@@ -38,6 +43,12 @@ String::String(const String &value)
 	*this = value;
 }
 
+String::String(const __FlashStringHelper *pstr)
+{
+	init();
+	*this = pstr;
+}
+
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
 String::String(String &&rval)
 {
@@ -102,31 +113,24 @@ String::String(unsigned long value, unsigned char base)
 
 String::~String()
 {
-	free(buffer);
+	if (buffer && !isInline()) releaseBuffer(buffer, storage.capacity + 1);
 }
 
 /*********************************************/
 /*  Memory Management                        */
 /*********************************************/
 
-inline void String::init(void)
-{
-	buffer = NULL;
-	capacity = 0;
-	len = 0;
-	flags = 0;
-}
-
 void String::invalidate(void)
 {
-	if (buffer) free(buffer);
+	if (buffer && !isInline()) releaseBuffer(buffer, storage.capacity + 1);
 	buffer = NULL;
-	capacity = len = 0;
+	flags &= ~STRING_FLAG_INLINE;
+	storage.capacity = len = 0;
 }
 
 unsigned char String::reserve(unsigned int size)
 {
-	if (buffer && capacity >= size) return 1;
+	if (buffer && capacity() >= size) return 1;
 	if (changeBuffer(size)) {
 		if (len == 0) buffer[0] = 0;
 		return 1;
@@ -134,12 +138,90 @@ unsigned char String::reserve(unsigned int size)
 	return 0;
 }
 
+unsigned char String::reserveGrowth(unsigned int size)
+{
+	if (buffer && capacity() >= size) return 1;
+	unsigned int cap = buffer ? capacity() : 0;
+	unsigned int slack = cap >> STRING_GROWTH_SHIFT;
+	if (slack > STRING_GROWTH_MAX_SLACK) slack = STRING_GROWTH_MAX_SLACK;
+	if (cap + slack > size && reserve(cap + slack)) return 1;
+	// no headroom wanted, or not enough memory for it: try an exact fit
+	return reserve(size);
+}
+
+unsigned char String::shrinkToFit(void)
+{
+	if (!buffer || isInline() || capacity() == len) return 1;
+	return changeBuffer(len);
+}
+
+// a String created before the innermost StringArenaScope was entered
+// outlives that arena, so it must not take buffers from it: it uses the
+// allocator that was set when it was created
+StringAllocator * String::bufferAllocator(void) const
+{
+	if (scope() >= allocatorScope) return allocator;
+	return StringArenaScope::allocatorAt(scope());
+}
+
+// heap buffers go through the String's allocator, or straight to the heap
+// when none is set (which also works before any constructors have run)
+char * String::allocateBuffer(unsigned int size) const
+{
+	StringAllocator *alloc = bufferAllocator();
+	if (alloc) return (char *)alloc->allocate(size);
+	return (char *)StringHeapAllocator::heapAllocate(size);
+}
+
+char * String::reallocateBuffer(char *ptr, unsigned int oldSize, unsigned int newSize) const
+{
+	StringAllocator *alloc = bufferAllocator();
+	if (alloc) return (char *)alloc->reallocate(ptr, oldSize, newSize);
+	return (char *)StringHeapAllocator::heapReallocate(ptr, oldSize, newSize);
+}
+
+void String::releaseBuffer(char *ptr, unsigned int size) const
+{
+	StringAllocator *alloc = bufferAllocator();
+	if (alloc) alloc->release(ptr, size);
+	else StringHeapAllocator::heapRelease(ptr, size);
+}
+
 unsigned char String::changeBuffer(unsigned int maxStrLen)
 {
-	char *newbuffer = (char *)realloc(buffer, maxStrLen + 1);
+	if (maxStrLen < STRING_SSO_SIZE) {
+		// fits inline; only move there if the current value does too
+		if (isInline()) return 1;
+		if (!buffer || len <= maxStrLen) {
+			char *oldbuffer = buffer;
+			if (oldbuffer) {
+				// the inline array overlays the capacity
+				unsigned int oldsize = storage.capacity + 1;
+				memcpy(storage.sso, oldbuffer, len);
+				storage.sso[len] = 0;
+				releaseBuffer(oldbuffer, oldsize);
+			}
+			buffer = storage.sso;
+			flags |= STRING_FLAG_INLINE;
+			return 1;
+		}
+	}
+	if (isInline()) {
+		// moving from the inline array to the heap
+		char *newbuffer = allocateBuffer(maxStrLen + 1);
+		if (newbuffer) {
+			memcpy(newbuffer, buffer, len + 1);
+			buffer = newbuffer;
+			flags &= ~STRING_FLAG_INLINE;
+			storage.capacity = maxStrLen;
+			return 1;
+		}
+		return 0;
+	}
+	char *newbuffer = reallocateBuffer(buffer, buffer ? storage.capacity + 1 : 0, maxStrLen + 1);
 	if (newbuffer) {
 		buffer = newbuffer;
-		capacity = maxStrLen;
+		storage.capacity = maxStrLen;
 		return 1;
 	}
 	return 0;
@@ -156,31 +238,59 @@ String & String::copy(const char *cstr, unsigned int length)
 		return *this;
 	}
 	len = length;
-	strcpy(buffer, cstr);
+	// the source may be part of our own value, e.g. s = s.c_str() + 1
+	memmove(buffer, cstr, length);
+	buffer[len] = 0;
+	return *this;
+}
+
+String & String::copy(const __FlashStringHelper *pstr, unsigned int length)
+{
+	if (!reserve(length)) {
+		invalidate();
+		return *this;
+	}
+	len = length;
+	memcpy_P(buffer, (PGM_P)pstr, length);
+	buffer[len] = 0;
 	return *this;
 }
 
-#ifdef __GXX_EXPERIMENTAL_CXX0X__
 void String::move(String &rhs)
 {
+	if (rhs.buffer && !rhs.isInline() && rhs.scope() != scope()) {
+		// the buffer belongs to another arena scope's allocator, which may
+		// be reset while we still exist; copy the value instead
+		copy(rhs.buffer, rhs.len);
+		return;
+	}
 	if (buffer) {
-		if (capacity >= rhs.len) {
-			strcpy(buffer, rhs.buffer);
+		if (capacity() >= rhs.len) {
+			memcpy(buffer, rhs.buffer, rhs.len + 1);
 			len = rhs.len;
 			rhs.len = 0;
 			return;
-		} else {
-			free(buffer);
+		} else if (!isInline()) {
+			releaseBuffer(buffer, storage.capacity + 1);
 		}
 	}
+	if (rhs.isInline()) {
+		// an inline value can't be stolen; copy it into our own array
+		memcpy(storage.sso, rhs.buffer, rhs.len + 1);
+		buffer = storage.sso;
+		flags |= STRING_FLAG_INLINE;
+		len = rhs.len;
+		rhs.len = 0;
+		return;
+	}
 	buffer = rhs.buffer;
-	capacity = rhs.capacity;
+	flags &= ~STRING_FLAG_INLINE;
+	storage.capacity = rhs.storage.capacity;
 	len = rhs.len;
 	rhs.buffer = NULL;
-	rhs.capacity = 0;
+	rhs.storage.capacity = 0;
 	rhs.len = 0;
 }
-#endif
 
 String & String::operator = (const String &rhs)
 {
@@ -214,6 +324,14 @@ String & String::operator = (const char *cstr)
 	return *this;
 }
 
+String & String::operator = (const __FlashStringHelper *pstr)
+{
+	if (pstr) copy(pstr, strlen_P((PGM_P)pstr));
+	else invalidate();
+
+	return *this;
+}
+
 /*********************************************/
 /*  concat                                   */
 /*********************************************/
@@ -228,9 +346,20 @@ unsigned char String::concat(const char *cstr, unsigned int length)
 	unsigned int newlen = len + length;
 	if (!cstr) return 0;
 	if (length == 0) return 1;
-	if (!reserve(newlen)) return 0;
-	strcpy(buffer + len, cstr);
+	if (!buffer || capacity() < newlen) {
+		// growing may move our buffer, which the source can be part of
+		// (e.g. s += s)
+		if (buffer && cstr >= buffer && cstr <= buffer + len) {
+			unsigned int offset = cstr - buffer;
+			if (!reserveGrowth(newlen)) return 0;
+			cstr = buffer + offset;
+		} else if (!reserveGrowth(newlen)) {
+			return 0;
+		}
+	}
+	memcpy(buffer + len, cstr, length);
 	len = newlen;
+	buffer[len] = 0;
 	return 1;
 }
 
@@ -240,6 +369,19 @@ unsigned char String::concat(const char *cstr)
 	return concat(cstr, strlen(cstr));
 }
 
+unsigned char String::concat(const __FlashStringHelper *pstr)
+{
+	if (!pstr) return 0;
+	unsigned int length = strlen_P((PGM_P)pstr);
+	if (length == 0) return 1;
+	unsigned int newlen = len + length;
+	if (!reserveGrowth(newlen)) return 0;
+	memcpy_P(buffer + len, (PGM_P)pstr, length);
+	len = newlen;
+	buffer[len] = 0;
+	return 1;
+}
+
 unsigned char String::concat(char c)
 {
 	char buf[2];
@@ -283,66 +425,6 @@ unsigned char String::concat(unsigned long num)
 	return concat(buf, strlen(buf));
 }
 
-/*********************************************/
-/*  Concatenate                              */
-/*********************************************/
-
-StringSumHelper & operator + (const StringSumHelper &lhs, const String &rhs)
-{
-	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-	if (!a.concat(rhs.buffer, rhs.len)) a.invalidate();
-	return a;
-}
-
-StringSumHelper & operator + (const StringSumHelper &lhs, const char *cstr)
-{
-	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-	if (!cstr || !a.concat(cstr, strlen(cstr))) a.invalidate();
-	return a;
-}
-
-StringSumHelper & operator + (const StringSumHelper &lhs, char c)
-{
-	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-	if (!a.concat(c)) a.invalidate();
-	return a;
-}
-
-StringSumHelper & operator + (const StringSumHelper &lhs, unsigned char num)
-{
-	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-	if (!a.concat(num)) a.invalidate();
-	return a;
-}
-
-StringSumHelper & operator + (const StringSumHelper &lhs, int num)
-{
-	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-	if (!a.concat(num)) a.invalidate();
-	return a;
-}
-
-StringSumHelper & operator + (const StringSumHelper &lhs, unsigned int num)
-{
-	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-	if (!a.concat(num)) a.invalidate();
-	return a;
-}
-
-StringSumHelper & operator + (const StringSumHelper &lhs, long num)
-{
-	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-	if (!a.concat(num)) a.invalidate();
-	return a;
-}
-
-StringSumHelper & operator + (const StringSumHelper &lhs, unsigned long num)
-{
-	StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-	if (!a.concat(num)) a.invalidate();
-	return a;
-}
-
 /*********************************************/
 /*  Comparison                               */
 /*********************************************/
@@ -369,6 +451,13 @@ unsigned char String::equals(const char *cstr) const
 	return strcmp(buffer, cstr) == 0;
 }
 
+unsigned char String::equals(const __FlashStringHelper *pstr) const
+{
+	if (len == 0) return (pstr == NULL || pgm_read_byte((PGM_P)pstr) == 0);
+	if (pstr == NULL) return buffer[0] == 0;
+	return strcmp_P(buffer, (PGM_P)pstr) == 0;
+}
+
 unsigned char String::operator<(const String &rhs) const
 {
 	return compareTo(rhs) < 0;
@@ -414,6 +503,25 @@ unsigned char String::startsWith( const String &s2, unsigned int offset ) const
 	return strncmp( &buffer[offset], s2.buffer, s2.len ) == 0;
 }
 
+unsigned char String::startsWith( const __FlashStringHelper *prefix ) const
+{
+	return startsWith(prefix, 0);
+}
+
+unsigned char String::startsWith( const __FlashStringHelper *prefix, unsigned int offset ) const
+{
+	if (offset > len || !buffer || !prefix) return 0;
+	// walk the prefix once instead of taking its length first; our
+	// terminator ends the loop if the prefix is longer than we are
+	PGM_P p = (PGM_P)prefix;
+	const char *s = buffer + offset;
+	char c;
+	while ((c = pgm_read_byte(p++)) != 0) {
+		if (*s++ != c) return 0;
+	}
+	return 1;
+}
+
 unsigned char String::endsWith( const String &s2 ) const
 {
 	if ( len < s2.len || !buffer || !s2.buffer) return 0;
@@ -493,6 +601,19 @@ int String::indexOf(const String &s2, unsigned int fromIndex) const
 	return found - buffer;
 }
 
+int String::indexOf(const __FlashStringHelper *str) const
+{
+	return indexOf(str, 0);
+}
+
+int String::indexOf(const __FlashStringHelper *str, unsigned int fromIndex) const
+{
+	if (fromIndex >= len || !str) return -1;
+	const char *found = strstr_P(buffer + fromIndex, (PGM_P)str);
+	if (found == NULL) return -1;
+	return found - buffer;
+}
+
 int String::lastIndexOf( char theChar ) const
 {
 	return lastIndexOf(theChar, len - 1);
@@ -501,12 +622,10 @@ int String::lastIndexOf( char theChar ) const
 int String::lastIndexOf(char ch, unsigned int fromIndex) const
 {
 	if (fromIndex >= len) return -1;
-	char tempchar = buffer[fromIndex + 1];
-	buffer[fromIndex + 1] = '\0';
-	char* temp = strrchr( buffer, ch );
-	buffer[fromIndex + 1] = tempchar;
-	if (temp == NULL) return -1;
-	return temp - buffer;
+	for (unsigned int i = fromIndex + 1; i > 0; i--) {
+		if (buffer[i - 1] == ch) return i - 1;
+	}
+	return -1;
 }
 
 int String::lastIndexOf(const String &s2) const
@@ -516,15 +635,15 @@ int String::lastIndexOf(const String &s2) const
 
 int String::lastIndexOf(const String &s2, unsigned int fromIndex) const
 {
-  	if (s2.len == 0 || len == 0 || s2.len > len) return -1;
-	if (fromIndex >= len) fromIndex = len - 1;
-	int found = -1;
-	for (char *p = buffer; p <= buffer + fromIndex; p++) {
-		p = strstr(p, s2.buffer);
-		if (!p) break;
-		if ((unsigned int)(p - buffer) <= fromIndex) found = p - buffer;
+	if (s2.len == 0 || len == 0 || s2.len > len) return -1;
+	if (fromIndex > len - s2.len) fromIndex = len - s2.len;
+	// only compare the rest where the first character matches
+	char first = s2.buffer[0];
+	for (unsigned int i = fromIndex + 1; i > 0; i--) {
+		if (buffer[i - 1] == first && memcmp(buffer + i, s2.buffer + 1, s2.len - 1) == 0)
+			return i - 1;
 	}
-	return found;
+	return -1;
 }
 
 String String::substring( unsigned int left ) const
@@ -542,10 +661,7 @@ String String::substring(unsigned int left, unsigned int right) const
 	String out;
 	if (left > len) return out;
 	if (right > len) right = len;
-	char temp = buffer[right];  // save the replaced character
-	buffer[right] = '\0';	
-	out = buffer + left;  // pointer arithmetic
-	buffer[right] = temp;  //restore character
+	out.copy(buffer + left, right - left);
 	return out;
 }
 
@@ -573,17 +689,21 @@ void String::replace(const String& find, const String& replace)
 			readFrom = foundAt + replace.len;
 		}
 	} else if (diff < 0) {
-		char *writeTo = buffer;
+		char *writeTo = NULL;
 		while ((foundAt = strstr(readFrom, find.buffer)) != NULL) {
-			unsigned int n = foundAt - readFrom;
-			memcpy(writeTo, readFrom, n);
-			writeTo += n;
+			if (writeTo) {
+				unsigned int n = foundAt - readFrom;
+				memmove(writeTo, readFrom, n);
+				writeTo += n;
+			} else {
+				writeTo = foundAt; // nothing before the first match moves
+			}
 			memcpy(writeTo, replace.buffer, replace.len);
 			writeTo += replace.len;
 			readFrom = foundAt + find.len;
 			len += diff;
 		}
-		strcpy(writeTo, readFrom);
+		if (writeTo) memmove(writeTo, readFrom, buffer + len + 1 - writeTo);
 	} else {
 		unsigned int size = len; // compute size needed for result
 		while ((foundAt = strstr(readFrom, find.buffer)) != NULL) {
@@ -591,16 +711,22 @@ void String::replace(const String& find, const String& replace)
 			size += diff;
 		}
 		if (size == len) return;
-		if (size > capacity && !changeBuffer(size)) return; // XXX: tell user!
-		int index = len - 1;
-		while (index >= 0 && (index = lastIndexOf(find, index)) >= 0) {
-			readFrom = buffer + index + find.len;
-			memmove(readFrom + diff, readFrom, len - (readFrom - buffer));
-			len += diff;
-			buffer[len] = 0;
-			memcpy(buffer + index, replace.buffer, replace.len);
-			index--;
+		if (size > capacity() && !changeBuffer(size)) return; // XXX: tell user!
+		// move the original to the end of the buffer and rebuild the result
+		// from the front in a single pass; the write position never overtakes
+		// the read position, and meets it (tail in place) after the last match
+		memmove(buffer + size - len, buffer, len + 1);
+		readFrom = buffer + size - len;
+		char *writeTo = buffer;
+		while ((foundAt = strstr(readFrom, find.buffer)) != NULL) {
+			unsigned int n = foundAt - readFrom;
+			memmove(writeTo, readFrom, n);
+			writeTo += n;
+			memcpy(writeTo, replace.buffer, replace.len);
+			writeTo += replace.len;
+			readFrom = foundAt + find.len;
 		}
+		len = size;
 	}
 }
 
@@ -638,8 +764,16 @@ void String::trim(void)
 
 long String::toInt(void) const
 {
-	if (buffer) return atol(buffer);
-	return 0;
+	long value;
+	parseInt(buffer, len, &value);
+	return value;
+}
+
+float String::toFloat(void) const
+{
+	float value;
+	parseFloat(buffer, len, &value);
+	return value;
 }
 
 
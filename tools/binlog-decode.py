@@ -0,0 +1,206 @@
+#!/usr/bin/env python3
+#
+# This file is part of LL-AVR
+#
+# LL-AVR is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published
+# by the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# LL-AVR is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+
+"""
+Decode a BinaryLog record stream back into text.
+
+Message ids are flash addresses of F() strings; they are resolved against the
+loadable sections of the firmware ELF the stream was produced by. Argument
+bytes are split and formatted using the printf-style conversions found in each
+message string, using AVR type sizes (int is 2 bytes, long is 4 bytes).
+
+Usage:
+    stty -F /dev/ttyACM0 115200 raw
+    tools/binlog-decode.py firmware.elf < /dev/ttyACM0
+    tools/binlog-decode.py firmware.elf capture.bin --ts-bytes 2
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+SYNC = 0xA5
+
+# conversion regex: flags, width, precision, length modifier, conversion
+CONV_RE = re.compile(r'%([-+ #0]*)(\d*)(\.\d+)?(hh|h|ll|l)?([diouxXcsfFeEgGp%])')
+
+
+class Elf(object):
+    """Minimal ELF32 little-endian reader (enough for avr-gcc output)."""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+
+        if self.data[:4] != b'\x7fELF' or self.data[4] != 1 or self.data[5] != 1:
+            raise ValueError('%s: not a 32-bit little-endian ELF file' % path)
+
+        (shoff,) = struct.unpack_from('<I', self.data, 0x20)
+        shentsize, shnum = struct.unpack_from('<HH', self.data, 0x2E)
+
+        self.sections = []
+        for i in range(shnum):
+            (name, stype, flags, addr, offset, size) = struct.unpack_from(
+                '<IIIIII', self.data, shoff + i * shentsize)
+
+            # SHT_PROGBITS and SHF_ALLOC: bytes that end up in the device
+            if stype == 1 and (flags & 0x2) and size > 0:
+                self.sections.append((addr, offset, size))
+
+    def string_at(self, addr):
+        for (base, offset, size) in self.sections:
+            if base <= addr < base + size:
+                start = offset + (addr - base)
+                end = self.data.index(b'\0', start, offset + size)
+                return self.data[start:end].decode('latin-1')
+        return None
+
+
+def arg_size(length, conv):
+    if conv in 'cs':
+        return 1 if conv == 'c' else None
+    if conv in 'fFeEgG':
+        return 4        # double == float on AVR
+    if conv == 'p':
+        return 2
+    return {'hh': 1, 'h': 2, 'l': 4, 'll': 8}.get(length, 2)
+
+
+def format_message(fmt, args):
+    out = []
+    pos = 0
+    last = 0
+
+    for m in CONV_RE.finditer(fmt):
+        out.append(fmt[last:m.start()])
+        last = m.end()
+        flags, width, prec, length, conv = m.groups()
+
+        if conv == '%':
+            out.append('%')
+            continue
+
+        size = arg_size(length, conv)
+        if size is None or pos + size > len(args):
+            return None
+
+        raw = args[pos:pos + size]
+        pos += size
+        spec = '%' + flags + width + (prec or '')
+
+        if conv in 'fFeEgG':
+            out.append((spec + conv) % struct.unpack('<f', raw)[0])
+        elif conv == 'c':
+            out.append((spec + 'c') % chr(raw[0]))
+        elif conv == 'p':
+            out.append((spec + '#06x') % int.from_bytes(raw, 'little'))
+        else:
+            signed = conv in 'di'
+            value = int.from_bytes(raw, 'little', signed=signed)
+            out.append((spec + ('d' if conv == 'i' else conv)) % value)
+
+    out.append(fmt[last:])
+
+    if pos != len(args):
+        return None
+
+    return ''.join(out)
+
+
+def records(stream, ts_bytes):
+    """Yield (id, timestamp, args) for each valid record, resyncing on error."""
+    buf = bytearray()
+
+    while True:
+        # read1() returns whatever has arrived, so records from a live serial
+        # pipe are decoded as they come rather than 256 bytes at a time
+        chunk = stream.read1(256)
+        if not chunk:
+            return
+        buf.extend(chunk)
+
+        while True:
+            start = buf.find(bytes([SYNC]))
+            if start < 0:
+                del buf[:]
+                break
+            del buf[:start]
+
+            if len(buf) < 2:
+                break
+
+            n = buf[1]
+            if n < 2 + ts_bytes:
+                del buf[:1]
+                continue
+
+            if len(buf) < n + 3:
+                break
+
+            body = buf[2:2 + n]
+            check = buf[1]
+            for b in body:
+                check ^= b
+
+            if check != buf[2 + n]:
+                # not a record boundary; look for the next sync byte
+                del buf[:1]
+                continue
+
+            del buf[:n + 3]
+
+            msg_id = body[0] | (body[1] << 8)
+            ts = int.from_bytes(body[2:2 + ts_bytes], 'little')
+            yield (msg_id, ts, bytes(body[2 + ts_bytes:]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('elf', help='firmware ELF the log was produced by')
+    parser.add_argument('input', nargs='?', help='captured stream (default: stdin)')
+    parser.add_argument('--ts-bytes', type=int, default=4, choices=(0, 1, 2, 4),
+                        help='BINLOG_TIMESTAMP_BYTES the firmware was built with')
+    opts = parser.parse_args()
+
+    elf = Elf(opts.elf)
+    stream = open(opts.input, 'rb') if opts.input else sys.stdin.buffer
+    cache = {}
+
+    for (msg_id, ts, args) in records(stream, opts.ts_bytes):
+        if msg_id not in cache:
+            cache[msg_id] = elf.string_at(msg_id)
+        fmt = cache[msg_id]
+
+        text = None
+        if fmt is not None:
+            text = format_message(fmt, args)
+
+        if text is None:
+            text = '<id 0x%04x%s> %s' % (msg_id,
+                                         '' if fmt is None else ' "%s"' % fmt,
+                                         args.hex())
+
+        if opts.ts_bytes:
+            sys.stdout.write('[%10d] %s\n' % (ts, text))
+        else:
+            sys.stdout.write('%s\n' % text)
+        sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()
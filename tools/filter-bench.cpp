@@ -0,0 +1,251 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host benchmark of the fixed-point sample filters against float
+ * equivalents: reports time per sample and the largest deviation of the
+ * fixed-point output from the float output, for a noisy 10-bit ADC-like
+ * signal.
+ *
+ * Build and run from the repository root:
+ *
+ *   g++ -O2 -Iinclude tools/filter-bench.cpp src/SampleFilter.cpp \
+ *       -o filter-bench && ./filter-bench
+ *
+ * NOTE: Host timings only show the relative cost of the integer and float
+ *   paths; on AVR (no FPU) the gap is much larger, since each float multiply
+ *   is a ~100 cycle library call.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "SampleFilter.h"
+
+#define SAMPLES     200000
+#define ROUNDS      20
+
+static int16_t input[SAMPLES];
+static int16_t fixedOut[SAMPLES];
+static float floatOut[SAMPLES];
+
+/**
+ * @brief Float reference filters
+ */
+class FloatOnePole {
+public:
+    FloatOnePole(float alpha) : alpha(alpha), y(0.0F), primed(false) {
+        // nop
+    }
+
+    float process(float x) {
+        if(!primed) {
+            y = x;
+            primed = true;
+        } else {
+            y += alpha * (x - y);
+        }
+
+        return y;
+    }
+
+private:
+    float alpha, y;
+    bool primed;
+};
+
+class FloatBiquad {
+public:
+    FloatBiquad(float b0, float b1, float b2, float a1, float a2)
+        : b0(b0), b1(b1), b2(b2), a1(a1), a2(a2),
+          x1(0), x2(0), y1(0), y2(0) {
+        // nop
+    }
+
+    float process(float x) {
+        float y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+
+        return y;
+    }
+
+private:
+    float b0, b1, b2, a1, a2;
+    float x1, x2, y1, y2;
+};
+
+class FloatMovingAverage {
+public:
+    FloatMovingAverage() : index(0), count(0) {
+        // nop
+    }
+
+    float process(float x) {
+        float sum = 0.0F;
+        int i;
+
+        window[index] = x;
+        index = (index + 1) % 16;
+
+        if(count < 16) {
+            count++;
+        }
+
+        for(i = 0; i < count; i++) {
+            sum += window[i];
+        }
+
+        return sum / count;
+    }
+
+private:
+    float window[16];
+    int index, count;
+};
+
+/**
+ * @brief Make a slow sine plus noise and occasional spikes, in 0..1023
+ */
+static void __makeInput() {
+    int i;
+    float v;
+
+    srand(1);
+
+    for(i = 0; i < SAMPLES; i++) {
+        v = 512.0F + 300.0F * sinf(i * 0.002F) + (float)(rand() % 41 - 20);
+
+        if(rand() % 500 == 0) {
+            v += 300.0F;
+        }
+
+        input[i] = (int16_t)(v < 0.0F ? 0.0F : (v > 1023.0F ? 1023.0F : v));
+    }
+}
+
+static double __elapsedNs(clock_t start) {
+    return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / ((double)SAMPLES * ROUNDS);
+}
+
+static float __maxError(int skip) {
+    float worst = 0.0F;
+    int i;
+
+    for(i = skip; i < SAMPLES; i++) {
+        if(fabsf(fixedOut[i] - floatOut[i]) > worst) {
+            worst = fabsf(fixedOut[i] - floatOut[i]);
+        }
+    }
+
+    return worst;
+}
+
+static void __report(const char *name, double fixedNs, double floatNs, float error) {
+    printf("%-16s fixed %6.2f ns  float %6.2f ns  max |error| %.2f LSB\n",
+            name, fixedNs, floatNs, error);
+}
+
+int main() {
+    BiquadCoefficients c = BiquadFilter::lowPass(0.01F);
+    double fixedNs, floatNs;
+    clock_t start;
+    int r, i;
+
+    __makeInput();
+
+    // one-pole
+    start = clock();
+    for(r = 0; r < ROUNDS; r++) {
+        OnePoleFilter f(Q15(0.05));
+        for(i = 0; i < SAMPLES; i++) {
+            fixedOut[i] = f.process(input[i]);
+        }
+    }
+    fixedNs = __elapsedNs(start);
+
+    start = clock();
+    for(r = 0; r < ROUNDS; r++) {
+        FloatOnePole f(0.05F);
+        for(i = 0; i < SAMPLES; i++) {
+            floatOut[i] = f.process(input[i]);
+        }
+    }
+    floatNs = __elapsedNs(start);
+    __report("one-pole", fixedNs, floatNs, __maxError(0));
+
+    // biquad low-pass, compared against the float filter with the same
+    // (quantized) coefficients
+    start = clock();
+    for(r = 0; r < ROUNDS; r++) {
+        BiquadFilter f(c);
+        for(i = 0; i < SAMPLES; i++) {
+            fixedOut[i] = f.process(input[i]);
+        }
+    }
+    fixedNs = __elapsedNs(start);
+
+    start = clock();
+    for(r = 0; r < ROUNDS; r++) {
+        FloatBiquad f(c.b0 / 16384.0F, c.b1 / 16384.0F, c.b2 / 16384.0F,
+                c.a1 / 16384.0F, c.a2 / 16384.0F);
+        for(i = 0; i < SAMPLES; i++) {
+            floatOut[i] = f.process(input[i]);
+        }
+    }
+    floatNs = __elapsedNs(start);
+    __report("biquad", fixedNs, floatNs, __maxError(0));
+
+    // moving average; the float version re-sums its window, as the main
+    // loop code it replaces did
+    start = clock();
+    for(r = 0; r < ROUNDS; r++) {
+        MovingAverageFilter<16> f;
+        for(i = 0; i < SAMPLES; i++) {
+            fixedOut[i] = f.process(input[i]);
+        }
+    }
+    fixedNs = __elapsedNs(start);
+
+    start = clock();
+    for(r = 0; r < ROUNDS; r++) {
+        FloatMovingAverage f;
+        for(i = 0; i < SAMPLES; i++) {
+            floatOut[i] = f.process(input[i]);
+        }
+    }
+    floatNs = __elapsedNs(start);
+    __report("moving average", fixedNs, floatNs, __maxError(0));
+
+    // median (no float equivalent; timing only)
+    start = clock();
+    for(r = 0; r < ROUNDS; r++) {
+        MedianFilter<5> f;
+        for(i = 0; i < SAMPLES; i++) {
+            fixedOut[i] = f.process(input[i]);
+        }
+    }
+    fixedNs = __elapsedNs(start);
+    printf("%-16s fixed %6.2f ns\n", "median-of-5", fixedNs);
+
+    return 0;
+}
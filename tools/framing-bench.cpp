@@ -0,0 +1,147 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host benchmark of COBS and SLIP framing with CRC-16: encodes and decodes
+ * frames of typical telemetry/command sizes, checks that every frame comes
+ * back intact, and reports the payload throughput and the wire overhead.
+ *
+ * Build and run from the repository root:
+ *
+ *   g++ -O2 -Iinclude -Itools/host tools/framing-bench.cpp \
+ *       src/PacketFraming.cpp src/Crc.cpp src/Print.cpp src/WString.cpp \
+ *       src/NumberParser.cpp src/StringAllocator.cpp -o framing-bench \
+ *       && ./framing-bench
+ *
+ * NOTE: Host throughput only shows the relative cost of the two encodings
+ *   and of the CRC; on AVR the CRC implementation (see Crc.h) dominates.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "PacketFraming.h"
+
+#define FRAMES      20000
+#define MAX_FRAME   256
+
+/**
+ * @brief Print that collects the encoded frame in memory
+ */
+class FrameSink : public Print {
+public:
+    FrameSink() : length(0) {
+        // nop
+    }
+
+    virtual size_t write(uint8_t c) {
+        data[length++] = c;
+        return 1;
+    }
+
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        memcpy(&data[length], buffer, size);
+        length += size;
+        return size;
+    }
+
+    using Print::write;
+
+    uint8_t data[2 * MAX_FRAME + 8];
+    size_t length;
+};
+
+static uint8_t payloads[FRAMES][MAX_FRAME];
+
+/**
+ * @brief Fill the payloads with sensor-like data: small integers (with many
+ *   zero bytes) mixed with random bytes, which also hit the SLIP escapes
+ */
+static void __makePayloads() {
+    int f, i;
+
+    srand(1);
+
+    for(f = 0; f < FRAMES; f++) {
+        for(i = 0; i < MAX_FRAME; i++) {
+            payloads[f][i] = (i & 1) ? (uint8_t)rand() : (uint8_t)(rand() % 4);
+        }
+    }
+}
+
+/**
+ * @brief Encode and decode every payload with the given size
+ *
+ * @return false if a frame didn't decode back to its payload
+ */
+template<typename ENCODER, typename DECODER>
+static bool __run(const char *name, size_t size) {
+    static uint8_t buffer[MAX_FRAME + 2];
+    unsigned long wire = 0;
+    FrameStatus status;
+    clock_t start;
+    double seconds;
+    size_t i;
+    int f;
+
+    start = clock();
+
+    for(f = 0; f < FRAMES; f++) {
+        FrameSink sink;
+        ENCODER encoder(sink);
+        DECODER decoder(buffer, sizeof(buffer));
+
+        encoder.writeFrame(payloads[f], size);
+        wire += sink.length;
+
+        status = FRAME_PENDING;
+        for(i = 0; i < sink.length && status == FRAME_PENDING; i++) {
+            status = decoder.decode(sink.data[i]);
+        }
+
+        if(status != FRAME_OK || decoder.length() != size
+                || memcmp(decoder.data(), payloads[f], size) != 0) {
+            printf("%s: frame %d of %u bytes failed (status %d)\n",
+                    name, f, (unsigned)size, status);
+            return false;
+        }
+    }
+
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("%-5s %4u bytes  %7.1f MB/s  %6.0f ns/frame  overhead %5.2f bytes/frame\n",
+            name, (unsigned)size, (double)size * FRAMES / seconds / 1e6,
+            seconds * 1e9 / FRAMES, (double)wire / FRAMES - size);
+
+    return true;
+}
+
+int main() {
+    static const size_t sizes[] = { 8, 32, 64, 128, 256 };
+    bool ok = true;
+    size_t s;
+
+    __makePayloads();
+
+    for(s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        ok &= __run<CobsEncoder, CobsDecoder>("cobs", sizes[s]);
+        ok &= __run<SlipEncoder, SlipDecoder>("slip", sizes[s]);
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_HOST_AVR_IO_H_
+#define LLAVR_HOST_AVR_IO_H_
+
+/*
+ * Minimal stand-ins for the avr-libc headers, so the hardware-independent
+ * parts of the library (String, CRC, framing, number parsing) can be built
+ * and measured on the host by the tools/ benchmarks and tests:
+ *
+ *   g++ -O2 -Iinclude -Itools/host ...
+ *
+ * No registers are defined, so code that touches peripherals won't build.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define _BV(bit) (1 << (bit))
+
+/** @brief Status register; only ever saved and restored on the host */
+static uint8_t SREG __attribute__((unused));
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// avr-libc's stdlib.h number formatting extensions
+
+static inline char *ultoa(unsigned long value, char *s, int radix) {
+    char tmp[33];
+    int i = 0;
+    int j = 0;
+
+    do {
+        tmp[i++] = "0123456789abcdefghijklmnopqrstuvwxyz"[value % radix];
+        value /= radix;
+    } while(value);
+
+    while(i) {
+        s[j++] = tmp[--i];
+    }
+
+    s[j] = '\0';
+    return s;
+}
+
+static inline char *ltoa(long value, char *s, int radix) {
+    if(value < 0 && radix == 10) {
+        s[0] = '-';
+        ultoa(-(unsigned long)value, s + 1, radix);
+        return s;
+    }
+
+    return ultoa((unsigned long)value, s, radix);
+}
+
+static inline char *utoa(unsigned int value, char *s, int radix) {
+    return ultoa(value, s, radix);
+}
+
+static inline char *itoa(int value, char *s, int radix) {
+    return (radix == 10) ? ltoa(value, s, radix) : utoa((unsigned int)value, s, radix);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LLAVR_HOST_AVR_IO_H_ */
@@ -0,0 +1,41 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_HOST_AVR_PGMSPACE_H_
+#define LLAVR_HOST_AVR_PGMSPACE_H_
+
+#include <avr/io.h>
+#include <string.h>
+
+/*
+ * The host has one address space: program memory is ordinary memory.
+ */
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define PGM_P const char *
+
+#define pgm_read_byte(addr)     (*(const uint8_t *)(addr))
+#define pgm_read_word(addr)     (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr)    (*(const uint32_t *)(addr))
+
+#define memcpy_P    memcpy
+#define strlen_P    strlen
+#define strcmp_P    strcmp
+#define strstr_P    strstr
+
+#endif /* LLAVR_HOST_AVR_PGMSPACE_H_ */
@@ -0,0 +1,51 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LLAVR_HOST_UTIL_CRC16_H_
+#define LLAVR_HOST_UTIL_CRC16_H_
+
+#include <stdint.h>
+
+/*
+ * C equivalents of the avr-libc CRC routines (which are inline assembly).
+ */
+
+static inline uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data) {
+    int i;
+
+    crc ^= (uint16_t)data << 8;
+
+    for(i = 0; i < 8; i++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+
+    return crc;
+}
+
+static inline uint8_t _crc8_ccitt_update(uint8_t crc, uint8_t data) {
+    int i;
+
+    crc ^= data;
+
+    for(i = 0; i < 8; i++) {
+        crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+    }
+
+    return crc;
+}
+
+#endif /* LLAVR_HOST_UTIL_CRC16_H_ */
@@ -0,0 +1,293 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host tests for StaticString: prints each failed check and exits non-zero
+ * if there were any.
+ *
+ * Build and run from the repository root (AddressSanitizer catches writes
+ * past the fixed storage the checks themselves can't see):
+ *
+ *   g++ -O2 -g -fsanitize=address -Iinclude -Itools/host \
+ *       tools/static-string-test.cpp src/StaticString.cpp src/Print.cpp \
+ *       src/WString.cpp src/NumberParser.cpp src/StringAllocator.cpp \
+ *       -o static-string-test && ./static-string-test
+ */
+
+#include <stdio.h>
+
+#include "StaticString.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if(!(cond)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while(0)
+
+// Capacity ////////////////////////////////////////////////////////////////////
+
+static void __testTruncation() {
+    // construction and operator= truncate to the capacity
+    {
+        StaticString<4> s("abcdefg");
+
+        CHECK(s.length() == 4 && s == "abcd");
+
+        s = "0123456789";
+        CHECK(s.length() == 4 && s == "0123");
+
+        s = String("wxyz!");
+        CHECK(s == "wxyz");
+
+        s = F("flash value");
+        CHECK(s == "flas");
+
+        StaticString<8> wide("a longer value");
+        s = wide;
+        CHECK(wide == "a longer" && s == "a lo");
+    }
+
+    // values that fit exactly aren't truncated
+    {
+        StaticString<4> s("abcd");
+
+        CHECK(s.length() == 4 && s == "abcd");
+        CHECK(s.c_str()[4] == '\0');
+    }
+
+    // assign() fails instead, leaving the value unchanged
+    {
+        StaticString<4> s("ok");
+
+        CHECK(!s.assign("too long"));
+        CHECK(s == "ok");
+        CHECK(!s.assign(String("12345")));
+        CHECK(!s.assign(F("flash value")));
+        CHECK(!s.assign((const char *)NULL));
+        CHECK(s == "ok");
+
+        CHECK(s.assign("abcd"));
+        CHECK(s == "abcd");
+        CHECK(s.assign(F("xy")));
+        CHECK(s == "xy");
+        CHECK(s.assign(String("")));
+        CHECK(s.length() == 0);
+    }
+
+    // assigning part of our own value
+    {
+        StaticString<16> s("hello there");
+
+        CHECK(s.assign(s.c_str() + 6));
+        CHECK(s == "there");
+
+        s = s.c_str() + 2;
+        CHECK(s == "ere");
+    }
+}
+
+static void __testConcatFull() {
+    StaticString<6> s("abc");
+
+    CHECK(s.concat("def"));
+    CHECK(s == "abcdef");
+
+    // every kind of piece fails as a whole when it doesn't fit
+    CHECK(!s.concat('g'));
+    CHECK(!s.concat("g"));
+    CHECK(!s.concat(F("g")));
+    CHECK(!s.concat(String("g")));
+    CHECK(!s.concat(7));
+    CHECK(s == "abcdef" && s.length() == 6);
+
+    s = "abcd";
+    CHECK(!s.concat(123));
+    CHECK(!s.concat(-12L));
+    CHECK(s == "abcd");
+    CHECK(s.concat(12));
+    CHECK(s == "abcd12");
+
+    // += reports nothing, but leaves the value unchanged too
+    s = "abcd";
+    s += "efg";
+    CHECK(s == "abcd");
+    s += "ef";
+    CHECK(s == "abcdef");
+}
+
+static void __testReplace() {
+    // growing replacements that don't fit fail with the value unchanged
+    {
+        StaticString<9> s("a-b-c-d");
+
+        CHECK(!s.replace("-", "--"));
+        CHECK(s == "a-b-c-d");
+
+        CHECK(s.replace("-", "+"));
+        CHECK(s == "a+b+c+d");
+    }
+
+    // growing to exactly the capacity
+    {
+        StaticString<10> s("a-b-c");
+
+        CHECK(s.replace("-", "---"));
+        CHECK(s == "a---b---c" && s.length() == 9);
+    }
+
+    // shrinking
+    {
+        StaticString<16> s("one, two, three");
+
+        CHECK(s.replace(", ", ","));
+        CHECK(s == "one,two,three");
+        CHECK(s.replace("two", ""));
+        CHECK(s == "one,,three");
+    }
+
+    // nothing to replace
+    {
+        StaticString<8> s("abc");
+
+        CHECK(s.replace("x", "yyyyyyyyyy"));
+        CHECK(s == "abc");
+    }
+}
+
+// Substrings and search ///////////////////////////////////////////////////////
+
+static void __testSubstring() {
+    StaticString<16> s("hello world");
+
+    CHECK(s.substring(6) == "world");
+    CHECK(s.substring(0, 5) == "hello");
+
+    // swapped bounds are put in order, as String does
+    CHECK(s.substring(5, 0) == "hello");
+    CHECK(s.substring(11, 6) == "world");
+
+    // out of range
+    CHECK(s.substring(11).length() == 0);
+    CHECK(s.substring(20).length() == 0);
+    CHECK(s.substring(6, 100) == "world");
+    CHECK(s.substring(3, 3).length() == 0);
+}
+
+static void __testIndexOf() {
+    StaticString<16> s("abcabcab");
+    StaticString<4> empty;
+
+    CHECK(s.indexOf('a') == 0);
+    CHECK(s.indexOf('a', 1) == 3);
+    CHECK(s.indexOf('b', 7) == 7);
+    CHECK(s.indexOf('a', 8) == -1);
+    CHECK(s.indexOf('x') == -1);
+    CHECK(s.indexOf("cab") == 2);
+    CHECK(s.indexOf("cab", 3) == 5);
+    CHECK(s.indexOf("cab", 6) == -1);
+    CHECK(s.indexOf("abcabcabc") == -1);
+    CHECK(s.indexOf(F("ca")) == 2);
+    CHECK(s.indexOf((const char *)NULL) == -1);
+
+    CHECK(s.lastIndexOf('a') == 6);
+    CHECK(s.lastIndexOf('a', 5) == 3);
+    CHECK(s.lastIndexOf('a', 0) == 0);
+    CHECK(s.lastIndexOf('c', 1) == -1);
+    CHECK(s.lastIndexOf('a', 100) == -1);
+    CHECK(s.lastIndexOf("ab") == 6);
+    CHECK(s.lastIndexOf("ab", 5) == 3);
+    CHECK(s.lastIndexOf("ab", 0) == 0);
+    CHECK(s.lastIndexOf("abc", 100) == 3);
+    CHECK(s.lastIndexOf("abcabcabc") == -1);
+    CHECK(s.lastIndexOf("") == -1);
+    CHECK(s.lastIndexOf((const char *)NULL) == -1);
+
+    // an empty string has nothing to find
+    CHECK(empty.indexOf('a') == -1);
+    CHECK(empty.indexOf("a") == -1);
+    CHECK(empty.lastIndexOf('a') == -1);
+    CHECK(empty.lastIndexOf("a") == -1);
+}
+
+// String interop //////////////////////////////////////////////////////////////
+
+static void __testStringInterop() {
+    String str("from String");
+    StaticString<16> s(str);
+
+    CHECK(s == "from String");
+    CHECK(s == str);
+    CHECK(!(s != str));
+
+    s += String("!");
+    CHECK(s == "from String!");
+    CHECK(s != str);
+
+    // to a String and back
+    {
+        String copy = s.toString();
+
+        CHECK(copy == "from String!");
+        copy += " and more";
+
+        StaticString<16> back(copy);
+        CHECK(back == "from String! and");
+    }
+
+    // an invalidated String assigns as empty, and can't be assign()ed
+    {
+        String invalid((const char *)NULL);
+        StaticString<4> t("abc");
+
+        CHECK(!invalid);
+        t = invalid;
+        CHECK(t.length() == 0);
+
+        t = "abc";
+        CHECK(!t.assign(invalid));
+        CHECK(t == "abc");
+    }
+
+    // numbers convert as String's do
+    {
+        StaticString<12> n(-1234L);
+
+        CHECK(n == String(-1234L));
+        CHECK(n.toInt() == -1234);
+    }
+}
+
+int main() {
+    __testTruncation();
+    __testConcatFull();
+    __testReplace();
+    __testSubstring();
+    __testIndexOf();
+    __testStringInterop();
+
+    if(failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,305 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host benchmark of String building with repeated +=: counts the buffer
+ * reallocations and the bytes they copy, through a counting allocator.
+ *
+ * Also times lastIndexOf() and substring() against the implementations they
+ * replaced, which wrote a temporary '\0' into the buffer to use strrchr(),
+ * strstr() and strlen() (and so couldn't be used on a const String).
+ *
+ * Build and run from the repository root, once with exact-fit growth (the
+ * behavior before geometric growth) and once with the default policy:
+ *
+ *   for slack in 0 32; do
+ *       g++ -O2 -Iinclude -Itools/host -DSTRING_GROWTH_MAX_SLACK=$slack \
+ *           tools/string-bench.cpp src/WString.cpp src/NumberParser.cpp \
+ *           src/StringAllocator.cpp -o string-bench && ./string-bench
+ *   done
+ *
+ * NOTE: Every reallocation is counted as copying the whole old buffer. The
+ *   AVR malloc can sometimes grow a block in place, but only when the space
+ *   after it happens to be free.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "WString.h"
+#include "StringAllocator.h"
+
+/**
+ * @brief Heap allocator that counts reallocations and bytes copied
+ */
+class CountingAllocator : public StringAllocator {
+public:
+    CountingAllocator() : reallocations(0), bytesCopied(0) {
+        // nop
+    }
+
+    virtual void *allocate(size_t size) {
+        return malloc(size);
+    }
+
+    virtual void *reallocate(void *ptr, size_t oldSize, size_t newSize) {
+        void *block;
+
+        if(!ptr) {
+            return malloc(newSize);
+        }
+
+        block = malloc(newSize);
+        if(block) {
+            memcpy(block, ptr, oldSize < newSize ? oldSize : newSize);
+            free(ptr);
+            reallocations++;
+            bytesCopied += oldSize;
+        }
+
+        return block;
+    }
+
+    virtual void release(void *ptr, size_t size) {
+        free(ptr);
+    }
+
+    virtual size_t largestFreeBlock() const {
+        return (size_t)-1;
+    }
+
+    void clear() {
+        reallocations = 0;
+        bytesCopied = 0;
+    }
+
+    unsigned long reallocations;    ///< buffers grown
+    unsigned long bytesCopied;      ///< bytes copied by growing
+};
+
+static CountingAllocator counter;
+
+#define SEARCH_ROUNDS   200000
+
+/** @brief Keeps the timed results live */
+static volatile long sink;
+
+/**
+ * @brief The replaced implementations, on a plain buffer
+ */
+static int __oldLastIndexOf(char *buffer, unsigned int len, char ch, unsigned int fromIndex) {
+    char tempchar;
+    char *temp;
+
+    if(fromIndex >= len) {
+        return -1;
+    }
+
+    tempchar = buffer[fromIndex + 1];
+    buffer[fromIndex + 1] = '\0';
+    temp = strrchr(buffer, ch);
+    buffer[fromIndex + 1] = tempchar;
+
+    return (temp == NULL) ? -1 : temp - buffer;
+}
+
+static int __oldLastIndexOf(char *buffer, unsigned int len, const char *s2,
+        unsigned int len2, unsigned int fromIndex) {
+    int found = -1;
+    char *p;
+
+    if(len2 == 0 || len == 0 || len2 > len) {
+        return -1;
+    }
+
+    if(fromIndex >= len) {
+        fromIndex = len - 1;
+    }
+
+    for(p = buffer; p <= buffer + fromIndex; p++) {
+        p = strstr(p, s2);
+        if(!p) {
+            break;
+        }
+
+        if((unsigned int)(p - buffer) <= fromIndex) {
+            found = p - buffer;
+        }
+    }
+
+    return found;
+}
+
+static String __oldSubstring(char *buffer, unsigned int len, unsigned int left, unsigned int right) {
+    String out;
+    char temp;
+
+    if(left > len) {
+        return out;
+    }
+
+    if(right > len) {
+        right = len;
+    }
+
+    temp = buffer[right];
+    buffer[right] = '\0';
+    out = buffer + left;
+    buffer[right] = temp;
+
+    return out;
+}
+
+static double __nsPerCall(clock_t start) {
+    return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / SEARCH_ROUNDS;
+}
+
+static void __reportSearch(const char *name, double oldNs, double newNs) {
+    printf("%-30s old %7.1f ns  new %7.1f ns\n", name, oldNs, newNs);
+}
+
+/**
+ * @brief Time searches of a 240 character CSV line, as parsed from serial
+ *   input
+ */
+static void __benchSearch() {
+    String line;
+    String comma(",");
+    String field("9999");
+    char *buffer;
+    double oldNs;
+    clock_t start;
+    int i;
+
+    for(i = 0; i < 48; i++) {
+        line += 1000 + i;
+        line += ',';
+    }
+
+    buffer = strdup(line.c_str());
+
+    start = clock();
+    for(i = 0; i < SEARCH_ROUNDS; i++) {
+        sink = __oldLastIndexOf(buffer, line.length(), ',', line.length() - 2);
+    }
+    oldNs = __nsPerCall(start);
+    start = clock();
+    for(i = 0; i < SEARCH_ROUNDS; i++) {
+        sink = line.lastIndexOf(',', line.length() - 2);
+    }
+    __reportSearch("lastIndexOf(char), near end", oldNs, __nsPerCall(start));
+
+    start = clock();
+    for(i = 0; i < SEARCH_ROUNDS; i++) {
+        sink = __oldLastIndexOf(buffer, line.length(), ",", 1, line.length() - 2);
+    }
+    oldNs = __nsPerCall(start);
+    start = clock();
+    for(i = 0; i < SEARCH_ROUNDS; i++) {
+        sink = line.lastIndexOf(comma, line.length() - 2);
+    }
+    __reportSearch("lastIndexOf(String), near end", oldNs, __nsPerCall(start));
+
+    start = clock();
+    for(i = 0; i < SEARCH_ROUNDS; i++) {
+        sink = __oldLastIndexOf(buffer, line.length(), "9999", 4, line.length());
+    }
+    oldNs = __nsPerCall(start);
+    start = clock();
+    for(i = 0; i < SEARCH_ROUNDS; i++) {
+        sink = line.lastIndexOf(field);
+    }
+    __reportSearch("lastIndexOf(String), no match", oldNs, __nsPerCall(start));
+
+    start = clock();
+    for(i = 0; i < SEARCH_ROUNDS; i++) {
+        sink = __oldSubstring(buffer, line.length(), 100, 140).length();
+    }
+    oldNs = __nsPerCall(start);
+    start = clock();
+    for(i = 0; i < SEARCH_ROUNDS; i++) {
+        sink = line.substring(100, 140).length();
+    }
+    __reportSearch("substring(), 40 chars", oldNs, __nsPerCall(start));
+
+    start = clock();
+    for(i = 0; i < SEARCH_ROUNDS; i++) {
+        sink = __oldSubstring(buffer, line.length(), 100, 104).length();
+    }
+    oldNs = __nsPerCall(start);
+    start = clock();
+    for(i = 0; i < SEARCH_ROUNDS; i++) {
+        sink = line.substring(100, 104).length();
+    }
+    __reportSearch("substring(), 4 chars", oldNs, __nsPerCall(start));
+
+    free(buffer);
+}
+
+static void __report(const char *name, const String &s) {
+    printf("slack %2d  %-24s length %4u  reallocs %4lu  bytes copied %7lu\n",
+            STRING_GROWTH_MAX_SLACK, name, s.length(), counter.reallocations,
+            counter.bytesCopied);
+
+    counter.clear();
+}
+
+int main() {
+    int i;
+
+    String::setAllocator(&counter);
+
+    // one character at a time, as when collecting serial input
+    {
+        String s;
+
+        for(i = 0; i < 256; i++) {
+            s += (char)('a' + i % 26);
+        }
+        __report("256 x char", s);
+    }
+
+    // a report line built from short fields
+    {
+        String s;
+
+        for(i = 0; i < 32; i++) {
+            s += "ch";
+            s += i;
+            s += '=';
+            s += (long)(i * 1234);
+            s += ", ";
+        }
+        __report("32 x \"chN=value, \"", s);
+    }
+
+    // a long value grown in larger pieces
+    {
+        String s;
+
+        for(i = 0; i < 64; i++) {
+            s += F("0123456789abcdef");
+        }
+        __report("64 x 16 chars", s);
+    }
+
+    String::setAllocator(NULL);
+
+    __benchSearch();
+
+    return 0;
+}
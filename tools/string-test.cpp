@@ -0,0 +1,499 @@
+/*
+ * This file is part of LL-AVR
+ *
+ * LL-AVR is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * LL-AVR is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with LL-AVR.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host tests for String: prints each failed check and exits non-zero if
+ * there were any.
+ *
+ * Build and run from the repository root (AddressSanitizer catches buffer
+ * overruns and heap misuse the checks themselves can't see):
+ *
+ *   g++ -O2 -g -fsanitize=address -Iinclude -Itools/host tools/string-test.cpp \
+ *       src/WString.cpp src/NumberParser.cpp src/StringAllocator.cpp \
+ *       -o string-test && ./string-test
+ */
+
+#include <stdio.h>
+
+#include "WString.h"
+#include "StringAllocator.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if(!(cond)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while(0)
+
+/**
+ * @brief Check whether a String's value is stored inside the object
+ */
+static bool __isInline(const String &s) {
+    const char *p = s.c_str();
+
+    return p >= (const char *)&s && p < (const char *)(&s + 1);
+}
+
+/**
+ * @brief Exposes String::move(), which the move constructor and assignment
+ *   (C++11) and aliased concatenation use
+ */
+class MovableString : public String {
+public:
+    MovableString(const char *cstr = "") : String(cstr) {
+        // nop
+    }
+
+    void moveFrom(String &rhs) {
+        move(static_cast<MovableString &>(rhs));
+    }
+};
+
+// Inline storage //////////////////////////////////////////////////////////////
+
+static void __testInlineToHeap() {
+    String s("abc");
+
+    CHECK(__isInline(s));
+    CHECK(s == "abc");
+
+    // the longest inline value
+    s += "defg";
+    CHECK(s.length() == STRING_SSO_SIZE - 1);
+    CHECK(__isInline(s));
+    CHECK(s == "abcdefg");
+
+    // one more character moves it to the heap, keeping the value
+    s += 'h';
+    CHECK(!__isInline(s));
+    CHECK(s == "abcdefgh");
+
+    s += "ijklmnop";
+    CHECK(s == "abcdefghijklmnop");
+
+    // a short value assigned to a heap String stays on the heap...
+    s = "xy";
+    CHECK(!__isInline(s));
+    CHECK(s == "xy");
+
+    // ...until the spare capacity is released
+    CHECK(s.shrinkToFit());
+    CHECK(__isInline(s));
+    CHECK(s == "xy");
+
+    // and back out again
+    s.concat("0123456789");
+    CHECK(!__isInline(s));
+    CHECK(s == "xy0123456789");
+}
+
+static void __testReserve() {
+    String s;
+
+    CHECK(s.reserve(STRING_SSO_SIZE - 1));
+    CHECK(__isInline(s));
+    CHECK(s.length() == 0);
+    CHECK(s == "");
+
+    CHECK(s.reserve(STRING_SSO_SIZE));
+    CHECK(!__isInline(s));
+    CHECK(s == "");
+
+    // a value too long for the inline array stays on the heap
+    s = "0123456789";
+    CHECK(s.shrinkToFit());
+    CHECK(!__isInline(s));
+    CHECK(s == "0123456789");
+}
+
+static void __testCopy() {
+    String heap("a value on the heap");
+    String small("tiny");
+    String a(small);
+    String b(heap);
+
+    CHECK(__isInline(a) && a == "tiny");
+    CHECK(!__isInline(b) && b == heap);
+    CHECK(b.c_str() != heap.c_str());
+
+    a = heap;
+    CHECK(!__isInline(a) && a == heap);
+
+    b = small;
+    CHECK(b == "tiny");
+}
+
+// Move ////////////////////////////////////////////////////////////////////////
+
+static void __testMoveInline() {
+    // into an empty String: the value is copied into its own array, since
+    // the rhs array can't be taken
+    {
+        MovableString from("abc");
+        MovableString to;
+
+        to.moveFrom(from);
+        CHECK(__isInline(to) && to == "abc");
+        CHECK(to.c_str() != from.c_str());
+        CHECK(from.length() == 0);
+    }
+
+    // into a heap String with room: copied into the existing buffer
+    {
+        MovableString from("abc");
+        MovableString to("a value on the heap");
+
+        to.moveFrom(from);
+        CHECK(!__isInline(to) && to == "abc");
+        CHECK(from.length() == 0);
+    }
+
+    // into an inline String
+    {
+        MovableString from("xyz");
+        MovableString to("q");
+
+        to.moveFrom(from);
+        CHECK(__isInline(to) && to == "xyz");
+        CHECK(from.length() == 0);
+    }
+
+    // an inline String taking a heap value steals the buffer
+    {
+        MovableString from("a value on the heap");
+        MovableString to("q");
+        const char *buffer = from.c_str();
+
+        to.moveFrom(from);
+        CHECK(to.c_str() == buffer && to == "a value on the heap");
+        CHECK(!from);
+    }
+
+    // aliased concatenation builds a separate result and moves it in
+    {
+        String s("a");
+
+        s = "<" + s + ">";
+        CHECK(__isInline(s) && s == "<a>");
+    }
+
+#ifdef __GXX_EXPERIMENTAL_CXX0X__
+    {
+        String from("tiny");
+        String to(static_cast<String &&>(from));
+
+        CHECK(__isInline(to) && to == "tiny");
+
+        to = static_cast<String &&>(String("mini"));
+        CHECK(__isInline(to) && to == "mini");
+    }
+#endif
+}
+
+// Self-aliasing concatenation /////////////////////////////////////////////////
+
+static void __testConcatSelf() {
+    // inline to inline
+    {
+        String s("abc");
+
+        s += s;
+        CHECK(__isInline(s) && s == "abcabc");
+    }
+
+    // inline to heap: the source is the inline array being moved out of
+    {
+        String s("abcd");
+
+        s += s;
+        CHECK(!__isInline(s) && s == "abcdabcd");
+    }
+
+    // heap to a bigger heap buffer
+    {
+        String s("0123456789");
+
+        s.shrinkToFit();
+        s += s;
+        CHECK(s == "01234567890123456789");
+    }
+
+    // part of our own value, across a reallocation
+    {
+        String s("0123456789");
+
+        s.shrinkToFit();
+        s.concat(s.c_str() + 5);
+        CHECK(s == "012345678956789");
+    }
+
+    // part of our own value, inline
+    {
+        String s("abc");
+
+        s.concat(s.c_str() + 1);
+        CHECK(__isInline(s) && s == "abcbc");
+    }
+
+    // assigning part of our own value
+    {
+        String s("hello there");
+
+        s = s.c_str() + 6;
+        CHECK(s == "there");
+    }
+
+    // part of our own value in an expression, across a reallocation
+    {
+        String s("0123456789");
+        String t("abcdefghij");
+
+        s.shrinkToFit();
+        s += s.c_str() + 5 + t;
+        CHECK(s == "012345678956789abcdefghij");
+
+        s = s.c_str() + 20 + t;
+        CHECK(s == "fghijabcdefghij");
+    }
+
+    // part of our own value in an expression, inline
+    {
+        String s("abc");
+
+        s += s.c_str() + 1 + String("d");
+        CHECK(__isInline(s) && s == "abcbcd");
+    }
+}
+
+// Concatenation expressions //////////////////////////////////////////////////
+
+/**
+ * @brief Takes a String, as library functions such as Print::print() do
+ */
+static unsigned int __lengthOf(const String &s) {
+    return s.length();
+}
+
+static void __testConcat() {
+    String a("abc");
+    String b("defghijk");
+    char buf[16];
+
+    // evaluated into a String
+    {
+        String s = a + b;
+        String t = "x=" + String(12) + ",y=" + 34 + ',' + F("z") + 5UL;
+
+        CHECK(s == "abcdefghijk");
+        CHECK(t == "x=12,y=34,z5");
+        CHECK(__lengthOf(a + "-" + b) == 12);
+
+        s = b + a;
+        CHECK(s == "defghijkabc");
+
+        s += a + "!";
+        CHECK(s == "defghijkabcabc!");
+    }
+
+    // String methods called on the expression itself, as on the temporary
+    // String that operator+ used to return
+    CHECK(strcmp((a + b).c_str(), "abcdefghijk") == 0);
+    CHECK((a + "x").substring(1) == "bcx");
+    CHECK((a + b).substring(2, 5) == "cde");
+    CHECK((a + b).indexOf('e') == 4);
+    CHECK((a + b).indexOf("fg") == 5);
+    CHECK((a + b + a).lastIndexOf("abc") == 11);
+    CHECK((a + b).lastIndexOf('a') == 0);
+    CHECK((a + b).charAt(3) == 'd');
+    CHECK((a + b)[10] == 'k');
+    CHECK((a + b).startsWith("abcd"));
+    CHECK((a + b).startsWith(F("bc"), 1));
+    CHECK((a + b).endsWith("jk"));
+    CHECK((a + b).equalsIgnoreCase("ABCDEFGHIJK"));
+    CHECK((a + b).compareTo(a) > 0);
+    CHECK((a + b) > a);
+    CHECK((a + b) == "abcdefghijk");
+    CHECK((a + b) != a);
+    CHECK((a + F("z")) == F("abcz"));
+    CHECK(("1" + String(2) + 3).toInt() == 123);
+    CHECK(("2" + String(".") + "5").toFloat() == 2.5F);
+
+    (a + b).toCharArray(buf, sizeof(buf));
+    CHECK(strcmp(buf, "abcdefghijk") == 0);
+
+    // a String compared with an expression
+    CHECK(String("abcdefghijk") == a + b);
+}
+
+// Search and substring ///////////////////////////////////////////////////////
+
+static void __testLastIndexOf() {
+    const String s("abcabcaab");
+    const String empty;
+
+    CHECK(s.lastIndexOf('a') == 7);
+    CHECK(s.lastIndexOf('b') == 8);
+    CHECK(s.lastIndexOf('z') == -1);
+    CHECK(s.lastIndexOf('a', 6) == 6);
+    CHECK(s.lastIndexOf('a', 5) == 3);
+    CHECK(s.lastIndexOf('a', 0) == 0);
+    CHECK(s.lastIndexOf('b', 0) == -1);
+    CHECK(s.lastIndexOf('a', 9) == -1);
+    CHECK(empty.lastIndexOf('a') == -1);
+
+    CHECK(s.lastIndexOf("abc") == 3);
+    CHECK(s.lastIndexOf("ab") == 7);
+    CHECK(s.lastIndexOf("ab", 6) == 3);
+    CHECK(s.lastIndexOf("ab", 3) == 3);
+    CHECK(s.lastIndexOf("ab", 2) == 0);
+    CHECK(s.lastIndexOf("ab", 100) == 7);
+    CHECK(s.lastIndexOf("ca", 1) == -1);
+    CHECK(s.lastIndexOf("abcabcaab") == 0);
+    CHECK(s.lastIndexOf("abcabcaabx") == -1);
+    CHECK(s.lastIndexOf("") == -1);
+    CHECK(empty.lastIndexOf("a") == -1);
+
+    // overlapping matches
+    CHECK(String("aaaa").lastIndexOf("aa") == 2);
+    CHECK(String("aaaa").lastIndexOf("aa", 1) == 1);
+
+    // the value is left unchanged
+    CHECK(s == "abcabcaab");
+}
+
+static void __testSubstring() {
+    const String s("hello world");
+    const String empty;
+
+    CHECK(s.substring(6) == "world");
+    CHECK(s.substring(0) == s);
+    CHECK(s.substring(11) == "");
+    CHECK(s.substring(12) == "");
+    CHECK(s.substring(0, 5) == "hello");
+    CHECK(s.substring(4, 7) == "o w");
+    CHECK(s.substring(7, 4) == "o w");
+    CHECK(s.substring(3, 3) == "");
+    CHECK(s.substring(6, 100) == "world");
+    CHECK(s.substring(100, 200) == "");
+    CHECK(empty.substring(0) == "");
+
+    // short results are stored inline, longer ones on the heap
+    CHECK(__isInline(s.substring(6)));
+    CHECK(!__isInline(String("0123456789abcdef").substring(2)));
+    CHECK(String("0123456789abcdef").substring(2) == "23456789abcdef");
+
+    // the value is left unchanged
+    CHECK(s == "hello world");
+    CHECK(s.length() == 11);
+}
+
+// Conversion /////////////////////////////////////////////////////////////////
+
+static void __testToNumber() {
+    CHECK(String("42").toInt() == 42);
+    CHECK(String("  -42").toInt() == -42);
+    CHECK(String("\t42").toInt() == 42);
+    CHECK(String("\n42").toInt() == 42);
+    CHECK(String("\r\n42\r\n").toInt() == 42);
+    CHECK(String("\v\f 7").toInt() == 7);
+    CHECK(String("x42").toInt() == 0);
+    CHECK(String("\r\n2.5").toFloat() == 2.5F);
+}
+
+// Allocators /////////////////////////////////////////////////////////////////
+
+static uint8_t arenaMemory[256];
+
+static bool __inArena(const String &s) {
+    return (const uint8_t *)s.c_str() >= arenaMemory
+            && (const uint8_t *)s.c_str() < arenaMemory + sizeof(arenaMemory);
+}
+
+static void __testArenaScope() {
+    StringArena arena(arenaMemory, sizeof(arenaMemory));
+    String empty;
+    String small("abc");
+    String heap("a value on the heap");
+
+    {
+        StringArenaScope scope(arena);
+        String local("a value in the arena");
+
+        CHECK(__inArena(local));
+
+        // Strings from before the scope grow outside the arena
+        empty += "grown inside the scope";
+        small += "defghijklmnop";
+        heap += ", grown inside the scope";
+        CHECK(!__inArena(empty));
+        CHECK(!__inArena(small));
+        CHECK(!__inArena(heap));
+
+        // taking a value from the scope copies it out of the arena
+        empty = local;
+        CHECK(!__inArena(empty));
+        small = "<" + small + ">";
+        CHECK(!__inArena(small));
+
+        // nested scopes: a String from the outer scope uses the outer arena
+        {
+            static uint8_t innerMemory[64];
+            StringArena inner(innerMemory, sizeof(innerMemory));
+            StringArenaScope innerScope(inner);
+            String innerLocal("a value in the inner arena");
+
+            local += ", grown in the inner scope";
+            CHECK(__inArena(local));
+            CHECK((const uint8_t *)innerLocal.c_str() >= innerMemory
+                    && (const uint8_t *)innerLocal.c_str() < innerMemory + sizeof(innerMemory));
+        }
+
+        CHECK(local == "a value in the arena, grown in the inner scope");
+    }
+
+    // still valid after the arena was reset (and released to the heap
+    // without complaint from AddressSanitizer when destroyed)
+    CHECK(empty == "a value in the arena");
+    CHECK(small == "<abcdefghijklmnop>");
+    CHECK(heap == "a value on the heap, grown inside the scope");
+    CHECK(arena.stats().inUse == 0);
+    CHECK(String::getAllocator() == NULL);
+}
+
+int main() {
+    __testInlineToHeap();
+    __testReserve();
+    __testCopy();
+    __testMoveInline();
+    __testConcatSelf();
+    __testConcat();
+    __testLastIndexOf();
+    __testSubstring();
+    __testToNumber();
+    __testArenaScope();
+
+    if(failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}